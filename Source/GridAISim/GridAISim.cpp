@@ -2,6 +2,20 @@
 
 #include "GridAISim.h"
 #include "Modules/ModuleManager.h"
+#include "Simulation/SimStats.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, GridAISim, "GridAISim" );
+class FGridAISimModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		// GMalloc is only wrapped this early, before anything of the simulation runs
+		if (FParse::Param(FCommandLine::Get(), TEXT("GridSimCountAllocations")))
+		{
+			FSimAllocationCounter::Enable();
+		}
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FGridAISimModule, GridAISim, "GridAISim" );
 DEFINE_LOG_CATEGORY(LogSim);
\ No newline at end of file
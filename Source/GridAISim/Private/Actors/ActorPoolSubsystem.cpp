@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Actors/ActorPoolSubsystem.h"
+
+#include "Actors/GameActorBase.h"
+#include "GridAISim/GridAISim.h"
+
+void UGS_ActorPoolSubsystem::Prewarm(TSubclassOf<AGS_GameActorBase> InClass, int32 InCount)
+{
+	if (InClass == nullptr)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[UGS_ActorPoolSubsystem::Prewarm] Class is nullptr."));
+		return;
+	}
+
+	const int32 NumMissing = InCount - GetNumFree(InClass);
+	if (NumMissing > 0)
+	{
+		SpawnIntoPool(InClass, NumMissing);
+	}
+}
+
+AGS_GameActorBase* UGS_ActorPoolSubsystem::Acquire(TSubclassOf<AGS_GameActorBase> InClass,
+                                                    const FTransform& InTransform)
+{
+	TArray<AGS_GameActorBase*> Actors;
+	AcquireBatch(InClass, 1, Actors);
+	if (Actors.Num() == 0)
+	{
+		return nullptr;
+	}
+
+	Actors[0]->SetActorTransform(InTransform, false, nullptr, ETeleportType::TeleportPhysics);
+	return Actors[0];
+}
+
+void UGS_ActorPoolSubsystem::AcquireBatch(TSubclassOf<AGS_GameActorBase> InClass, int32 InCount,
+                                           TArray<AGS_GameActorBase*>& OutActors)
+{
+	if (InClass == nullptr || InCount <= 0)
+	{
+		return;
+	}
+
+	Prewarm(InClass, InCount);
+
+	FGS_ActorPool& Pool = Pools.FindOrAdd(InClass);
+	OutActors.Reserve(OutActors.Num() + InCount);
+	int32 NumDestroyed = 0;
+	while (InCount > 0 && Pool.FreeActors.Num() > 0)
+	{
+		AGS_GameActorBase* Actor = Pool.FreeActors.Pop(false);
+
+		// Something may have destroyed a pooled actor behind our back
+		if (!IsValid(Actor))
+		{
+			++NumDestroyed;
+			continue;
+		}
+
+		Actor->ResetForReuse();
+		OutActors.Add(Actor);
+		--InCount;
+	}
+
+	if (InCount > 0 && NumDestroyed > 0)
+	{
+		// Refill after the destroyed ones
+		AcquireBatch(InClass, InCount, OutActors);
+	}
+}
+
+void UGS_ActorPoolSubsystem::Release(AGS_GameActorBase* InActor)
+{
+	if (!IsValid(InActor))
+	{
+		return;
+	}
+
+	InActor->OnReturnedToPool();
+	Pools.FindOrAdd(InActor->GetClass()).FreeActors.Add(InActor);
+}
+
+int32 UGS_ActorPoolSubsystem::GetNumFree(TSubclassOf<AGS_GameActorBase> InClass) const
+{
+	const FGS_ActorPool* Pool = Pools.Find(InClass);
+	return Pool ? Pool->FreeActors.Num() : 0;
+}
+
+bool UGS_ActorPoolSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UGS_ActorPoolSubsystem::SpawnIntoPool(UClass* InClass, int32 InCount)
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[UGS_ActorPoolSubsystem::SpawnIntoPool] World is nullptr."));
+		return;
+	}
+
+	FActorSpawnParameters Params;
+	Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	Params.bDeferConstruction = true;
+
+	TArray<AGS_GameActorBase*> SpawnedActors;
+	SpawnedActors.Reserve(InCount);
+	for (int32 Index = 0; Index < InCount; ++Index)
+	{
+		if (auto* Actor = World->SpawnActor<AGS_GameActorBase>(InClass, FTransform::Identity, Params))
+		{
+			SpawnedActors.Add(Actor);
+		}
+	}
+
+	// The spawns are deferred, so the construction scripts and the component registration run in a second loop,
+	// one actor after another. Nothing is registered in bulk, the batch only keeps the two passes apart.
+	FGS_ActorPool& Pool = Pools.FindOrAdd(InClass);
+	Pool.FreeActors.Reserve(Pool.FreeActors.Num() + SpawnedActors.Num());
+	for (AGS_GameActorBase* Actor : SpawnedActors)
+	{
+		Actor->FinishSpawning(FTransform::Identity);
+		Actor->OnReturnedToPool();
+		Pool.FreeActors.Add(Actor);
+	}
+
+	UE_LOG(LogSim, Display, TEXT("[UGS_ActorPoolSubsystem::SpawnIntoPool] Spawned %d actors of %s."),
+	       SpawnedActors.Num(), *GetNameSafe(InClass));
+}
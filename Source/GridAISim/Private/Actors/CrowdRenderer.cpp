@@ -0,0 +1,185 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Actors/CrowdRenderer.h"
+
+#include "Actors/GameActorBase.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "GridAISim/GridAISim.h"
+
+AGS_CrowdRenderer::AGS_CrowdRenderer()
+{
+	// The instances are updated by the GameMode
+	PrimaryActorTick.bCanEverTick = false;
+
+	USceneComponent* SceneComponent = CreateDefaultSubobject<USceneComponent>("Root");
+	RootComponent = SceneComponent;
+}
+
+void AGS_CrowdRenderer::BeginUpdate()
+{
+	for (FCrowdBatch& Batch : Batches)
+	{
+		Batch.InstanceActors.Reset();
+		Batch.Transforms.Reset();
+		Batch.CustomData.Reset();
+	}
+}
+
+void AGS_CrowdRenderer::AddInstance(const AGS_GameActorBase* InActor)
+{
+	if (InActor == nullptr)
+	{
+		return;
+	}
+
+	const int32 BatchIndex = FindOrAddBatch(InActor);
+	if (BatchIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	FCrowdBatch& Batch = Batches[BatchIndex];
+	Batch.InstanceActors.Add(InActor);
+	Batch.Transforms.Add(InActor->GetActorTransform());
+	Batch.CustomData.Add(StaticCast<float>(InActor->GetActorState()));
+	Batch.CustomData.Add(InActor->GetActorStateStartTime());
+}
+
+void AGS_CrowdRenderer::EndUpdate()
+{
+	for (int32 BatchIndex = 0; BatchIndex < Batches.Num(); ++BatchIndex)
+	{
+		const FCrowdBatch& Batch = Batches[BatchIndex];
+		UInstancedStaticMeshComponent* Component = BatchComponents[BatchIndex];
+
+		// The instances are only added or removed when the number of units changes, otherwise they are updated in place
+		if (Component->GetInstanceCount() != Batch.Transforms.Num())
+		{
+			Component->ClearInstances();
+			Component->AddInstances(Batch.Transforms, false, true);
+		}
+		else if (Batch.Transforms.Num() > 0)
+		{
+			// The render state is marked dirty, the custom data copied below bypasses the instance update commands
+			Component->BatchUpdateInstancesTransforms(0, Batch.Transforms, true, true, true);
+		}
+
+		if (Component->PerInstanceSMCustomData.Num() == Batch.CustomData.Num())
+		{
+			FMemory::Memcpy(Component->PerInstanceSMCustomData.GetData(), Batch.CustomData.GetData(),
+			                Batch.CustomData.Num() * sizeof(float));
+		}
+	}
+}
+
+int32 AGS_CrowdRenderer::GetNumInstances(const UClass* InClass, ETeam InTeam) const
+{
+	const int32* BatchIndex = BatchIndices[StaticCast<int32>(InTeam)].Find(InClass);
+	return (BatchIndex && *BatchIndex != INDEX_NONE) ? BatchComponents[*BatchIndex]->GetInstanceCount() : 0;
+}
+
+bool AGS_CrowdRenderer::ValidateInstances(const FUnitRegistry& InUnits,
+                                          TConstArrayView<TObjectPtr<AGS_GameActorBase>> InUnitActors) const
+{
+	bool bIsValid = true;
+
+	// The expected number of instances of every batch
+	TArray<int32> ExpectedCounts;
+	ExpectedCounts.SetNumZeroed(Batches.Num());
+	InUnits.ForEachUnit([this, &InUnitActors, &ExpectedCounts, &bIsValid](FUnitHandle Handle)
+	{
+		const AGS_GameActorBase* Actor = InUnitActors.IsValidIndex(Handle) ? InUnitActors[Handle].Get() : nullptr;
+		const int32* BatchIndex = Actor != nullptr
+			                          ? BatchIndices[StaticCast<int32>(Actor->GetTeam())].Find(Actor->GetClass())
+			                          : nullptr;
+		if (BatchIndex == nullptr || *BatchIndex == INDEX_NONE)
+		{
+			UE_LOG(LogSim, Warning, TEXT("[AGS_CrowdRenderer::ValidateInstances] Unit %d (%s) is not drawn."), Handle,
+			       *GetNameSafe(Actor));
+			bIsValid = false;
+			return;
+		}
+		++ExpectedCounts[*BatchIndex];
+	});
+
+	for (int32 BatchIndex = 0; BatchIndex < Batches.Num(); ++BatchIndex)
+	{
+		const FCrowdBatch& Batch = Batches[BatchIndex];
+		const UInstancedStaticMeshComponent* Component = BatchComponents[BatchIndex];
+
+		const int32 NumInstances = Component->GetInstanceCount();
+		if (NumInstances != ExpectedCounts[BatchIndex] || NumInstances != Batch.InstanceActors.Num())
+		{
+			UE_LOG(LogSim, Warning,
+			       TEXT("[AGS_CrowdRenderer::ValidateInstances] %s of team %d: %d instances, %d units registered."),
+			       *GetNameSafe(Batch.Class), StaticCast<int32>(Batch.Team), NumInstances, ExpectedCounts[BatchIndex]);
+			bIsValid = false;
+			continue;
+		}
+
+		for (int32 InstanceIndex = 0; InstanceIndex < NumInstances; ++InstanceIndex)
+		{
+			const AGS_GameActorBase* Actor = Batch.InstanceActors[InstanceIndex];
+			const FUnitHandle Handle = Actor->GetUnitHandle();
+			if (!InUnits.IsValid(Handle) || !InUnitActors.IsValidIndex(Handle) || InUnitActors[Handle] != Actor)
+			{
+				UE_LOG(LogSim, Warning, TEXT("[AGS_CrowdRenderer::ValidateInstances] %s is drawn, but not registered."),
+				       *GetNameSafe(Actor));
+				bIsValid = false;
+				continue;
+			}
+
+			FTransform InstanceTransform;
+			Component->GetInstanceTransform(InstanceIndex, InstanceTransform, true);
+			if (!InstanceTransform.GetLocation().Equals(Actor->GetActorLocation(), KINDA_SMALL_NUMBER))
+			{
+				UE_LOG(LogSim, Warning, TEXT("[AGS_CrowdRenderer::ValidateInstances] %s is drawn at %s instead of %s."),
+				       *GetNameSafe(Actor), *InstanceTransform.GetLocation().ToString(),
+				       *Actor->GetActorLocation().ToString());
+				bIsValid = false;
+			}
+		}
+	}
+
+	return bIsValid;
+}
+
+int32 AGS_CrowdRenderer::FindOrAddBatch(const AGS_GameActorBase* InActor)
+{
+	const UClass* ActorClass = InActor->GetClass();
+	TMap<const UClass*, int32>& TeamBatchIndices = BatchIndices[StaticCast<int32>(InActor->GetTeam())];
+	if (const int32* BatchIndex = TeamBatchIndices.Find(ActorClass))
+	{
+		return *BatchIndex;
+	}
+
+	UStaticMesh* CrowdMesh = InActor->GetCrowdMesh();
+	if (CrowdMesh == nullptr)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[AGS_CrowdRenderer::FindOrAddBatch] %s has no crowd mesh."),
+		       *GetNameSafe(ActorClass));
+		// Remember the class anyway, so the warning isn't repeated for every actor
+		TeamBatchIndices.Add(ActorClass, INDEX_NONE);
+		return INDEX_NONE;
+	}
+
+	auto* Component = NewObject<UInstancedStaticMeshComponent>(this);
+	Component->SetupAttachment(RootComponent);
+	Component->SetMobility(EComponentMobility::Movable);
+	Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Component->SetStaticMesh(CrowdMesh);
+	if (UMaterialInterface* TeamMaterial = InActor->GetTeamMaterial())
+	{
+		Component->SetMaterial(0, TeamMaterial);
+	}
+	Component->SetNumCustomDataFloats(NumCustomDataFloats);
+	Component->RegisterComponent();
+
+	const int32 BatchIndex = Batches.AddDefaulted();
+	Batches[BatchIndex].Class = ActorClass;
+	Batches[BatchIndex].Team = InActor->GetTeam();
+	BatchComponents.Add(Component);
+	TeamBatchIndices.Add(ActorClass, BatchIndex);
+	return BatchIndex;
+}
@@ -3,14 +3,16 @@
 
 #include "Actors/GameActorBase.h"
 
+#include "Actors/ActorPoolSubsystem.h"
+#include "Actors/MovementInterpolatorSubsystem.h"
 #include "GridAISim/GridAISim.h"
 
 
 // Sets default values
 AGS_GameActorBase::AGS_GameActorBase()
 {
-	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// The movement is driven by UGS_MovementInterpolatorSubsystem, so the actors don't need to tick
+	PrimaryActorTick.bCanEverTick = false;
 
 	USceneComponent* SceneComponent = CreateDefaultSubobject<USceneComponent>("Root");
 	RootComponent = SceneComponent;
@@ -19,25 +21,6 @@ AGS_GameActorBase::AGS_GameActorBase()
 	SkeletalMeshComp->SetupAttachment(RootComponent);
 }
 
-void AGS_GameActorBase::Tick(float DeltaSeconds)
-{
-	Super::Tick(DeltaSeconds);
-
-	if (ActorState == EActorState::Moving)
-	{
-		if (GameActionDurationSeconds < SMALL_NUMBER)
-		{
-			UE_LOG(LogSim, Error, TEXT("[Tick] Zero division prevented."))
-			return;
-		}
-
-		// TODO: grab this parameter from the GameMode
-		const float SegmentSize = 100.f;
-		SetActorLocation(FMath::VInterpConstantTo(GetActorLocation(), TargetLocation, DeltaSeconds,
-		                                          SegmentSize * (1 / GameActionDurationSeconds)));
-	}
-}
-
 void AGS_GameActorBase::BeginPlay()
 {
 	Super::BeginPlay();
@@ -53,12 +36,11 @@ void AGS_GameActorBase::HandleZeroHealth()
 	if (GameActionDurationSeconds < SMALL_NUMBER)
 	{
 		UE_LOG(LogSim, Error, TEXT("[StartDestroy] Zero division prevented."))
-		Destroy();
+		StartDestroy();
 		return;
 	}
 
-	FTimerHandle UselessHandle;
-	GetWorld()->GetTimerManager().SetTimer(UselessHandle, this, &ThisClass::StartDestroy
+	GetWorld()->GetTimerManager().SetTimer(DestroyTimerHandle, this, &ThisClass::StartDestroy
 	                                       , GameActionDurationSeconds, false);
 }
 
@@ -66,9 +48,45 @@ void AGS_GameActorBase::StartDestroy()
 {
 	// TODO: spawn some emitter maybe?
 
+	// Give the actor back to the pool for the next runs, if there is one
+	if (auto* ActorPool = UWorld::GetSubsystem<UGS_ActorPoolSubsystem>(GetWorld()))
+	{
+		ActorPool->Release(this);
+		return;
+	}
+
 	Destroy();
 }
 
+void AGS_GameActorBase::ResetForReuse()
+{
+	GetWorldTimerManager().ClearTimer(DestroyTimerHandle);
+
+	CurrentAttackPower = 0.f;
+	CurrentHealth = 0.f;
+	bIsAlive = true;
+	UnitHandle = INDEX_NONE;
+	GridCoordinates = FIntPoint::ZeroValue;
+	GridPointIndex = 0;
+	TargetLocation = GetActorLocation();
+
+	SetActorHiddenInGame(false);
+	SetActorState(EActorState::Idle);
+}
+
+void AGS_GameActorBase::OnReturnedToPool()
+{
+	GetWorldTimerManager().ClearTimer(DestroyTimerHandle);
+
+	bIsAlive = false;
+	UnitHandle = INDEX_NONE;
+	ActorState = EActorState::Dead;
+
+	StopMovement();
+	SkeletalMeshComp->Stop();
+	SetActorHiddenInGame(true);
+}
+
 void AGS_GameActorBase::MoveActorInterp(const FVector& InNewLocation, float InInterpTime_ms)
 {
 	// TODO: make it lerp here..
@@ -78,6 +96,23 @@ void AGS_GameActorBase::MoveActorInterp(const FVector& InNewLocation, float InIn
 	SetActorRotation((TargetLocation - GetActorLocation()).Rotation());
 	//ActorState = EActorState::Moving;
 	SetActorState(EActorState::Moving);
+
+	if (auto* Interpolator = UWorld::GetSubsystem<UGS_MovementInterpolatorSubsystem>(GetWorld()))
+	{
+		Interpolator->MoveTo(this, TargetLocation, InInterpTime_ms);
+	}
+	else
+	{
+		SetActorLocation(TargetLocation);
+	}
+}
+
+void AGS_GameActorBase::StopMovement()
+{
+	if (auto* Interpolator = UWorld::GetSubsystem<UGS_MovementInterpolatorSubsystem>(GetWorld()))
+	{
+		Interpolator->Stop(this);
+	}
 }
 
 void AGS_GameActorBase::SetActionDuration(float InGameActionDurationSeconds)
@@ -90,6 +125,46 @@ void AGS_GameActorBase::Halt()
 	SetActorState(EActorState::Idle);
 }
 
+EActorState AGS_GameActorBase::GetActorState() const
+{
+	return ActorState;
+}
+
+float AGS_GameActorBase::GetActorStateStartTime() const
+{
+	return ActorStateStartTime;
+}
+
+void AGS_GameActorBase::SetCrowdRendered(bool bInCrowdRendered)
+{
+	bCrowdRendered = bInCrowdRendered;
+
+	SkeletalMeshComp->SetVisibility(!bCrowdRendered);
+	SkeletalMeshComp->SetComponentTickEnabled(!bCrowdRendered);
+	if (bCrowdRendered)
+	{
+		SkeletalMeshComp->Stop();
+	}
+}
+
+UStaticMesh* AGS_GameActorBase::GetCrowdMesh() const
+{
+	return CrowdMesh;
+}
+
+UMaterialInterface* AGS_GameActorBase::GetTeamMaterial() const
+{
+	switch (Team)
+	{
+	case ETeam::BlueTeam:
+		return BlueTeamMaterial;
+	case ETeam::RedTeam:
+		return RedTeamMaterial;
+	default:
+		return nullptr;
+	}
+}
+
 float AGS_GameActorBase::GetAttackMaxRandomFraction() const
 {
 	return AttackMaxRandomFraction;
@@ -113,6 +188,22 @@ void AGS_GameActorBase::SetHealthMaxRandomFraction(float InHealthMaxRandomFracti
 void AGS_GameActorBase::SetActorState(EActorState NewState)
 {
 	ActorState = NewState;
+	if (const UWorld* World = GetWorld())
+	{
+		ActorStateStartTime = World->GetTimeSeconds();
+	}
+
+	// Only the Moving state moves the actor
+	if (ActorState != EActorState::Moving)
+	{
+		StopMovement();
+	}
+
+	// The crowd renderer plays the animations by the state
+	if (bCrowdRendered)
+	{
+		return;
+	}
 
 	// PlayAnimation stage (move it to a separate method, or callback)
 
@@ -202,6 +293,16 @@ void AGS_GameActorBase::SetGridPointIndex(const int32 InGridPointIndex)
 	GridPointIndex = InGridPointIndex;
 }
 
+FUnitHandle AGS_GameActorBase::GetUnitHandle() const
+{
+	return UnitHandle;
+}
+
+void AGS_GameActorBase::SetUnitHandle(FUnitHandle InUnitHandle)
+{
+	UnitHandle = InUnitHandle;
+}
+
 void AGS_GameActorBase::SetAttackPower(float InNewAttackPower)
 {
 	CurrentAttackPower = AttackPowerBase + InNewAttackPower;
@@ -0,0 +1,182 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Actors/MovementInterpolatorSubsystem.h"
+
+#include "Actors/GameActorBase.h"
+
+void UGS_MovementInterpolatorSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	DirtySlots.Reset();
+	ArrivedSlots.Reset();
+
+	const int32 NumMoving = MovingActors.Num();
+	float* RESTRICT X = LocationsX.GetData();
+	float* RESTRICT Y = LocationsY.GetData();
+	float* RESTRICT Z = LocationsZ.GetData();
+	const float* RESTRICT TX = TargetsX.GetData();
+	const float* RESTRICT TY = TargetsY.GetData();
+	const float* RESTRICT TZ = TargetsZ.GetData();
+
+	auto CollectLanes = [this](int32 InFirstSlot, int32 InMovedBits, int32 InArrivedBits)
+	{
+		for (int32 Lane = 0; Lane < 4; ++Lane)
+		{
+			if (InMovedBits & (1 << Lane))
+			{
+				DirtySlots.Add(InFirstSlot + Lane);
+			}
+			if (InArrivedBits & (1 << Lane))
+			{
+				ArrivedSlots.Add(InFirstSlot + Lane);
+			}
+		}
+	};
+
+	// Four actors per iteration
+	const VectorRegister4Float Zero = VectorZero();
+	const VectorRegister4Float One = VectorOne();
+	const VectorRegister4Float DeltaTimeVec = VectorSetFloat1(DeltaTime);
+	int32 Slot = 0;
+	for (; Slot + 4 <= NumMoving; Slot += 4)
+	{
+		const VectorRegister4Float PosX = VectorLoad(X + Slot);
+		const VectorRegister4Float PosY = VectorLoad(Y + Slot);
+		const VectorRegister4Float PosZ = VectorLoad(Z + Slot);
+		const VectorRegister4Float DiffX = VectorSubtract(VectorLoad(TX + Slot), PosX);
+		const VectorRegister4Float DiffY = VectorSubtract(VectorLoad(TY + Slot), PosY);
+		const VectorRegister4Float DiffZ = VectorSubtract(VectorLoad(TZ + Slot), PosZ);
+
+		const VectorRegister4Float DistSqr = VectorMultiplyAdd(DiffX, DiffX,
+			VectorMultiplyAdd(DiffY, DiffY, VectorMultiply(DiffZ, DiffZ)));
+		const VectorRegister4Float Dist = VectorSqrt(DistSqr);
+		const VectorRegister4Float StepDist = VectorMultiply(VectorLoad(Speeds.GetData() + Slot), DeltaTimeVec);
+
+		// The actors closer than a step snap to the target, the rest cover the step's fraction of the remaining distance
+		const VectorRegister4Float ArrivedMask = VectorCompareLE(Dist, StepDist);
+		const VectorRegister4Float Fraction = VectorSelect(ArrivedMask, One, VectorDivide(StepDist, Dist));
+
+		VectorStore(VectorMultiplyAdd(DiffX, Fraction, PosX), X + Slot);
+		VectorStore(VectorMultiplyAdd(DiffY, Fraction, PosY), Y + Slot);
+		VectorStore(VectorMultiplyAdd(DiffZ, Fraction, PosZ), Z + Slot);
+
+		CollectLanes(Slot, VectorMaskBits(VectorCompareGT(DistSqr, Zero)), VectorMaskBits(ArrivedMask));
+	}
+
+	// The tail
+	for (; Slot < NumMoving; ++Slot)
+	{
+		const FVector3f Diff(TX[Slot] - X[Slot], TY[Slot] - Y[Slot], TZ[Slot] - Z[Slot]);
+		const float Dist = Diff.Size();
+		const float StepDist = Speeds[Slot] * DeltaTime;
+		const bool bArrived = Dist <= StepDist;
+		const float Fraction = bArrived ? 1.f : StepDist / Dist;
+
+		X[Slot] += Diff.X * Fraction;
+		Y[Slot] += Diff.Y * Fraction;
+		Z[Slot] += Diff.Z * Fraction;
+
+		CollectLanes(Slot, Dist > 0.f ? 1 : 0, bArrived ? 1 : 0);
+	}
+
+	// Only the moved ones get their transforms updated
+	for (const int32 DirtySlot : DirtySlots)
+	{
+		AGS_GameActorBase* Actor = MovingActors[DirtySlot];
+		if (IsValid(Actor))
+		{
+			Actor->SetActorLocation(FVector(X[DirtySlot], Y[DirtySlot], Z[DirtySlot]));
+		}
+	}
+
+	// Slots are collected in ascending order, so removing them from the back keeps the rest valid
+	for (int32 Index = ArrivedSlots.Num() - 1; Index >= 0; --Index)
+	{
+		RemoveAtSwap(ArrivedSlots[Index]);
+	}
+}
+
+TStatId UGS_MovementInterpolatorSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGS_MovementInterpolatorSubsystem, STATGROUP_Tickables);
+}
+
+void UGS_MovementInterpolatorSubsystem::MoveTo(AGS_GameActorBase* InActor, const FVector& InTargetLocation,
+                                                float InDuration)
+{
+	if (InActor == nullptr)
+	{
+		return;
+	}
+
+	const FVector CurrentLocation = InActor->GetActorLocation();
+	if (InDuration < SMALL_NUMBER)
+	{
+		Stop(InActor);
+		InActor->SetActorLocation(InTargetLocation);
+		return;
+	}
+
+	int32 Slot = INDEX_NONE;
+	if (const int32* FoundSlot = ActorToSlot.Find(InActor))
+	{
+		Slot = *FoundSlot;
+	}
+	else
+	{
+		Slot = MovingActors.Add(InActor);
+		LocationsX.Add(CurrentLocation.X);
+		LocationsY.Add(CurrentLocation.Y);
+		LocationsZ.Add(CurrentLocation.Z);
+		TargetsX.AddUninitialized();
+		TargetsY.AddUninitialized();
+		TargetsZ.AddUninitialized();
+		Speeds.AddUninitialized();
+		ActorToSlot.Add(InActor, Slot);
+	}
+
+	TargetsX[Slot] = InTargetLocation.X;
+	TargetsY[Slot] = InTargetLocation.Y;
+	TargetsZ[Slot] = InTargetLocation.Z;
+	Speeds[Slot] = FVector::Dist(CurrentLocation, InTargetLocation) / InDuration;
+}
+
+void UGS_MovementInterpolatorSubsystem::Stop(const AGS_GameActorBase* InActor)
+{
+	if (const int32* FoundSlot = ActorToSlot.Find(InActor))
+	{
+		RemoveAtSwap(*FoundSlot);
+	}
+}
+
+int32 UGS_MovementInterpolatorSubsystem::GetNumMoving() const
+{
+	return MovingActors.Num();
+}
+
+bool UGS_MovementInterpolatorSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UGS_MovementInterpolatorSubsystem::RemoveAtSwap(int32 InSlot)
+{
+	ActorToSlot.Remove(MovingActors[InSlot]);
+
+	const int32 LastSlot = MovingActors.Num() - 1;
+	if (InSlot != LastSlot)
+	{
+		ActorToSlot.Add(MovingActors[LastSlot], InSlot);
+	}
+
+	MovingActors.RemoveAtSwap(InSlot, 1, false);
+	LocationsX.RemoveAtSwap(InSlot, 1, false);
+	LocationsY.RemoveAtSwap(InSlot, 1, false);
+	LocationsZ.RemoveAtSwap(InSlot, 1, false);
+	TargetsX.RemoveAtSwap(InSlot, 1, false);
+	TargetsY.RemoveAtSwap(InSlot, 1, false);
+	TargetsZ.RemoveAtSwap(InSlot, 1, false);
+	Speeds.RemoveAtSwap(InSlot, 1, false);
+}
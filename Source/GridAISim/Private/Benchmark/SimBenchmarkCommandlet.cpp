@@ -0,0 +1,574 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Benchmark/SimBenchmarkCommandlet.h"
+
+#include "Grid/Pathfinder.h"
+#include "GridAISim/GridAISim.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Simulation/GridSimulation.h"
+#include "Simulation/SimVecEnv.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogSimBenchmark, Log, All);
+
+namespace
+{
+	enum class EObstacleLayout : uint8
+	{
+		// Single obstacle cells all over the grid
+		Scatter,
+		// Straight wall segments, which make the paths go around them
+		Walls
+	};
+
+	struct FBenchmarkTopology
+	{
+		const TCHAR* Name = nullptr;
+		EGridType GridType = EGridType::Rectangular;
+		EObstacleLayout Layout = EObstacleLayout::Scatter;
+	};
+
+	// The benchmark matrix
+	constexpr int32 GridSizes[] = {100, 500, 1000, 2000};
+	constexpr int32 UnitCounts[] = {100, 1000, 10000};
+	constexpr float ObstacleDensities[] = {0.f, 0.1f, 0.3f};
+	const FBenchmarkTopology Topologies[] = {
+		{TEXT("Rect"), EGridType::Rectangular, EObstacleLayout::Scatter},
+		{TEXT("Hex"), EGridType::Hexagonal, EObstacleLayout::Scatter},
+		{TEXT("Oct"), EGridType::Octagonal, EObstacleLayout::Scatter},
+		{TEXT("RectWalls"), EGridType::Rectangular, EObstacleLayout::Walls},
+	};
+
+	// Every scenario is generated from the same seed, so the runs are comparable
+	constexpr int32 ScenarioSeed = 0x5EED;
+
+	// The units take at most this fraction of the free cells, the denser scenarios are skipped
+	constexpr float MaxUnitOccupancy = 0.25f;
+	constexpr int32 MaxPlacementAttempts = 32;
+	constexpr int32 WallLength = 8;
+
+	// The pathfinder is quadratic in the number of the explored nodes, so the queries are kept local
+	constexpr int32 PathQueryRadius = 16;
+	constexpr int32 PathQueriesPerIteration = 8;
+	// The landmarks of the FindPathALT benchmark, built before the measurements
+	constexpr int32 PathLandmarks = 8;
+
+	// The training setup of the VecEnv benchmark, small grids in large numbers
+	constexpr int32 VecEnvCount = 256;
+	constexpr int32 VecEnvGridSize = 32;
+	constexpr int32 VecEnvUnitsPerTeam = 8;
+
+	// The steps made before the measurements, so the target cache is filled
+	constexpr int32 WarmupSteps = 2;
+
+	// The timing differences below this are noise, whatever the threshold is
+	constexpr double MinRegressionMs = 0.01;
+
+	struct FBenchmarkScenario
+	{
+		FString Name;
+		int32 GridSize = 0;
+		int32 NumUnits = 0;
+		float ObstacleDensity = 0.f;
+		const FBenchmarkTopology* Topology = nullptr;
+	};
+
+	struct FBenchmarkResult
+	{
+		double MedianMs = 0.0;
+		double P99Ms = 0.0;
+		// The heap allocations per sample
+		double Allocations = 0.0;
+		int32 NumSamples = 0;
+	};
+
+	// Keyed by "Scenario/Benchmark"
+	using FBenchmarkResults = TMap<FString, FBenchmarkResult>;
+
+	double Percentile(const TArray<double>& InSortedSamples, double InFraction)
+	{
+		const int32 Index = FMath::CeilToInt(InFraction * InSortedSamples.Num()) - 1;
+		return InSortedSamples[FMath::Clamp(Index, 0, InSortedSamples.Num() - 1)];
+	}
+
+	bool MakeResult(TArray<double>& InSamples, int64 InTotalAllocations, FBenchmarkResult& OutResult)
+	{
+		if (InSamples.Num() == 0)
+		{
+			return false;
+		}
+
+		InSamples.Sort();
+		OutResult.MedianMs = Percentile(InSamples, 0.5);
+		OutResult.P99Ms = Percentile(InSamples, 0.99);
+		OutResult.Allocations = StaticCast<double>(InTotalAllocations) / InSamples.Num();
+		OutResult.NumSamples = InSamples.Num();
+		return true;
+	}
+
+	double CyclesToMs(uint64 InStartCycles)
+	{
+		return FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - InStartCycles);
+	}
+
+	/**
+	 * Fills the simulation with the obstacles and the units of the scenario.
+	 * The red team takes the left half of the grid, the blue team the right one.
+	 * @return False, if the scenario doesn't fit the grid
+	 */
+	bool BuildScenario(const FBenchmarkScenario& InScenario, FGridSimulation& OutSimulation)
+	{
+		const int32 Size = InScenario.GridSize;
+		const int32 NumCells = Size * Size;
+		if (InScenario.NumUnits > NumCells * (1.f - InScenario.ObstacleDensity) * MaxUnitOccupancy)
+		{
+			return false;
+		}
+
+		OutSimulation.Init(Size, Size, InScenario.Topology->GridType);
+		FGrid& Grid = OutSimulation.GetGrid();
+		FRandomStream Stream(ScenarioSeed);
+
+		// The overlapping obstacles make the actual density slightly lower, which is the same for every run
+		const int32 NumObstacles = FMath::RoundToInt(NumCells * InScenario.ObstacleDensity);
+		if (InScenario.Topology->Layout == EObstacleLayout::Scatter)
+		{
+			for (int32 Index = 0; Index < NumObstacles; ++Index)
+			{
+				Grid.SetObstacle({Stream.RandRange(0, Size - 1), Stream.RandRange(0, Size - 1)}, true);
+			}
+		}
+		else
+		{
+			for (int32 Placed = 0; Placed < NumObstacles; Placed += WallLength)
+			{
+				const FIntPoint Start{Stream.RandRange(0, Size - 1), Stream.RandRange(0, Size - 1)};
+				const FIntPoint Direction = Stream.RandRange(0, 1) ? FIntPoint{1, 0} : FIntPoint{0, 1};
+				for (int32 Offset = 0; Offset < WallLength; ++Offset)
+				{
+					Grid.SetObstacle(Start + Direction * Offset, true);
+				}
+			}
+		}
+		Grid.UpdateComponents();
+
+		for (int32 Index = 0; Index < InScenario.NumUnits; ++Index)
+		{
+			FUnitState Unit;
+			Unit.Team = Index % 2 ? ETeam::BlueTeam : ETeam::RedTeam;
+			Unit.Health = Stream.FRandRange(1.f, 10.f);
+			Unit.AttackPower = Stream.FRandRange(1.f, 10.f);
+			Unit.AttackRange = Stream.RandRange(1, 2);
+
+			const int32 MinX = Unit.Team == ETeam::RedTeam ? 0 : Size / 2;
+			for (int32 Attempt = 0; Attempt < MaxPlacementAttempts; ++Attempt)
+			{
+				Unit.Cell = FIntPoint{Stream.RandRange(MinX, MinX + Size / 2 - 1), Stream.RandRange(0, Size - 1)};
+				if (Grid.At(Unit.Cell).IsFree())
+				{
+					OutSimulation.AddUnit(Unit);
+					break;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * Picks the path queries of the scenario. The goal of every query is reachable from its start
+	 * within the query radius, so the search never has to flood the whole grid.
+	 */
+	void MakePathQueries(const FGrid& InGrid, int32 InNumQueries, int32 InFootprintSize,
+	                     TArray<TPair<FIntPoint, FIntPoint>>& OutQueries)
+	{
+		const FIntPoint Size = InGrid.GetSize();
+		FRandomStream Stream(ScenarioSeed + 1);
+
+		TArray<FIntPoint> Reached;
+		TSet<FIntPoint> Visited;
+		for (int32 Attempt = 0; Attempt < InNumQueries * MaxPlacementAttempts && OutQueries.Num() < InNumQueries;
+		     ++Attempt)
+		{
+			const FIntPoint Start{Stream.RandRange(0, Size.X - 1), Stream.RandRange(0, Size.Y - 1)};
+			if (!InGrid.At(Start).IsFree() || !InGrid.CanFit(Start, InFootprintSize))
+			{
+				continue;
+			}
+
+			// Flood the free cells around the start, the queue is the array of the reached cells itself
+			Reached.Reset();
+			Visited.Reset();
+			Reached.Add(Start);
+			Visited.Add(Start);
+			for (int32 Index = 0; Index < Reached.Num(); ++Index)
+			{
+				for (const FGridPoint& Point : InGrid.GetNodeConnections(InGrid.At(Reached[Index])))
+				{
+					const FIntPoint Offset = Point.GridCoords - Start;
+					if (Point.IsFree() && Point.Clearance >= InFootprintSize && FMath::Abs(Offset.X) <= PathQueryRadius
+						&& FMath::Abs(Offset.Y) <= PathQueryRadius && !Visited.Contains(Point.GridCoords))
+					{
+						Visited.Add(Point.GridCoords);
+						Reached.Add(Point.GridCoords);
+					}
+				}
+			}
+
+			// The later cells are the further ones
+			if (Reached.Num() > 1)
+			{
+				const int32 GoalIndex = Stream.RandRange(Reached.Num() / 2, Reached.Num() - 1);
+				OutQueries.Emplace(Start, Reached[GoalIndex]);
+			}
+		}
+	}
+
+	bool RunFindPath(FGridSimulation& InSimulation, int32 InIterations, int32 InFootprintSize,
+	                 FBenchmarkResult& OutResult)
+	{
+		TArray<TPair<FIntPoint, FIntPoint>> Queries;
+		MakePathQueries(InSimulation.GetGrid(), PathQueriesPerIteration, InFootprintSize, Queries);
+
+		GS_Pathfinder& Pathfinder = InSimulation.GetPathfinder();
+		FPathArena Paths;
+		TArray<double> Samples;
+		int64 Allocations = 0;
+		for (int32 Iteration = 0; Iteration < InIterations; ++Iteration)
+		{
+			for (const TPair<FIntPoint, FIntPoint>& Query : Queries)
+			{
+				Path::FNode StartNode;
+				StartNode.XY = Query.Key;
+				Path::FNode EndNode;
+				EndNode.XY = Query.Value;
+
+				const uint64 StartAllocations = FSimAllocationCounter::GetThreadAllocations();
+				const uint64 StartCycles = FPlatformTime::Cycles64();
+				const FPathHandle Path = Pathfinder.FindPath(StartNode, EndNode, Paths, InFootprintSize);
+				Samples.Add(CyclesToMs(StartCycles));
+				Paths.Free(Path);
+				Allocations += FSimAllocationCounter::GetThreadAllocations() - StartAllocations;
+			}
+		}
+		return MakeResult(Samples, Allocations, OutResult);
+	}
+
+	bool RunFindClosest(const FGridSimulation& InSimulation, int32 InIterations, FBenchmarkResult& OutResult)
+	{
+		TArray<FUnitHandle> Handles;
+		Handles.Reserve(InSimulation.GetUnits().Num());
+		InSimulation.GetUnits().ForEachUnit([&Handles](FUnitHandle Handle)
+		{
+			Handles.Add(Handle);
+		});
+
+		// A sample is the search for every unit, the same as a step without the target cache does
+		TArray<double> Samples;
+		int64 Allocations = 0;
+		for (int32 Iteration = 0; Iteration < InIterations; ++Iteration)
+		{
+			const uint64 StartAllocations = FSimAllocationCounter::GetThreadAllocations();
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			for (const FUnitHandle Handle : Handles)
+			{
+				int32 DistanceSqr = 0;
+				InSimulation.FindClosestUnit(Handle, DistanceSqr);
+			}
+			Samples.Add(CyclesToMs(StartCycles));
+			Allocations += FSimAllocationCounter::GetThreadAllocations() - StartAllocations;
+		}
+		return MakeResult(Samples, Allocations, OutResult);
+	}
+
+	bool RunStep(FGridSimulation& InSimulation, int32 InIterations, FBenchmarkResult& OutResult)
+	{
+		for (int32 Step = 0; Step < WarmupSteps && !InSimulation.IsOver(); ++Step)
+		{
+			InSimulation.Step();
+		}
+
+		// The steps go one after another, the same way the game makes them
+		TArray<double> Samples;
+		int64 Allocations = 0;
+		for (int32 Iteration = 0; Iteration < InIterations && !InSimulation.IsOver(); ++Iteration)
+		{
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			InSimulation.Step();
+			Samples.Add(CyclesToMs(StartCycles));
+			Allocations += InSimulation.GetStepCounters().HeapAllocations;
+		}
+		return MakeResult(Samples, Allocations, OutResult);
+	}
+
+	/**
+	 * A sample is a step of all the environments, with the actions left to the utility AI
+	 */
+	bool RunVecEnv(int32 InIterations, FBenchmarkResult& OutResult)
+	{
+		FSimVecEnvConfig Config;
+		Config.NumEnvs = VecEnvCount;
+		Config.SizeX = VecEnvGridSize;
+		Config.SizeY = VecEnvGridSize;
+		Config.UnitsPerTeam = VecEnvUnitsPerTeam;
+		FGridSimVecEnv VecEnv(Config);
+
+		TArray<float> Occupancy, Health, UnitFeatures, Rewards;
+		TArray<uint8> Dones;
+		Occupancy.SetNumZeroed(VecEnv.GetNumPlaneValues());
+		Health.SetNumZeroed(VecEnv.GetNumPlaneValues());
+		UnitFeatures.SetNumZeroed(VecEnv.GetNumUnitFeatureValues());
+		Rewards.SetNumZeroed(VecEnv.GetNumRewardValues());
+		Dones.SetNumZeroed(VecEnv.NumEnvs());
+		const FSimVecEnvBuffers Buffers{Occupancy, Health, UnitFeatures, Rewards, Dones};
+
+		TArray<EUnitAction> Actions;
+		Actions.Init(EUnitAction::MAX, VecEnv.NumEnvs() * VecEnv.NumUnitsPerEnv());
+		if (!VecEnv.Reset(ScenarioSeed, Buffers))
+		{
+			return false;
+		}
+
+		// The environments allocate on the worker threads, which the counter doesn't see
+		TArray<double> Samples;
+		for (int32 Iteration = 0; Iteration < InIterations; ++Iteration)
+		{
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			VecEnv.Step(Actions, Buffers);
+			Samples.Add(CyclesToMs(StartCycles));
+		}
+		return MakeResult(Samples, 0, OutResult);
+	}
+
+	bool SaveResults(const FString& InPath, const FBenchmarkResults& InResults)
+	{
+		TArray<FString> Lines;
+		Lines.Add(TEXT("Benchmark,MedianMs,P99Ms,Allocations,Samples"));
+		for (const auto& NameResultPair : InResults)
+		{
+			const FBenchmarkResult& Result = NameResultPair.Value;
+			Lines.Add(FString::Printf(TEXT("%s,%.6f,%.6f,%.2f,%d"), *NameResultPair.Key, Result.MedianMs, Result.P99Ms,
+			                          Result.Allocations, Result.NumSamples));
+		}
+		return FFileHelper::SaveStringArrayToFile(Lines, *InPath);
+	}
+
+	bool LoadResults(const FString& InPath, FBenchmarkResults& OutResults)
+	{
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *InPath))
+		{
+			return false;
+		}
+
+		// The first line is the header
+		for (int32 Index = 1; Index < Lines.Num(); ++Index)
+		{
+			TArray<FString> Fields;
+			if (Lines[Index].ParseIntoArray(Fields, TEXT(",")) != 5)
+			{
+				continue;
+			}
+
+			FBenchmarkResult& Result = OutResults.Add(Fields[0]);
+			Result.MedianMs = FCString::Atod(*Fields[1]);
+			Result.P99Ms = FCString::Atod(*Fields[2]);
+			Result.Allocations = FCString::Atod(*Fields[3]);
+			Result.NumSamples = FCString::Atoi(*Fields[4]);
+		}
+		return true;
+	}
+
+	/**
+	 * @return The number of the benchmarks that regressed against the baseline. The regressions are logged.
+	 */
+	int32 CompareToBaseline(const FBenchmarkResults& InResults, const FBenchmarkResults& InBaseline,
+	                        float InThresholdPercent)
+	{
+		const double Limit = 1.0 + InThresholdPercent / 100.0;
+		auto IsSlower = [Limit](double InCurrent, double InBase)
+		{
+			return InCurrent > InBase * Limit && InCurrent - InBase > MinRegressionMs;
+		};
+
+		int32 NumRegressions = 0;
+		for (const auto& NameResultPair : InResults)
+		{
+			const FBenchmarkResult* Base = InBaseline.Find(NameResultPair.Key);
+			if (Base == nullptr)
+			{
+				continue;
+			}
+
+			const FBenchmarkResult& Current = NameResultPair.Value;
+			// The allocation counts don't depend on the machine, so any growth past the threshold counts
+			if (IsSlower(Current.MedianMs, Base->MedianMs) || IsSlower(Current.P99Ms, Base->P99Ms)
+				|| Current.Allocations > Base->Allocations * Limit + 0.5)
+			{
+				UE_LOG(LogSimBenchmark, Error,
+				       TEXT("%s regressed: median %.3f ms (was %.3f), p99 %.3f ms (was %.3f), allocations %.1f (was %.1f)."),
+				       *NameResultPair.Key, Current.MedianMs, Base->MedianMs, Current.P99Ms, Base->P99Ms,
+				       Current.Allocations, Base->Allocations);
+				++NumRegressions;
+			}
+		}
+		return NumRegressions;
+	}
+}
+
+UGS_SimBenchmarkCommandlet::UGS_SimBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UGS_SimBenchmarkCommandlet::Main(const FString& Params)
+{
+	int32 Iterations = 20;
+	FParse::Value(*Params, TEXT("iterations="), Iterations);
+	Iterations = FMath::Max(1, Iterations);
+
+	FString Filter;
+	FParse::Value(*Params, TEXT("filter="), Filter);
+
+	const FString BenchmarksDir = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"));
+	FString BaselinePath = FPaths::Combine(BenchmarksDir, TEXT("SimBaseline.csv"));
+	FParse::Value(*Params, TEXT("baseline="), BaselinePath);
+
+	float ThresholdPercent = 10.f;
+	FParse::Value(*Params, TEXT("threshold="), ThresholdPercent);
+
+	const bool bSaveBaseline = FParse::Param(*Params, TEXT("savebaseline"));
+
+	// Every benchmark reports the heap allocations it made, which are only counted from the startup on
+	if (!FSimAllocationCounter::IsEnabled())
+	{
+		UE_LOG(LogSimBenchmark, Warning, TEXT("The heap allocations are not counted, run with -GridSimCountAllocations."));
+	}
+
+	// The per-action logs of the simulation would be measured instead of the simulation itself
+	const ELogVerbosity::Type SimLogVerbosity = LogSim.GetVerbosity();
+	LogSim.SetVerbosity(ELogVerbosity::Error);
+
+	FBenchmarkResults Results;
+	FGridSimulation Simulation;
+	for (const int32 GridSize : GridSizes)
+	{
+		for (const int32 NumUnits : UnitCounts)
+		{
+			for (const float ObstacleDensity : ObstacleDensities)
+			{
+				for (const FBenchmarkTopology& Topology : Topologies)
+				{
+					FBenchmarkScenario Scenario;
+					Scenario.Name = FString::Printf(TEXT("G%d_U%d_O%d_%s"), GridSize, NumUnits,
+					                                FMath::RoundToInt(ObstacleDensity * 100.f), Topology.Name);
+					Scenario.GridSize = GridSize;
+					Scenario.NumUnits = NumUnits;
+					Scenario.ObstacleDensity = ObstacleDensity;
+					Scenario.Topology = &Topology;
+
+					if (!Filter.IsEmpty() && !Scenario.Name.Contains(Filter))
+					{
+						continue;
+					}
+
+					if (!BuildScenario(Scenario, Simulation))
+					{
+						UE_LOG(LogSimBenchmark, Display, TEXT("%s is skipped, the units don't fit the grid."),
+						       *Scenario.Name);
+						continue;
+					}
+
+					// The step goes last, as it changes the scenario
+					FBenchmarkResult Result;
+					if (RunFindPath(Simulation, Iterations, 1, Result))
+					{
+						Results.Add(Scenario.Name + TEXT("/FindPath"), Result);
+					}
+					if (RunFindPath(Simulation, Iterations, 2, Result))
+					{
+						Results.Add(Scenario.Name + TEXT("/FindPath2x2"), Result);
+					}
+
+					GS_Pathfinder& Pathfinder = Simulation.GetPathfinder();
+					Pathfinder.SetNumLandmarks(PathLandmarks);
+					Pathfinder.UpdateLandmarks();
+					if (RunFindPath(Simulation, Iterations, 1, Result))
+					{
+						Results.Add(Scenario.Name + TEXT("/FindPathALT"), Result);
+					}
+					Pathfinder.SetNumLandmarks(0);
+					if (RunFindClosest(Simulation, Iterations, Result))
+					{
+						Results.Add(Scenario.Name + TEXT("/FindClosestUnit"), Result);
+					}
+					if (RunStep(Simulation, Iterations, Result))
+					{
+						Results.Add(Scenario.Name + TEXT("/Step"), Result);
+					}
+				}
+			}
+		}
+	}
+
+	const FString VecEnvName = FString::Printf(TEXT("VecEnv_E%d_G%d_U%d"), VecEnvCount, VecEnvGridSize,
+	                                           VecEnvUnitsPerTeam * 2);
+	FBenchmarkResult VecEnvResult;
+	if ((Filter.IsEmpty() || VecEnvName.Contains(Filter)) && RunVecEnv(Iterations, VecEnvResult))
+	{
+		Results.Add(VecEnvName + TEXT("/Step"), VecEnvResult);
+	}
+
+	LogSim.SetVerbosity(SimLogVerbosity);
+
+	for (const auto& NameResultPair : Results)
+	{
+		const FBenchmarkResult& Result = NameResultPair.Value;
+		UE_LOG(LogSimBenchmark, Display, TEXT("%-48s median %10.4f ms, p99 %10.4f ms, allocations %10.1f"),
+		       *NameResultPair.Key, Result.MedianMs, Result.P99Ms, Result.Allocations);
+	}
+
+	const FString ResultsPath = FPaths::Combine(BenchmarksDir,
+	                                            FString::Printf(TEXT("SimBenchmark-%s.csv"), *FDateTime::Now().ToString()));
+	if (!SaveResults(ResultsPath, Results))
+	{
+		UE_LOG(LogSimBenchmark, Error, TEXT("Failed to write %s."), *ResultsPath);
+		return 1;
+	}
+	UE_LOG(LogSimBenchmark, Display, TEXT("The results are written to %s."), *ResultsPath);
+
+	if (bSaveBaseline)
+	{
+		if (!SaveResults(BaselinePath, Results))
+		{
+			UE_LOG(LogSimBenchmark, Error, TEXT("Failed to write the baseline %s."), *BaselinePath);
+			return 1;
+		}
+		UE_LOG(LogSimBenchmark, Display, TEXT("The baseline is saved to %s."), *BaselinePath);
+		return 0;
+	}
+
+	FBenchmarkResults Baseline;
+	if (!LoadResults(BaselinePath, Baseline))
+	{
+		UE_LOG(LogSimBenchmark, Warning, TEXT("No baseline at %s, run with -savebaseline to create one."),
+		       *BaselinePath);
+		return 0;
+	}
+
+	const int32 NumRegressions = CompareToBaseline(Results, Baseline, ThresholdPercent);
+	if (NumRegressions > 0)
+	{
+		UE_LOG(LogSimBenchmark, Error, TEXT("%d benchmarks regressed by more than %.1f%%."), NumRegressions,
+		       ThresholdPercent);
+		return 1;
+	}
+
+	UE_LOG(LogSimBenchmark, Display, TEXT("No regressions against %s."), *BaselinePath);
+	return 0;
+}
@@ -2,11 +2,17 @@
 
 
 #include "GameModes/GameModeDefault.h"
+#include "Actors/ActorPoolSubsystem.h"
+#include "Actors/CrowdRenderer.h"
 #include "Actors/GameActorBase.h"
-#include "Grid/GridTestActor.h"
-#include "Grid/Pathfinder.h"
+#include "Grid/GridDebugOverlayComponent.h"
 #include "GridAISim/GridAISim.h"
 
+static TAutoConsoleVariable<int32> CVarDebugOverlay(
+	TEXT("GridSim.DebugOverlay"),
+	0,
+	TEXT("Layers of the grid debug overlay to draw, as a bitmask. 0: off, 1: grid, 2: occupancy, 4: paths, 8: field."),
+	ECVF_Cheat);
 
 AGS_GameModeDefault::AGS_GameModeDefault(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
@@ -17,44 +23,41 @@ AGS_GameModeDefault::AGS_GameModeDefault(const FObjectInitializer& ObjectInitial
 	bStartPlayersAsSpectators = true;
 	ActorClass = AGS_GameActorBase::StaticClass();
 
-	//GS_Pathfinder = MakeUnique<IT_GS_Pathfinder>();
-	Pathfinder = MakePimpl<GS_Pathfinder>();
-}
-
-void AGS_GameModeDefault::TestGrid()
-{
-	for (auto& Point : Grid.GetGrid())
-	{
-		if (auto* const World = GetWorld())
-		{
-			FTransform SpawnTransform;
-			SpawnTransform.SetLocation(GridToGlobal(Point.GridCoords));
-			FActorSpawnParameters Params;
-			Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-			AGS_GridTestActor* GridActor = World->SpawnActor<AGS_GridTestActor>(
-				GridActorDummyClass, SpawnTransform, Params);
-			GridActor->DebugText.Append(FString::FromInt(Point.Index)).Append("\n").Append(Point.GridCoords.ToString());
-		}
-	}
+	DebugOverlay = CreateDefaultSubobject<UGS_GridDebugOverlayComponent>(TEXT("DebugOverlay"));
 }
 
 void AGS_GameModeDefault::PostInitializeComponents()
 {
 	Super::PostInitializeComponents();
 
-	Grid.Init(GridSizeX, GridSizeY, EGridType::Rectangular);
+	Simulation.Init(GridSizeX, GridSizeY, EGridType::Rectangular);
+	Simulation.SetTargetHysteresis(TargetHysteresisCells);
 
-	if (Pathfinder.IsValid())
+	// The checkpoints and the replay recorder belong to the simulation thread while it's launched
+	SimulationThread.SetOnStepped([this](const FGridSimulation& InSimulation)
 	{
-		Pathfinder->InitGraph(Grid);
-	}
+		if (bRecordCheckpoints)
+		{
+			Checkpoints.Capture(InSimulation.GetStep(), InSimulation.GetUnits(), InSimulation.GetGrid());
+		}
+		ReplayRecorder.RecordStep(InSimulation.GetStepEvents());
+	});
 }
 
 void AGS_GameModeDefault::Tick(float DeltaSeconds)
 {
 	Super::Tick(DeltaSeconds);
 
-	if (bSimulationOngoing)
+	if (SimulationThread.IsLaunched())
+	{
+		// The steps are made by the simulation thread, only their results are played here
+		ConsumeSimulationThreadResults();
+		if (bSimulationOngoing && AppliedFrame.bIsOver)
+		{
+			EndSimulation();
+		}
+	}
+	else if (bSimulationOngoing)
 	{
 		TimeStepAccumulator += DeltaSeconds;
 
@@ -65,18 +68,58 @@ void AGS_GameModeDefault::Tick(float DeltaSeconds)
 			TimeStepAccumulator = 0.f;
 		}
 	}
+	else if (bReplayPlaybackOngoing)
+	{
+		TimeStepAccumulator += DeltaSeconds;
+
+		if (TimeStepAccumulator >= ReplayPlayer.GetHeader().StepDuration)
+		{
+			MakeReplayPlaybackStep();
+
+			TimeStepAccumulator = 0.f;
+		}
+	}
+
+	UpdateCrowdRenderer();
+	UpdateDebugOverlayLayers();
 }
 
 void AGS_GameModeDefault::BeginPlay()
 {
 	Super::BeginPlay();
 
+	if (auto* ActorPool = GetWorld()->GetSubsystem<UGS_ActorPoolSubsystem>())
+	{
+		for (const auto& ClassCountPair : ActorPoolPrewarmCounts)
+		{
+			ActorPool->Prewarm(ClassCountPair.Key, ClassCountPair.Value);
+		}
+	}
+
+	if (bUseInstancedCrowd)
+	{
+		FActorSpawnParameters Params;
+		Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		CrowdRenderer = GetWorld()->SpawnActor<AGS_CrowdRenderer>(FTransform::Identity, Params);
+	}
+
+	DebugOverlay->SetGrid(GridSizeX, GridSizeY, GridCellSize);
+
 	SpawnActors();
+	UpdateCrowdRenderer();
 
 	// For now, simulation start is triggered from K2_StartSimulation method
 	//StartSimulation();
 }
 
+void AGS_GameModeDefault::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	ShutdownSimulationThread();
+	ReplayRecorder.End();
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void AGS_GameModeDefault::SpawnActorAt(TSubclassOf<AGS_GameActorBase> InActorClass, FIntPoint InGridPoint, ETeam InTeam)
 {
 	UWorld* World = GetWorld();
@@ -86,28 +129,42 @@ void AGS_GameModeDefault::SpawnActorAt(TSubclassOf<AGS_GameActorBase> InActorCla
 		return;
 	}
 
-	AGS_GameActorBase* SpawnedActor = World->SpawnActorDeferred<AGS_GameActorBase>(
-		ActorClass,
-		FTransform(), nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	AGS_GameActorBase* SpawnedActor = AcquireUnitActor(ActorClass, InGridPoint);
+	if (SpawnedActor == nullptr)
+	{
+		return;
+	}
 
 	SpawnedActor->SetTeam(InTeam);
 
+	if (ReplayRecorder.IsRecording())
+	{
+		UE_LOG(LogSim, Display, TEXT("[SpawnActorAt] The replay being recorded won't show %s."),
+		       *GetNameSafe(SpawnedActor));
+	}
+
 	SpawnedActor->SetAttackPower(FMath::RandRange(AttackPowerMin, AttackPowerMax));
 	SpawnedActor->SetHealthPoints(FMath::RandRange(HealthPointsMin, HealthPointsMax));
 
-	FGridPoint& GridPoint = Grid.At(InGridPoint);
-	GridPoint.GameActor = SpawnedActor;
-
-	FTransform SpawnTransform{};
-	SpawnTransform.SetLocation(GridToGlobal(GridPoint.GridCoords));
-
-	GridPoint.GameActor = SpawnedActor;
-	SpawnedActor->SetGridPointIndex(Grid.At(GridPoint.Index).Index);
+	// The grid is written by the simulation thread while it's launched, its latest published state is read instead
+	const FGridPoint& GridPoint = SimulationThread.IsLaunched() ? AppliedFrame.Grid->At(InGridPoint)
+		                              : Simulation.GetGrid().At(InGridPoint);
+	SpawnedActor->SetGridPointIndex(GridPoint.Index);
 	SpawnedActor->SetGridCoordinates(InGridPoint);
 
-	SpawnedActor->FinishSpawning(SpawnTransform);
+	if (SimulationThread.IsLaunched())
+	{
+		// The handle is issued by the simulation thread, the actor waits for it
+		FSimCommand Command;
+		Command.Type = ESimCommandType::Spawn;
+		Command.Unit = MakeUnitState(SpawnedActor);
+		Command.SpawnRequest = NextSpawnRequest++;
+		PendingSpawnActors.Add(Command.SpawnRequest, SpawnedActor);
+		SimulationThread.Enqueue(Command);
+		return;
+	}
 
-	GameActors.Add(SpawnedActor);
+	RegisterUnit(SpawnedActor);
 }
 
 void AGS_GameModeDefault::K2_StartSimulation()
@@ -115,6 +172,43 @@ void AGS_GameModeDefault::K2_StartSimulation()
 	StartSimulation();
 }
 
+void AGS_GameModeDefault::K2_StopSimulation()
+{
+	StopSimulation();
+}
+
+bool AGS_GameModeDefault::K2_RewindToStep(int32 Step)
+{
+	return RewindToStep(Step);
+}
+
+int32 AGS_GameModeDefault::K2_GetSimulationStep() const
+{
+	return SimulationThread.IsLaunched() ? AppliedFrame.Step : Simulation.GetStep();
+}
+
+bool AGS_GameModeDefault::K2_StartReplayPlayback(const FString& InReplayName)
+{
+	return StartReplayPlayback(InReplayName);
+}
+
+bool AGS_GameModeDefault::K2_ValidateCrowdInstances() const
+{
+	if (CrowdRenderer == nullptr)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[K2_ValidateCrowdInstances] The crowd mode is off."))
+		return false;
+	}
+
+	if (SimulationThread.IsLaunched())
+	{
+		UE_LOG(LogSim, Warning, TEXT("[K2_ValidateCrowdInstances] The units are owned by the simulation thread."))
+		return false;
+	}
+
+	return CrowdRenderer->ValidateInstances(Simulation.GetUnits(), UnitActors);
+}
+
 void AGS_GameModeDefault::SpawnActors()
 {
 	UWorld* World = GetWorld();
@@ -124,23 +218,42 @@ void AGS_GameModeDefault::SpawnActors()
 		return;
 	}
 
-	TArray<FGridPoint> SpawnLocations;
+	auto* ActorPool = World->GetSubsystem<UGS_ActorPoolSubsystem>();
+	if (ActorPool == nullptr)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[SpawnActors] Actor pool is not available."));
+		return;
+	}
+
+	// The empty points are picked from the grid and the units registered right away, both owned by the simulation
+	// thread while it's launched. SpawnActorAt queues the spawns to it instead.
+	if (SimulationThread.IsLaunched())
+	{
+		UE_LOG(LogSim, Warning, TEXT("[SpawnActors] The grid is owned by the simulation thread."));
+		return;
+	}
+
+	FGrid& Grid = Simulation.GetGrid();
 	Grid.OnStartSpawningActors();
 	// Spawn actors
 
+	TArray<AGS_GameActorBase*> SpawnedActors;
 	for(const auto ActorTypeClass : ActorClasses)
 	{
-	for (int32 Index = 0; Index < NumberOfActorsPerTeam * 2/*NumberOfTeams*/; ++Index)
+	// The whole army of the class is taken from the pool at once, the missing actors are spawned in one batch
+	SpawnedActors.Reset();
+	ActorPool->AcquireBatch(ActorTypeClass, NumberOfActorsPerTeam * 2/*NumberOfTeams*/, SpawnedActors);
+
+	for (int32 Index = 0; Index < SpawnedActors.Num(); ++Index)
 	{
-		// First create an actor and populate it with required gameplay information
-		AGS_GameActorBase* SpawnedActor = World->SpawnActorDeferred<AGS_GameActorBase>(
-			ActorTypeClass,
-			FTransform(), nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		// First populate the actor with required gameplay information
+		AGS_GameActorBase* SpawnedActor = SpawnedActors[Index];
 
 		SpawnedActor->SetTeam(Index % 2 ? ETeam::BlueTeam : ETeam::RedTeam);
 
 		// Leave these settings here for the further ability to apply GameMode's modifications as well.
 		SpawnedActor->SetActionDuration(SimulationTimeStep_ms);
+		SpawnedActor->SetCrowdRendered(bUseInstancedCrowd);
 		// TODO: Decide how the attribute initialization should look like. Should Gamemode decide the random fraction or just leave it to the actor?
 		SpawnedActor->InitAttributes(0.f, 0.f);
 
@@ -150,251 +263,780 @@ void AGS_GameModeDefault::SpawnActors()
 		//re-make FindRandomEmptyPointOnGrid to return an Index, I guess. Get Point ref by that point then
 		FGridPoint GridPoint;
 		Grid.FindRandomEmptyPointOnGrid(GridPoint);
-		FGridPoint& GridPointRef = Grid.At(GridPoint.Index);
-		if (GridPointRef.GameActor)
+		const FGridPoint& GridPointRef = Grid.At(GridPoint.Index);
+		if (!GridPointRef.IsFree())
 		{
 			UE_LOG(LogSim, Display, TEXT("[SpawnActors] Received an occupied grid point."));
 		}
 		// Do Grid related stuff here.
-		GridPointRef.GameActor = SpawnedActor;
 		SpawnedActor->SetGridPointIndex(GridPointRef.Index);
 		SpawnedActor->SetGridCoordinates(GridPointRef.GridCoords);
 
-
 		// --
 		// Next, with an Actor registered on the Grid, it should know it's Grid coordinates.
-		// Use them to finalize the spawn
-		FTransform FinalTransform;
-		FinalTransform.SetLocation(GridToGlobal(SpawnedActor->GetGridCoordinates()));
-		SpawnedActor->FinishSpawning(FinalTransform);
+		// Use them to place it
+		SpawnedActor->SetActorLocation(GridToGlobal(SpawnedActor->GetGridCoordinates()));
 
-		++(ActorsNumPerTeam.FindOrAdd(SpawnedActor->GetTeam()));
-		GameActors.Add(SpawnedActor);
+		RegisterUnit(SpawnedActor);
 	}
 		
 	} //~ for actor classes
 	Grid.OnFinishSpawningActors();
 }
 
+void AGS_GameModeDefault::RegisterUnit(AGS_GameActorBase* InActor)
+{
+	const FUnitHandle Handle = Simulation.AddUnit(MakeUnitState(InActor));
+	if (Handle == INDEX_NONE)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[RegisterUnit] Failed to register %s."), *GetNameSafe(InActor));
+		ReleaseUnitActor(InActor);
+		return;
+	}
+	SetUnitActor(Handle, InActor);
+}
+
+FUnitState AGS_GameModeDefault::MakeUnitState(const AGS_GameActorBase* InActor) const
+{
+	FUnitState Unit;
+	Unit.Team = InActor->GetTeam();
+	Unit.Cell = InActor->GetGridCoordinates();
+	Unit.Health = InActor->GetHealthPoints();
+	Unit.AttackPower = InActor->GetAttackPower();
+	Unit.AttackRange = InActor->GetAttackRange();
+	return Unit;
+}
+
+void AGS_GameModeDefault::SetUnitActor(FUnitHandle InHandle, AGS_GameActorBase* InActor)
+{
+	InActor->SetUnitHandle(InHandle);
+
+	SetUnitClass(InHandle, InActor->GetClass());
+	UnitActors[InHandle] = InActor;
+}
+
+void AGS_GameModeDefault::SetUnitClass(FUnitHandle InHandle, TSubclassOf<AGS_GameActorBase> InClass)
+{
+	if (!UnitClasses.IsValidIndex(InHandle))
+	{
+		UnitClasses.SetNum(InHandle + 1);
+		UnitActors.SetNum(InHandle + 1);
+	}
+	UnitClasses[InHandle] = InClass;
+}
+
 void AGS_GameModeDefault::StartSimulation()
 {
+	if (SimulationThread.IsLaunched())
+	{
+		FSimCommand Command;
+		Command.Type = ESimCommandType::Start;
+		SimulationThread.Enqueue(Command);
+		bSimulationOngoing = true;
+		return;
+	}
+
 	bSimulationOngoing = true;
+
+	// The initial state, so the very first step can be restored as well
+	if (bRecordCheckpoints && Checkpoints.GetLatestStep() == INDEX_NONE)
+	{
+		Checkpoints.Configure(CheckpointKeyframeInterval, CheckpointMemoryCapKB * 1024ll);
+		Checkpoints.Capture(Simulation.GetStep(), Simulation.GetUnits(), Simulation.GetGrid());
+	}
+
+	if (bRecordReplay && Simulation.GetStep() == 0 && !ReplayRecorder.IsRecording())
+	{
+		BeginReplayRecording();
+	}
+
+	if (bRunSimulationOnThread && LaunchSimulationThread())
+	{
+		FSimCommand Command;
+		Command.Type = ESimCommandType::Start;
+		SimulationThread.Enqueue(Command);
+	}
 }
 
-void AGS_GameModeDefault::EndSimulation()
+void AGS_GameModeDefault::StopSimulation()
 {
 	bSimulationOngoing = false;
-	UE_LOG(LogSim, Display, TEXT("[EndSimulation] Simulation is over."))
-}
 
-void AGS_GameModeDefault::IsSimulationOver()
-{
-	for (auto& TeamActorsNum : ActorsNumPerTeam)
+	if (SimulationThread.IsLaunched())
 	{
-		// Technically we check, if any of teams is the only one that is left on the board.
-		if (TeamActorsNum.Value == GameActors.Num())
-		{
-			EndSimulation();
-			break;
-		}
+		FSimCommand Command;
+		Command.Type = ESimCommandType::Stop;
+		SimulationThread.Enqueue(Command);
 	}
 }
 
+void AGS_GameModeDefault::EndSimulation()
+{
+	bSimulationOngoing = false;
+	ShutdownSimulationThread();
+	ReplayRecorder.End();
+	UE_LOG(LogSim, Display, TEXT("[EndSimulation] Simulation is over."))
+}
+
 void AGS_GameModeDefault::MakeSimulationTurn()
 {
 	// If there is just one, or even no Actors - cease the simulation
 	// TODO: remove or modify this condition into "CanStartSimultaionTurn" 
-	if (GameActors.Num() <= 1)
+	if (Simulation.GetUnits().Num() <= 1)
 	{
 		UE_LOG(LogSim, Display, TEXT("[MakeSimulationTurn] Simulation is over."))
 		bSimulationOngoing = false;
 		return;
 	}
 
-	// for each actor:
-	for (auto* Actor : GameActors)
+	Simulation.Step();
+
+	// Drawn before the squads are planned again for the next step, the paths are the ones of this step
+	UpdateDebugOverlay();
+
+	// The targets of the next step are chosen on the worker threads, while the actors play this one
+	if (!Simulation.IsOver())
+	{
+		Simulation.PrepareStep();
+	}
+
+	const FSimStepEvents& StepEvents = Simulation.GetStepEvents();
+	ApplyStepEvents(StepEvents, Simulation.GetDamagedUnits(),
+	                [this](FUnitHandle InHandle) { return GetUnitActor(InHandle); },
+	                [this](FUnitHandle InHandle) { return Simulation.GetUnits().GetHealth(InHandle); },
+	                SimulationTimeStep_ms);
+	for (const FSimDeathEvent& Death : StepEvents.Deaths)
+	{
+		UnitActors[Death.Unit] = nullptr;
+	}
+
+	if (bRecordCheckpoints)
+	{
+		Checkpoints.Capture(Simulation.GetStep(), Simulation.GetUnits(), Simulation.GetGrid());
+	}
+	ReplayRecorder.RecordStep(StepEvents);
+
+	// Check simulation end conditions
+	if (Simulation.IsOver())
 	{
-		// find closest
-		int32 DistanceSqr = 0;
-		if (auto* TargetActor = FindClosestActor(Actor, DistanceSqr))
+		EndSimulation();
+	}
+}
+
+void AGS_GameModeDefault::ApplyStepEvents(const FSimStepEvents& InEvents, TConstArrayView<FUnitHandle> InDamagedUnits,
+                                          TFunctionRef<AGS_GameActorBase*(FUnitHandle)> InGetActor,
+                                          TFunctionRef<float(FUnitHandle)> InGetHealth, float InStepDuration)
+{
+	for (const FSimMoveEvent& Move : InEvents.Moves)
+	{
+		if (AGS_GameActorBase* Actor = InGetActor(Move.Unit))
 		{
-			if (DistanceSqr <= FMath::Square(Actor->GetAttackRange()))
-			{
-				ActorAttack(TargetActor, Actor);
-			}
-			else
-			{
-				ActorMoveTowards(TargetActor, Actor);
-			}
+			const FIntPoint Coordinates = GetGridPoint(Move.CellIndex).GridCoords;
+			Actor->SetGridPointIndex(Move.CellIndex);
+			Actor->SetGridCoordinates(Coordinates);
+			Actor->MoveActorInterp(GridToGlobal(Coordinates), InStepDuration);
 		}
-		else
+	}
+
+	for (const FSimAttackEvent& Attack : InEvents.Attacks)
+	{
+		if (AGS_GameActorBase* Actor = InGetActor(Attack.Unit))
+		{
+			Actor->PlayAttack(InGetActor(Attack.Target));
+		}
+	}
+
+	for (const FUnitHandle Handle : InEvents.Halts)
+	{
+		if (AGS_GameActorBase* Actor = InGetActor(Handle))
 		{
 			Actor->Halt();
-			UE_LOG(LogSim, Warning,
-			       TEXT("[MakeSimulationTurn] Failed to find the closest actor."));
 		}
 	}
 
-	// Clean-up
-	for (auto* Actor : KilledGameActors)
+	// The actors only get the copies of the health for the visuals
+	for (const FUnitHandle Handle : InDamagedUnits)
 	{
-		GameActors.Remove(Actor);
-		// TODO: Let the actor HandleZeroHealth as well as self-destroy
-		//Actor->StartDestroy();
+		if (AGS_GameActorBase* Actor = InGetActor(Handle))
+		{
+			Actor->SetHealthPoints(InGetHealth(Handle));
+			Actor->PlayHit();
+		}
 	}
-	KilledGameActors.Empty();
 
-	// Check simulation end conditions
-	IsSimulationOver();
+	for (const FSimDeathEvent& Death : InEvents.Deaths)
+	{
+		if (AGS_GameActorBase* Actor = InGetActor(Death.Unit))
+		{
+			UE_LOG(LogSim, Display, TEXT("[ApplyStepEvents] %s is killed by %s."),
+			       *GetNameSafe(Actor), *GetNameSafe(InGetActor(Death.Instigator)));
+			Actor->HandleZeroHealth();
+		}
+	}
 }
 
-AGS_GameActorBase* AGS_GameModeDefault::FindClosestActor(AGS_GameActorBase* InActor, int32& OutDistanceSqr)
+bool AGS_GameModeDefault::LaunchSimulationThread()
 {
-	AGS_GameActorBase* TargetActor = nullptr;
+	// The thread publishes the differences from this state
+	AppliedFrame.Capture(Simulation);
 
-	if (InActor == nullptr)
+	if (!SimulationThread.Launch(SimulationTimeStep_ms))
+	{
+		UE_LOG(LogSim, Warning, TEXT("[LaunchSimulationThread] The simulation runs on the game thread."))
+		return false;
+	}
+	return true;
+}
+
+void AGS_GameModeDefault::ShutdownSimulationThread()
+{
+	if (!SimulationThread.IsLaunched())
+	{
+		return;
+	}
+
+	SimulationThread.Shutdown();
+	ConsumeSimulationThreadResults();
+
+	// Their spawn commands were dropped with the thread. The frame with the units of all the results is published
+	// before the results are, so none of the results is left pending.
+	for (const auto& RequestActorPair : PendingSpawnActors)
+	{
+		ReleaseUnitActor(RequestActorPair.Value);
+	}
+	PendingSpawnActors.Reset();
+	PendingSpawnResults.Reset();
+}
+
+void AGS_GameModeDefault::ConsumeSimulationThreadResults()
+{
+	if (const FSimFrame* Frame = SimulationThread.ConsumeFrame())
+	{
+		ApplySimulationFrame(*Frame);
+	}
+
+	FSimSpawnResult SpawnResult;
+	while (SimulationThread.DequeueSpawnResult(SpawnResult))
 	{
-		UE_LOG(LogSim, Warning, TEXT("[FindClosestActor] Use of null pointer."))
-		return TargetActor;
+		PendingSpawnResults.Add(SpawnResult);
 	}
 
-	int32 ClosestDist = -1;
-	AGS_GameActorBase* ClosestTarget = nullptr;
-	// TODO: upon adding new actors, put them into separate arrays, and iterate through the opponents array here.
-	for (auto* Actor : GameActors)
+	// The result may come before the applied frame has the unit. Bound right away, the actor would miss the changes
+	// of the unit up to the frame, which has it, e.g. its death, so the result waits for that frame.
+	for (int32 ResultIndex = 0; ResultIndex < PendingSpawnResults.Num(); ++ResultIndex)
 	{
-		if (Actor == InActor || !Actor->IsAlive())
+		SpawnResult = PendingSpawnResults[ResultIndex];
+		if (SpawnResult.Unit != INDEX_NONE && !AppliedFrame.Units.IsValidIndex(SpawnResult.Unit))
 		{
 			continue;
 		}
+		PendingSpawnResults.RemoveAt(ResultIndex--, 1, false);
 
-		if (InActor->GetTeam() != Actor->GetTeam())
+		AGS_GameActorBase* Actor = nullptr;
+		PendingSpawnActors.RemoveAndCopyValue(SpawnResult.SpawnRequest, Actor);
+		if (Actor == nullptr)
 		{
-			FIntPoint Diff = InActor->GetGridCoordinates() - Actor->GetGridCoordinates();
-			const int32 DistSqr = FIntPoint(InActor->GetGridCoordinates() - Actor->GetGridCoordinates()).SizeSquared();
+			continue;
+		}
+
+		if (SpawnResult.Unit == INDEX_NONE)
+		{
+			UE_LOG(LogSim, Warning, TEXT("[ConsumeSimulationThreadResults] Failed to register %s."), *GetNameSafe(Actor));
+			ReleaseUnitActor(Actor);
+			continue;
+		}
+
+		// The unit may have acted already in the applied frame. Its class is kept even if it's dead,
+		// the checkpoints captured by the simulation thread may still have it alive.
+		const FSimFrameUnit& Unit = AppliedFrame.Units[SpawnResult.Unit];
+		if (!Unit.IsAlive())
+		{
+			SetUnitClass(SpawnResult.Unit, Actor->GetClass());
+			ReleaseUnitActor(Actor);
+			continue;
+		}
+
+		const FGridPoint& GridPoint = GetGridPoint(Unit.CellIndex);
+		Actor->SetActorLocation(GridToGlobal(GridPoint.GridCoords));
+		Actor->SetGridPointIndex(GridPoint.Index);
+		Actor->SetGridCoordinates(GridPoint.GridCoords);
+		Actor->SetHealthPoints(Unit.Health);
+		SetUnitActor(SpawnResult.Unit, Actor);
+	}
+}
+
+void AGS_GameModeDefault::ApplySimulationFrame(const FSimFrame& InFrame)
+{
+	FrameStepEvents.Reset(InFrame.Step);
+	FrameDamagedUnits.Reset();
+
+	// The frames are the full states, the ones published in between the game frames are skipped
+	for (FUnitHandle Handle = 0; Handle < InFrame.Units.Num(); ++Handle)
+	{
+		// The units spawned since the applied frame are placed by their spawn results
+		if (!AppliedFrame.Units.IsValidIndex(Handle) || !AppliedFrame.Units[Handle].IsAlive())
+		{
+			continue;
+		}
+
+		const FSimFrameUnit& Unit = InFrame.Units[Handle];
+		const FSimFrameUnit& AppliedUnit = AppliedFrame.Units[Handle];
+		if (Unit.Health < AppliedUnit.Health)
+		{
+			FrameDamagedUnits.Add(Handle);
+		}
 
-			if ((ClosestDist < 0) || (DistSqr < ClosestDist))
+		if (!Unit.IsAlive())
+		{
+			FSimDeathEvent& Death = FrameStepEvents.Deaths.AddDefaulted_GetRef();
+			Death.Unit = Handle;
+			if (const FSimDeathEvent* StepDeath = InFrame.Events.Deaths.FindByPredicate(
+				[Handle](const FSimDeathEvent& InDeath) { return InDeath.Unit == Handle; }))
 			{
-				ClosestDist = DistSqr;
-				ClosestTarget = Actor;
+				Death.Instigator = StepDeath->Instigator;
 			}
+		}
+		else if (Unit.CellIndex != AppliedUnit.CellIndex)
+		{
+			FSimMoveEvent& Move = FrameStepEvents.Moves.AddDefaulted_GetRef();
+			Move.Unit = Handle;
+			Move.CellIndex = Unit.CellIndex;
+		}
+	}
+
+	// The attacks and the halts are only animations, the ones of the skipped steps are dropped
+	if (InFrame.Step != AppliedFrame.Step)
+	{
+		FrameStepEvents.Attacks.Append(InFrame.Events.Attacks);
+		FrameStepEvents.Halts.Append(InFrame.Events.Halts);
+	}
+
+	ApplyStepEvents(FrameStepEvents, FrameDamagedUnits,
+	                [this](FUnitHandle InHandle) { return GetUnitActor(InHandle); },
+	                [&InFrame](FUnitHandle InHandle) { return InFrame.Units[InHandle].Health; },
+	                SimulationTimeStep_ms);
+	for (const FSimDeathEvent& Death : FrameStepEvents.Deaths)
+	{
+		// The unit may still wait for its spawn result
+		if (UnitActors.IsValidIndex(Death.Unit))
+		{
+			UnitActors[Death.Unit] = nullptr;
+		}
+	}
+
+	AppliedFrame.Step = InFrame.Step;
+	AppliedFrame.bIsOver = InFrame.bIsOver;
+	AppliedFrame.Units = InFrame.Units;
+	AppliedFrame.Grid = InFrame.Grid;
+	UpdateDebugOverlay();
+}
+
+AGS_GameActorBase* AGS_GameModeDefault::GetUnitActor(FUnitHandle InHandle) const
+{
+	return UnitActors.IsValidIndex(InHandle) ? UnitActors[InHandle].Get() : nullptr;
+}
+
+bool AGS_GameModeDefault::RewindToStep(int32 InStep)
+{
+	// The checkpoints and the units are needed on the game thread
+	ShutdownSimulationThread();
+
+	FSimSnapshot Snapshot;
+	if (!Checkpoints.Reconstruct(InStep, Snapshot))
+	{
+		UE_LOG(LogSim, Warning, TEXT("[RewindToStep] Step %d is not available. Available steps: [%d, %d]."),
+		       InStep, Checkpoints.GetOldestStep(), Checkpoints.GetLatestStep());
+		return false;
+	}
+
+	UWorld* World = GetWorld();
+	if (World == nullptr)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[RewindToStep] World is nullptr."))
+		return false;
+	}
 
-			// Maybe, this is a good idea to break as soon as we find an actor that is one square away from us.
-			if (DistSqr <= 1)
+	// The simulation stays paused at the restored step
+	bSimulationOngoing = false;
+	TimeStepAccumulator = 0.f;
+
+	// The replay can't follow the timeline jumps
+	if (ReplayRecorder.IsRecording())
+	{
+		UE_LOG(LogSim, Display, TEXT("[RewindToStep] Replay recording is stopped at step %d."), Simulation.GetStep());
+		ReplayRecorder.End();
+	}
+
+	// Take the current units off the grid and the registry, keeping the actors for reuse
+	TMap<FUnitHandle, AGS_GameActorBase*> CurrentActors;
+	CurrentActors.Reserve(Simulation.GetUnits().Num());
+	Simulation.GetUnits().ForEachUnit([this, &CurrentActors](FUnitHandle Handle)
+	{
+		if (AGS_GameActorBase* Actor = GetUnitActor(Handle))
+		{
+			CurrentActors.Add(Handle, Actor);
+		}
+	});
+	Simulation.RemoveAllUnits();
+	for (TObjectPtr<AGS_GameActorBase>& UnitActor : UnitActors)
+	{
+		UnitActor = nullptr;
+	}
+
+	for (const FUnitSnapshot& Unit : Snapshot.Units)
+	{
+		const FGridPoint& GridPoint = Simulation.GetGrid().At(Unit.CellIndex);
+
+		AGS_GameActorBase* Actor = nullptr;
+		CurrentActors.RemoveAndCopyValue(Unit.Handle, Actor);
+		if (Actor != nullptr)
+		{
+			Actor->SetActorLocation(GridToGlobal(GridPoint.GridCoords));
+			Actor->Halt();
+		}
+		else
+		{
+			// The unit was killed after the step, its actor is gone
+			const TSubclassOf<AGS_GameActorBase> UnitClass = UnitClasses.IsValidIndex(Unit.Handle)
+				                                                 ? UnitClasses[Unit.Handle]
+				                                                 : nullptr;
+			if (UnitClass == nullptr)
+			{
+				UE_LOG(LogSim, Warning, TEXT("[RewindToStep] The class of unit %d is unknown."), Unit.Handle);
+				continue;
+			}
+			Actor = AcquireUnitActor(UnitClass, GridPoint.GridCoords);
+			if (Actor == nullptr)
 			{
-				break;
+				continue;
 			}
+			Actor->SetTeam(Unit.Team);
+			Actor->SetActionDuration(SimulationTimeStep_ms);
 		}
+
+		Actor->SetHealthPoints(Unit.Health);
+		Actor->SetGridPointIndex(GridPoint.Index);
+		Actor->SetGridCoordinates(GridPoint.GridCoords);
+
+		FUnitState UnitState;
+		UnitState.Team = Unit.Team;
+		UnitState.Cell = GridPoint.GridCoords;
+		UnitState.Health = Unit.Health;
+		UnitState.AttackPower = Unit.AttackPower;
+		UnitState.AttackRange = Unit.AttackRange;
+		if (!Simulation.RestoreUnit(Unit.Handle, UnitState))
+		{
+			ReleaseUnitActor(Actor);
+			continue;
+		}
+		SetUnitActor(Unit.Handle, Actor);
 	}
 
-	if (ClosestTarget != nullptr)
+	// Units that didn't exist at the step
+	for (const auto& HandleActorPair : CurrentActors)
 	{
-		OutDistanceSqr = ClosestDist;
+		ReleaseUnitActor(HandleActorPair.Value);
 	}
 
-	return ClosestTarget;
+	Simulation.SetStep(InStep);
+	Checkpoints.TruncateAfter(InStep);
+
+	UpdateDebugOverlay();
+
+	UE_LOG(LogSim, Display, TEXT("[RewindToStep] Rewound to step %d, %d units restored."), InStep,
+	       Simulation.GetUnits().Num());
+	return true;
 }
 
-void AGS_GameModeDefault::ActorAttack(AGS_GameActorBase* InTargetActor, AGS_GameActorBase* InActionActor)
+AGS_GameActorBase* AGS_GameModeDefault::AcquireUnitActor(TSubclassOf<AGS_GameActorBase> InClass,
+                                                        const FIntPoint& InCoordinates)
 {
-	UE_LOG(LogSim, Display, TEXT("[ActorAttack] Target: %s, Instigator %s."),
-	       *GetNameSafe(InTargetActor), *GetNameSafe(InActionActor));
+	auto* ActorPool = UWorld::GetSubsystem<UGS_ActorPoolSubsystem>(GetWorld());
+	if (ActorPool == nullptr)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[AcquireUnitActor] Actor pool is not available."));
+		return nullptr;
+	}
 
-	if (!InTargetActor || !InActionActor)
+	FTransform SpawnTransform;
+	SpawnTransform.SetLocation(GridToGlobal(InCoordinates));
+	AGS_GameActorBase* Actor = ActorPool->Acquire(InClass, SpawnTransform);
+	if (Actor != nullptr)
+	{
+		Actor->SetCrowdRendered(bUseInstancedCrowd);
+	}
+	return Actor;
+}
+
+void AGS_GameModeDefault::ReleaseUnitActor(AGS_GameActorBase* InActor)
+{
+	if (InActor == nullptr)
 	{
-		UE_LOG(LogSim, Warning, TEXT("[ActorAttack] One of the actors is nullptr."));
 		return;
 	}
-	InTargetActor->SetHealthPoints(InTargetActor->GetHealthPoints() - InActionActor->GetAttackPower());
-	InActionActor->PlayAttack(InTargetActor);
-	if (InTargetActor->GetHealthPoints() <= 0.f)
+
+	if (auto* ActorPool = UWorld::GetSubsystem<UGS_ActorPoolSubsystem>(GetWorld()))
+	{
+		ActorPool->Release(InActor);
+	}
+	else
 	{
-		HandleActorKilled(InTargetActor, InActionActor);
+		InActor->Destroy();
 	}
 }
 
-FIntPoint AGS_GameModeDefault::GetNextMoveLocation(AGS_GameActorBase* InActionActor, AGS_GameActorBase* InTargetActor,
-                                                   const FGrid& InGrid)
+FString AGS_GameModeDefault::GetReplayFilePath(const FString& InReplayName) const
 {
-	FIntPoint ResultPoint = FIntPoint::ZeroValue;
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Replays"), InReplayName + TEXT(".gsreplay"));
+}
 
-	if (InTargetActor != nullptr)
+void AGS_GameModeDefault::BeginReplayRecording()
+{
+	FReplayHeader Header;
+	Header.GridSizeX = GridSizeX;
+	Header.GridSizeY = GridSizeY;
+	Header.StepDuration = SimulationTimeStep_ms;
+
+	const FUnitRegistry& Units = Simulation.GetUnits();
+	TMap<UClass*, int32> ClassIndices;
+	Units.ForEachUnit([this, &Units, &Header, &ClassIndices](FUnitHandle Handle)
 	{
-		FGridPoint CurrentGridPoint = InGrid.At(InActionActor->GetGridCoordinates());
-		const TArray<FGridPoint> NeighborPoints = Grid.GetNodeConnections(CurrentGridPoint);
+		UClass* UnitClass = UnitClasses[Handle];
+		int32 ClassIndex = INDEX_NONE;
+		if (const int32* FoundIndex = ClassIndices.Find(UnitClass))
+		{
+			ClassIndex = *FoundIndex;
+		}
+		else
+		{
+			ClassIndex = Header.UnitClassPaths.Add(UnitClass->GetPathName());
+			ClassIndices.Add(UnitClass, ClassIndex);
+		}
+
+		FReplayUnit& Unit = Header.Units.AddDefaulted_GetRef();
+		Unit.Handle = Handle;
+		Unit.ClassIndex = ClassIndex;
+		Unit.Team = Units.GetTeam(Handle);
+		Unit.CellIndex = Simulation.GetGrid().At(Units.GetCell(Handle)).Index;
+		Unit.Health = Units.GetHealth(Handle);
+	});
 
-		int32 LeastDistance = FIntPoint(InTargetActor->GetGridCoordinates() - InActionActor->GetGridCoordinates()).
-			SizeSquared();
+	ReplayRecorder.Begin(GetReplayFilePath(ReplayName), Header);
+}
+
+bool AGS_GameModeDefault::StartReplayPlayback(const FString& InReplayName)
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[StartReplayPlayback] World is nullptr."))
+		return false;
+	}
+
+	if (!ReplayPlayer.Open(GetReplayFilePath(InReplayName)))
+	{
+		return false;
+	}
+
+	const FReplayHeader& Header = ReplayPlayer.GetHeader();
+	if (Header.GridSizeX != GridSizeX || Header.GridSizeY != GridSizeY)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[StartReplayPlayback] The replay is recorded on a %dx%d grid, the current one is %dx%d."),
+		       Header.GridSizeX, Header.GridSizeY, GridSizeX, GridSizeY);
+		return false;
+	}
+
+	// The simulated units are replaced by the recorded ones
+	bSimulationOngoing = false;
+	ShutdownSimulationThread();
+	ReplayRecorder.End();
+	for (TObjectPtr<AGS_GameActorBase>& UnitActor : UnitActors)
+	{
+		ReleaseUnitActor(UnitActor);
+		UnitActor = nullptr;
+	}
+	Simulation.RemoveAllUnits();
 
-		auto IsCloserThanBefore = [&LeastDistance](const FIntPoint& Left, const FIntPoint& Right)
+	for (const TWeakObjectPtr<AGS_GameActorBase>& ReplayActor : ReplayActors)
+	{
+		ReleaseUnitActor(ReplayActor.Get());
+	}
+	ReplayActors.Reset();
+
+	TArray<UClass*> UnitClassesToSpawn;
+	for (const FString& ClassPath : Header.UnitClassPaths)
+	{
+		UClass* UnitClass = TSoftClassPtr<AGS_GameActorBase>(FSoftObjectPath(ClassPath)).LoadSynchronous();
+		if (UnitClass == nullptr)
 		{
-			return FIntPoint(Left - Right).SizeSquared() < LeastDistance;
-		};
+			UE_LOG(LogSim, Warning, TEXT("[StartReplayPlayback] Failed to load %s, using the default class."), *ClassPath);
+			UnitClass = ActorClass;
+		}
+		UnitClassesToSpawn.Add(UnitClass);
+	}
 
-		for (const auto& Point : NeighborPoints)
+	for (const FReplayUnit& Unit : Header.Units)
+	{
+		if (!UnitClassesToSpawn.IsValidIndex(Unit.ClassIndex) || Unit.Handle < 0)
 		{
-			const auto PointCoordinates = Point.GridCoords;
-			if (Point.GameActor == nullptr && IsCloserThanBefore(PointCoordinates, InTargetActor->GetGridCoordinates()))
-			{
-				LeastDistance = FIntPoint(PointCoordinates - InTargetActor->GetGridCoordinates()).SizeSquared();
-				ResultPoint = PointCoordinates;
-			}
+			continue;
+		}
+
+		const FIntPoint Coordinates = Simulation.GetGrid().At(Unit.CellIndex).GridCoords;
+		AGS_GameActorBase* SpawnedActor = AcquireUnitActor(UnitClassesToSpawn[Unit.ClassIndex], Coordinates);
+		if (SpawnedActor == nullptr)
+		{
+			continue;
+		}
+		SpawnedActor->SetTeam(Unit.Team);
+		SpawnedActor->SetActionDuration(Header.StepDuration);
+		SpawnedActor->SetHealthPoints(Unit.Health);
+		SpawnedActor->SetUnitHandle(Unit.Handle);
+		SpawnedActor->SetGridCoordinates(Coordinates);
+
+		if (!ReplayActors.IsValidIndex(Unit.Handle))
+		{
+			ReplayActors.SetNum(Unit.Handle + 1);
 		}
+		ReplayActors[Unit.Handle] = SpawnedActor;
 	}
 
-	return ResultPoint;
+	bReplayPlaybackOngoing = true;
+	TimeStepAccumulator = 0.f;
+	UE_LOG(LogSim, Display, TEXT("[StartReplayPlayback] Playing %s back, %d units."), *InReplayName, Header.Units.Num());
+	return true;
 }
 
-void AGS_GameModeDefault::ActorMoveTowards(AGS_GameActorBase* InTargetActor, AGS_GameActorBase* InActionActor)
+void AGS_GameModeDefault::MakeReplayPlaybackStep()
 {
-	UE_LOG(LogSim, Display, TEXT("[ActorMove] Target: %s, ActionActor %s."),
-	       *GetNameSafe(InTargetActor), *GetNameSafe(InActionActor));
-
-	if (InTargetActor == nullptr || InActionActor == nullptr)
+	if (!ReplayPlayer.ReadNextStep(ReplayStepEvents))
 	{
-		UE_LOG(LogSim, Warning, TEXT("[ActorMove] Nullptr is passed as an argument."));
+		bReplayPlaybackOngoing = false;
+		UE_LOG(LogSim, Display, TEXT("[MakeReplayPlaybackStep] Replay is over."))
 		return;
 	}
 
-	FIntPoint NextMove = GetNextMoveLocation(InActionActor, InTargetActor, Grid);
-	// Alternatively, use pathfinding, if the grid will have obstacles:
-	//auto DummyPath = GS_Pathfinder->FindPath(Path::FNode(InActionActor->GetGridCoordinates()),
-	//                                      Path::FNode(InTargetActor->GetGridCoordinates()));
-	//if(DummyPath.Num() > 0)
-	//{
-	//	NextMove = (*DummyPath.begin()).XY;
-	//}
+	// The replays don't record the damage, the health of the replay actors only drops at their deaths
+	ApplyStepEvents(ReplayStepEvents, {}, [this](FUnitHandle InHandle) -> AGS_GameActorBase*
+	{
+		return ReplayActors.IsValidIndex(InHandle) ? ReplayActors[InHandle].Get() : nullptr;
+	}, [](FUnitHandle) { return 0.f; }, ReplayPlayer.GetHeader().StepDuration);
 
+	for (const FSimDeathEvent& Death : ReplayStepEvents.Deaths)
+	{
+		if (ReplayActors.IsValidIndex(Death.Unit))
+		{
+			ReplayActors[Death.Unit] = nullptr;
+		}
+	}
+}
 
-	if (NextMove == FIntPoint::ZeroValue)
+void AGS_GameModeDefault::UpdateCrowdRenderer()
+{
+	if (CrowdRenderer == nullptr)
 	{
-		UE_LOG(LogSim, Warning, TEXT("[ActorMove] Failed to find a point closer"));
 		return;
 	}
 
-	// Clear current point on grid, then assign new coordinates to the actor and assign the actor to the new grid point
-	Grid.At(InActionActor->GetGridCoordinates()).GameActor = nullptr;
-	InActionActor->SetGridCoordinates(NextMove);
-	Grid.At(NextMove).GameActor = InActionActor;
+	CrowdRenderer->BeginUpdate();
+	if (bReplayPlaybackOngoing)
+	{
+		for (const TWeakObjectPtr<AGS_GameActorBase>& ReplayActor : ReplayActors)
+		{
+			CrowdRenderer->AddInstance(ReplayActor.Get());
+		}
+	}
+	else
+	{
+		for (const TObjectPtr<AGS_GameActorBase>& UnitActor : UnitActors)
+		{
+			CrowdRenderer->AddInstance(UnitActor);
+		}
+	}
+	CrowdRenderer->EndUpdate();
+}
 
+void AGS_GameModeDefault::UpdateDebugOverlayLayers()
+{
+	const int32 LayerMask = CVarDebugOverlay.GetValueOnGameThread();
+	if (LayerMask == DebugOverlayLayerMask)
+	{
+		return;
+	}
 
-	// TODO: fix the lerp first. Then delete the SetActorLocation call.
-	InActionActor->MoveActorInterp(GridToGlobal(NextMove), SimulationTimeStep_ms);
-	//InActionActor->SetActorLocation(GridToGlobal(NextMove));
+	DebugOverlayLayerMask = LayerMask;
+	DebugOverlay->SetEnabledLayers(LayerMask);
+	UpdateDebugOverlay();
 }
 
-void AGS_GameModeDefault::HandleActorKilled(AGS_GameActorBase* InTargetActor, AGS_GameActorBase* InInstigatorActor)
+void AGS_GameModeDefault::UpdateDebugOverlay()
 {
-	UE_LOG(LogSim, Warning, TEXT("[AHandleActorKilled] %s is killed by %s."),
-	       *GetNameSafe(InTargetActor), *GetNameSafe(InInstigatorActor));
+	if (!DebugOverlay->IsEnabled())
+	{
+		return;
+	}
+
+	if (DebugOverlay->IsLayerEnabled(EGridDebugLayer::Occupancy))
+	{
+		DebugOverlay->ClearLayer(EGridDebugLayer::Occupancy);
+		if (SimulationThread.IsLaunched())
+		{
+			// The units and the grid are owned by the simulation thread, the applied frame is drawn
+			for (const FSimFrameUnit& Unit : AppliedFrame.Units)
+			{
+				if (Unit.IsAlive())
+				{
+					DebugOverlay->AddOccupiedCell(GetGridPoint(Unit.CellIndex).GridCoords,
+					                              Unit.Team == ETeam::BlueTeam ? FColor::Blue : FColor::Red);
+				}
+			}
+		}
+		else
+		{
+			const FUnitRegistry& Units = Simulation.GetUnits();
+			Units.ForEachUnit([this, &Units](FUnitHandle Handle)
+			{
+				DebugOverlay->AddOccupiedCell(Units.GetCell(Handle),
+				                              Units.GetTeam(Handle) == ETeam::BlueTeam ? FColor::Blue : FColor::Red);
+			});
+		}
+	}
+
+	// The paths are found anew every step, so the layer is rebuilt. The squads are owned by the simulation thread too.
+	if (DebugOverlay->IsLayerEnabled(EGridDebugLayer::Paths))
+	{
+		DebugOverlay->ClearLayer(EGridDebugLayer::Paths);
+		if (!SimulationThread.IsLaunched())
+		{
+			Simulation.VisualizeSquadPaths(DebugOverlay);
+		}
+	}
+
+	// The influence of all the teams together. The maps are owned by the simulation thread, while it's launched.
+	if (DebugOverlay->IsLayerEnabled(EGridDebugLayer::Field) && !SimulationThread.IsLaunched())
+	{
+		const FInfluenceMap& Influence = Simulation.GetInfluence();
+		const TArray<FGridPoint>& GridPoints = Simulation.GetGrid().GetGrid();
+		DebugFieldValues.SetNumUninitialized(GridPoints.Num());
 
-	InTargetActor->HandleZeroHealth();
-	Grid.At(InTargetActor->GetGridCoordinates()).GameActor = nullptr;
-	KilledGameActors.Add(InTargetActor);
-	--ActorsNumPerTeam.FindOrAdd(InTargetActor->GetTeam());
+		float MaxValue = 0.f;
+		for (int32 Index = 0; Index < GridPoints.Num(); ++Index)
+		{
+			DebugFieldValues[Index] = Influence.GetThreat(ETeam::NoTeam, GridPoints[Index].GridCoords);
+			MaxValue = FMath::Max(MaxValue, DebugFieldValues[Index]);
+		}
+		DebugOverlay->SetScalarField(DebugFieldValues, 0.f, MaxValue);
+	}
+
+	DebugOverlay->FlushLayers();
 }
 
 FVector AGS_GameModeDefault::GridToGlobal(const FIntPoint& InCoordinates) const
 {
 	return FVector{InCoordinates.X * GridCellSize, InCoordinates.Y * GridCellSize, 0.f};
 }
+
+const FGridPoint& AGS_GameModeDefault::GetGridPoint(int32 InCellIndex) const
+{
+	return SimulationThread.IsLaunched() ? AppliedFrame.Grid->At(InCellIndex) : Simulation.GetGrid().At(InCellIndex);
+}
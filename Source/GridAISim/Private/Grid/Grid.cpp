@@ -3,8 +3,8 @@
 
 #include "Grid/Grid.h"
 
-#include "Actors/GameActorBase.h"
 #include "GridAISim/GridAISim.h"
+#include "Simulation/SimStats.h"
 
 /*
  * We may use the rules of the Grid formation, like: Rect, Hex, Oct. Which will define the directions in which to check if there is a node
@@ -43,26 +43,31 @@ void FGrid::PrintGrid() const
 {
 	for (auto& Point : GridArray)
 	{
-		UE_LOG(LogSim, Display, TEXT("%s"), *Point.GetDebugString());
+		GRIDSIM_LOG(Display, TEXT("%s"), *Point.GetDebugString());
 	}
 }
 
 FString FGridPoint::GetDebugString() const
 {
-	const FString DebugString(TEXT("Index:{0}, X:{1}, Y:{2}, Actor:{3}"));
+	const FString DebugString(TEXT("Index:{0}, X:{1}, Y:{2}, Unit:{3}, Obstacle:{4}"));
 	return FString::Format(*DebugString, {
 		                       *FString::FromInt(Index),
 		                       *FString::FromInt(GridCoords.X),
 		                       *FString::FromInt(GridCoords.Y),
-		                       *GetNameSafe(GameActor)
+		                       *FString::FromInt(Unit),
+		                       bIsObstacle ? TEXT("true") : TEXT("false")
 	                       });
 }
 
 void FGrid::Init(int32 InSizeX, int32 InSizeY, EGridType InGridType)
 {
+	LLM_SCOPE_BYTAG(GridSim_Grid);
+
 	SizeX = InSizeX;
 	SizeY = InSizeY;
 	GridType = InGridType;
+	const TArray<FIntPoint>* Modifiers = GridModifiersMapping.Find(GridType);
+	NeighborOffsets = Modifiers ? TConstArrayView<FIntPoint>(*Modifiers) : TConstArrayView<FIntPoint>();
 	//GridArray.Init(FGridPoint, SizeX * SizeY);
 	GridArray.SetNumZeroed(SizeX * SizeY);
 
@@ -70,11 +75,22 @@ void FGrid::Init(int32 InSizeX, int32 InSizeY, EGridType InGridType)
 	{
 		for (int Cols = 0; Cols < SizeX; ++Cols)
 		{
-			FGridPoint& GridPoint = GridArray[Cols + (Rows * SizeY)];
+			FGridPoint& GridPoint = GridArray[Cols + (Rows * SizeX)];
 			GridPoint.GridCoords = FIntPoint{Cols, Rows};
-			GridPoint.Index = Cols + (Rows * SizeY);
+			GridPoint.Index = Cols + (Rows * SizeX);
 		}
 	}
+
+	UpdateClearance(FIntPoint::ZeroValue, FIntPoint(SizeX - 1, SizeY - 1));
+	++ObstacleVersion;
+
+	// Nothing derived from the previous layout is valid anymore, so the journal starts over
+	NumTilesX = FMath::DivideAndRoundUp(SizeX, ChangeTileSize);
+	DirtyTiles.Init(false, NumTilesX * FMath::DivideAndRoundUp(SizeY, ChangeTileSize));
+	Journal.Reset();
+	JournalEpoch = ++Epoch;
+	bComponentsDirty = true;
+	UpdateComponents();
 }
 
 const TArray<FGridPoint>& FGrid::GetGrid() const
@@ -82,17 +98,16 @@ const TArray<FGridPoint>& FGrid::GetGrid() const
 	return GridArray;
 }
 
-FGridPoint& FGrid::At(int32 Index)
+const FGridPoint& FGrid::At(int32 Index) const
 {
 	checkf(Index < GridArray.Num(), TEXT("[FGrid::At] Argument Index out of bounds."));
 	return GridArray[Index];
 }
 
-FGridPoint& FGrid::At(FIntPoint Coordinates)
+FGridPoint& FGrid::GetMutablePoint(const FIntPoint& Coordinates)
 {
-	//const int32 Index = Coordinates.X * Coordinates.Y;
-	const int32 Index = Coordinates.X + (Coordinates.Y * SizeY);
-	checkf(Index < GridArray.Num(), TEXT("[FGrid::At] Coordinates out of bounds."));
+	const int32 Index = Coordinates.X + (Coordinates.Y * SizeX);
+	checkf(Index < GridArray.Num(), TEXT("[FGrid::GetMutablePoint] Coordinates out of bounds."));
 
 	return GridArray[Index];
 }
@@ -100,7 +115,7 @@ FGridPoint& FGrid::At(FIntPoint Coordinates)
 const FGridPoint& FGrid::At(FIntPoint Coordinates) const
 {
 	//const int32 Index = Coordinates.X * Coordinates.Y;
-	const int32 Index = Coordinates.X + (Coordinates.Y * SizeY);
+	const int32 Index = Coordinates.X + (Coordinates.Y * SizeX);
 	checkf(Index < GridArray.Num(), TEXT("[FGrid::At] Coordinates out of bounds."));
 
 	return GridArray[Index];
@@ -117,7 +132,7 @@ bool FGrid::FindRandomEmptyPointOnGrid(FGridPoint& OutGridPoint) const
 	const auto RandomIndex = FMath::RandRange(0, EmptyPoints.Num() - 1);
 	OutGridPoint = EmptyPoints[RandomIndex];
 
-	if(GridArray[OutGridPoint.Index].GameActor != nullptr)
+	if(!GridArray[OutGridPoint.Index].IsFree())
 	{
 		UE_LOG(LogSim, Display, TEXT("[FindRandomEmptyPointOnGrid] Cell is occupied."));
 	}
@@ -128,13 +143,13 @@ bool FGrid::FindRandomEmptyPointOnGrid(FGridPoint& OutGridPoint) const
 	const FGridPoint RandomPoint = FindRandomPointOnGrid(RandomIndex);
 
 	// If the GridPoint is not empty
-	if (RandomPoint.GameActor != nullptr)
+	if (!RandomPoint.IsFree())
 	{
 		// Go heavy, copy all empty slots into temp grid copy and get random there.
 		TArray<FGridPoint> TempGrid = GridArray;
 		for (auto& Point : GridArray)
 		{
-			if (Point.GameActor == nullptr)
+			if (Point.IsFree())
 			{
 				TempGrid.Add(Point);
 			}
@@ -173,24 +188,201 @@ EGridType FGrid::GetGridType() const
 	return EGridType::Rectangular;
 }
 
-TArray<FGridPoint> FGrid::GetNodeConnections(const FGridPoint& Point) const
+FIntPoint FGrid::GetSize() const
 {
-	TArray<FGridPoint> ResultPoints;
+	return FIntPoint{SizeX, SizeY};
+}
+
+void FGrid::SetObstacle(const FIntPoint& Point, bool bIsObstacle)
+{
+	if (!IsPointOnGrid(Point) || At(Point).bIsObstacle == bIsObstacle)
+	{
+		return;
+	}
+
+	GetMutablePoint(Point).bIsObstacle = bIsObstacle;
+	++ObstacleVersion;
+	RecordChange(Point, FGridChange::EType::Obstacle);
+	bComponentsDirty = true;
+
+	// Only the squares that may cover the point change
+	UpdateClearance(Point - FIntPoint(MaxClearance - 1), Point);
+}
+
+int32 FGrid::GetClearance(const FIntPoint& Point) const
+{
+	return IsPointOnGrid(Point) ? At(Point).Clearance : 0;
+}
+
+bool FGrid::CanFit(const FIntPoint& Point, int32 FootprintSize) const
+{
+	checkf(FootprintSize <= MaxClearance, TEXT("[FGrid::CanFit] Footprint %d is larger than the tracked clearance."),
+	       FootprintSize);
+	return GetClearance(Point) >= FootprintSize;
+}
+
+void FGrid::UpdateComponents()
+{
+	if (!bComponentsDirty)
+	{
+		return;
+	}
+
+	LLM_SCOPE_BYTAG(GridSim_Grid);
+
+	for (FGridPoint& Point : GridArray)
+	{
+		Point.Component = INDEX_NONE;
+	}
+
+	// Flood every area from its first unlabeled point, the queue holds the point indices
+	int32 NumComponents = 0;
+	for (FGridPoint& Seed : GridArray)
+	{
+		if (Seed.bIsObstacle || Seed.Component != INDEX_NONE)
+		{
+			continue;
+		}
+
+		const int32 Component = NumComponents++;
+		Seed.Component = Component;
+		ComponentQueue.Reset();
+		ComponentQueue.Add(Seed.Index);
+		for (int32 QueueIndex = 0; QueueIndex < ComponentQueue.Num(); ++QueueIndex)
+		{
+			const FIntPoint& Current = GridArray[ComponentQueue[QueueIndex]].GridCoords;
+			ForEachNeighbor(Current, [this, Component](const FGridPoint& Neighbor)
+			{
+				FGridPoint& Point = GridArray[Neighbor.Index];
+				if (!Point.bIsObstacle && Point.Component == INDEX_NONE)
+				{
+					Point.Component = Component;
+					ComponentQueue.Add(Point.Index);
+				}
+			});
+		}
+	}
+
+	bComponentsDirty = false;
+	GRIDSIM_LOG(Verbose, TEXT("[FGrid::UpdateComponents] The grid has %d connected areas."), NumComponents);
+}
+
+bool FGrid::AreConnected(const FIntPoint& PointA, const FIntPoint& PointB) const
+{
+	if (!IsPointOnGrid(PointA) || !IsPointOnGrid(PointB))
+	{
+		return false;
+	}
+	if (bComponentsDirty)
+	{
+		return true;
+	}
+
+	const int32 Component = At(PointA).Component;
+	return Component != INDEX_NONE && Component == At(PointB).Component;
+}
+
+bool FGrid::AreComponentsUpToDate() const
+{
+	return !bComponentsDirty;
+}
+
+void FGrid::SetUnit(const FIntPoint& Point, FUnitHandle Unit)
+{
+	FGridPoint& GridPoint = GetMutablePoint(Point);
+	if (GridPoint.Unit != Unit)
+	{
+		GridPoint.Unit = Unit;
+		RecordChange(Point, FGridChange::EType::Occupancy);
+	}
+}
+
+uint32 FGrid::GetEpoch() const
+{
+	return Epoch;
+}
+
+bool FGrid::GetChangesSince(uint32 InEpoch, TConstArrayView<FGridChange>& OutChanges) const
+{
+	if (InEpoch < JournalEpoch || InEpoch > Epoch)
+	{
+		OutChanges = TConstArrayView<FGridChange>();
+		return false;
+	}
+
+	OutChanges = TConstArrayView<FGridChange>(Journal).RightChop(StaticCast<int32>(InEpoch - JournalEpoch));
+	return true;
+}
+
+TConstArrayView<FGridChange> FGrid::GetChanges() const
+{
+	return Journal;
+}
+
+const TBitArray<>& FGrid::GetDirtyTiles() const
+{
+	return DirtyTiles;
+}
+
+void FGrid::ResetChanges()
+{
+	Journal.Reset();
+	JournalEpoch = Epoch;
+	DirtyTiles.SetRange(0, DirtyTiles.Num(), false);
+}
+
+void FGrid::RecordChange(const FIntPoint& Point, FGridChange::EType Type)
+{
+	LLM_SCOPE_BYTAG(GridSim_Grid);
 
-	if (GridModifiersMapping.Contains(GridType))
+	++Epoch;
+	Journal.Add({Point, Type});
+	DirtyTiles[Point.Y / ChangeTileSize * NumTilesX + Point.X / ChangeTileSize] = true;
+}
+
+uint32 FGrid::GetObstacleVersion() const
+{
+	return ObstacleVersion;
+}
+
+void FGrid::UpdateClearance(const FIntPoint& Min, const FIntPoint& Max)
+{
+	const int32 MinX = FMath::Max(Min.X, 0);
+	const int32 MinY = FMath::Max(Min.Y, 0);
+	for (int32 Y = FMath::Min(Max.Y, SizeY - 1); Y >= MinY; --Y)
 	{
-		for (auto& Modifier : GridModifiersMapping[GridType])
+		for (int32 X = FMath::Min(Max.X, SizeX - 1); X >= MinX; --X)
 		{
-			FIntPoint TargetPoint = Point.GridCoords + Modifier;
-			if (IsPointOnGrid(TargetPoint))
+			FGridPoint& Point = GetMutablePoint(FIntPoint(X, Y));
+			if (Point.bIsObstacle)
 			{
-				ResultPoints.Emplace(FGridPoint(At(TargetPoint)));
+				Point.Clearance = 0;
+				continue;
 			}
+
+			// A square fits, if the three squares one step smaller next to it fit
+			const int32 Clearance = 1 + FMath::Min3(GetClearance({X + 1, Y}), GetClearance({X, Y + 1}),
+			                                        GetClearance({X + 1, Y + 1}));
+			Point.Clearance = StaticCast<uint8>(FMath::Min(Clearance, MaxClearance));
 		}
 	}
+}
+
+TArray<FGridPoint> FGrid::GetNodeConnections(const FGridPoint& Point) const
+{
+	TArray<FGridPoint> ResultPoints;
+	ForEachNeighbor(Point.GridCoords, [&ResultPoints](const FGridPoint& Neighbor)
+	{
+		ResultPoints.Add(Neighbor);
+	});
 	return ResultPoints;
 }
 
+TConstArrayView<FIntPoint> FGrid::GetNeighborOffsets() const
+{
+	return NeighborOffsets;
+}
+
 bool FGrid::IsPointOnGrid(const FIntPoint& Point) const
 {
 	return (Point.X >= 0 && Point.X < SizeX)
@@ -199,7 +391,16 @@ bool FGrid::IsPointOnGrid(const FIntPoint& Point) const
 
 void FGrid::OnStartSpawningActors()
 {
-	EmptyPoints = GridArray;
+	LLM_SCOPE_BYTAG(GridSim_Grid);
+
+	EmptyPoints.Reset(GridArray.Num());
+	for (const FGridPoint& Point : GridArray)
+	{
+		if (Point.IsFree())
+		{
+			EmptyPoints.Add(Point);
+		}
+	}
 }
 
 void FGrid::OnFinishSpawningActors()
@@ -0,0 +1,219 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Grid/GridDebugOverlayComponent.h"
+
+#include "GridAISim/GridAISim.h"
+
+// The height of the overlay above the ground, so it isn't hidden by the floor
+static constexpr float OverlayHeight = 5.f;
+static constexpr float LineThickness = 2.f;
+
+UGS_GridDebugOverlayComponent::UGS_GridDebugOverlayComponent()
+{
+	// The overlay is updated by the owner, when the drawn data changes
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UGS_GridDebugOverlayComponent::SetGrid(int32 InSizeX, int32 InSizeY, float InCellSize)
+{
+	SizeX = InSizeX;
+	SizeY = InSizeY;
+	CellSize = InCellSize;
+
+	if (IsLayerEnabled(EGridDebugLayer::Grid))
+	{
+		RebuildGridLayer();
+	}
+}
+
+void UGS_GridDebugOverlayComponent::SetEnabledLayers(uint32 InLayerMask)
+{
+	for (int32 LayerIndex = 0; LayerIndex < StaticCast<int32>(UE_ARRAY_COUNT(Layers)); ++LayerIndex)
+	{
+		FDebugLayer& Layer = Layers[LayerIndex];
+		const bool bShouldBeEnabled = (InLayerMask & (1u << LayerIndex)) != 0;
+		if (Layer.bIsEnabled == bShouldBeEnabled)
+		{
+			continue;
+		}
+
+		Layer.bIsEnabled = bShouldBeEnabled;
+		Layer.Lines.Empty();
+		bIsDirty = true;
+	}
+
+	// The grid layer doesn't depend on the simulation, so it's built right away
+	if (IsLayerEnabled(EGridDebugLayer::Grid) && Layers[StaticCast<int32>(EGridDebugLayer::Grid)].Lines.Num() == 0)
+	{
+		RebuildGridLayer();
+	}
+
+	if (IsEnabled() && LineBatch == nullptr)
+	{
+		// Unnamed, the component of the previous enabling may still be pending the destruction
+		LineBatch = NewObject<ULineBatchComponent>(GetOwner(), NAME_None);
+		LineBatch->RegisterComponent();
+		// The lines are persistent, there is nothing to expire
+		LineBatch->SetComponentTickEnabled(false);
+	}
+	else if (!IsEnabled() && LineBatch != nullptr)
+	{
+		LineBatch->DestroyComponent();
+		LineBatch = nullptr;
+	}
+}
+
+bool UGS_GridDebugOverlayComponent::IsLayerEnabled(EGridDebugLayer InLayer) const
+{
+	return Layers[StaticCast<int32>(InLayer)].bIsEnabled;
+}
+
+bool UGS_GridDebugOverlayComponent::IsEnabled() const
+{
+	for (const FDebugLayer& Layer : Layers)
+	{
+		if (Layer.bIsEnabled)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void UGS_GridDebugOverlayComponent::ClearLayer(EGridDebugLayer InLayer)
+{
+	FDebugLayer& Layer = Layers[StaticCast<int32>(InLayer)];
+	if (Layer.Lines.Num() > 0)
+	{
+		Layer.Lines.Reset();
+		bIsDirty = true;
+	}
+}
+
+void UGS_GridDebugOverlayComponent::AddOccupiedCell(const FIntPoint& InCoordinates, const FColor& InColor)
+{
+	FDebugLayer& Layer = Layers[StaticCast<int32>(EGridDebugLayer::Occupancy)];
+	if (!Layer.bIsEnabled)
+	{
+		return;
+	}
+
+	const FVector Center = CellToWorld(InCoordinates);
+	const float Extent = CellSize * 0.3f;
+	Layer.Lines.Emplace(Center + FVector(-Extent, -Extent, 0.f), Center + FVector(Extent, Extent, 0.f),
+	                    InColor, 0.f, LineThickness, SDPG_World);
+	Layer.Lines.Emplace(Center + FVector(-Extent, Extent, 0.f), Center + FVector(Extent, -Extent, 0.f),
+	                    InColor, 0.f, LineThickness, SDPG_World);
+	bIsDirty = true;
+}
+
+void UGS_GridDebugOverlayComponent::AddPath(TArrayView<const FIntPoint> InPath, const FColor& InColor)
+{
+	FDebugLayer& Layer = Layers[StaticCast<int32>(EGridDebugLayer::Paths)];
+	if (!Layer.bIsEnabled || InPath.Num() < 2)
+	{
+		return;
+	}
+
+	// Slightly above the rest, so the paths stay visible over the occupancy marks
+	const FVector PathOffset(0.f, 0.f, OverlayHeight);
+	for (int32 Index = 1; Index < InPath.Num(); ++Index)
+	{
+		Layer.Lines.Emplace(CellToWorld(InPath[Index - 1]) + PathOffset, CellToWorld(InPath[Index]) + PathOffset,
+		                    InColor, 0.f, LineThickness * 2.f, SDPG_World);
+	}
+	bIsDirty = true;
+}
+
+void UGS_GridDebugOverlayComponent::SetScalarField(TArrayView<const float> InValues, float InMinValue,
+                                                   float InMaxValue)
+{
+	FDebugLayer& Layer = Layers[StaticCast<int32>(EGridDebugLayer::Field)];
+	if (!Layer.bIsEnabled || SizeY <= 0)
+	{
+		return;
+	}
+
+	Layer.Lines.Reset();
+	bIsDirty = true;
+
+	const float Range = FMath::Max(InMaxValue - InMinValue, SMALL_NUMBER);
+	for (int32 Index = 0; Index < InValues.Num(); ++Index)
+	{
+		if (InValues[Index] <= InMinValue)
+		{
+			continue;
+		}
+
+		const float Alpha = FMath::Clamp((InValues[Index] - InMinValue) / Range, 0.f, 1.f);
+		const FVector Base = CellToWorld(IndexToCell(Index));
+		Layer.Lines.Emplace(Base, Base + FVector(0.f, 0.f, Alpha * CellSize),
+		                    FLinearColor::LerpUsingHSV(FLinearColor::Blue, FLinearColor::Red, Alpha),
+		                    0.f, LineThickness, SDPG_World);
+	}
+}
+
+void UGS_GridDebugOverlayComponent::FlushLayers()
+{
+	if (!bIsDirty || LineBatch == nullptr)
+	{
+		return;
+	}
+
+	LineBatch->Flush();
+	for (FDebugLayer& Layer : Layers)
+	{
+		if (Layer.bIsEnabled && Layer.Lines.Num() > 0)
+		{
+			LineBatch->DrawLines(Layer.Lines);
+		}
+	}
+	bIsDirty = false;
+}
+
+void UGS_GridDebugOverlayComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	SetEnabledLayers(0);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UGS_GridDebugOverlayComponent::RebuildGridLayer()
+{
+	FDebugLayer& Layer = Layers[StaticCast<int32>(EGridDebugLayer::Grid)];
+	Layer.Lines.Reset();
+	bIsDirty = true;
+
+	if (SizeX <= 0 || SizeY <= 0)
+	{
+		return;
+	}
+
+	// The cells are centered at their coordinates, so the lines go between them
+	const FVector Origin = CellToWorld(FIntPoint::ZeroValue) - FVector(CellSize * 0.5f, CellSize * 0.5f, 0.f);
+	const float Width = SizeX * CellSize;
+	const float Height = SizeY * CellSize;
+	Layer.Lines.Reserve(SizeX + SizeY + 2);
+	for (int32 X = 0; X <= SizeX; ++X)
+	{
+		const FVector Start = Origin + FVector(X * CellSize, 0.f, 0.f);
+		Layer.Lines.Emplace(Start, Start + FVector(0.f, Height, 0.f), FLinearColor::Gray, 0.f, 1.f, SDPG_World);
+	}
+	for (int32 Y = 0; Y <= SizeY; ++Y)
+	{
+		const FVector Start = Origin + FVector(0.f, Y * CellSize, 0.f);
+		Layer.Lines.Emplace(Start, Start + FVector(Width, 0.f, 0.f), FLinearColor::Gray, 0.f, 1.f, SDPG_World);
+	}
+}
+
+FVector UGS_GridDebugOverlayComponent::CellToWorld(const FIntPoint& InCoordinates) const
+{
+	return FVector{InCoordinates.X * CellSize, InCoordinates.Y * CellSize, OverlayHeight};
+}
+
+FIntPoint UGS_GridDebugOverlayComponent::IndexToCell(int32 InIndex) const
+{
+	// The same row-major layout as FGrid::Init uses
+	return FIntPoint{InIndex % SizeX, InIndex / SizeX};
+}
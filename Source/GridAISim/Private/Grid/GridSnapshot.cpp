@@ -0,0 +1,162 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Grid/GridSnapshot.h"
+
+#include "Simulation/SimStats.h"
+
+FGridSnapshotRef FGridSnapshot::Create(const FGrid& InGrid, const FGridSnapshot* InPrevious)
+{
+	GRIDSIM_SCOPE(GridSnapshot);
+	LLM_SCOPE_BYTAG(GridSim_Grid);
+
+	// The constructor is private, so the snapshots are only made here
+	TSharedRef<FGridSnapshot, ESPMode::ThreadSafe> Snapshot = MakeShareable(new FGridSnapshot());
+	const FIntPoint Size = InGrid.GetSize();
+	Snapshot->SizeX = Size.X;
+	Snapshot->SizeY = Size.Y;
+	Snapshot->NumTilesX = FMath::DivideAndRoundUp(Size.X, FGrid::ChangeTileSize);
+	Snapshot->GridType = InGrid.GetGridType();
+	Snapshot->NeighborOffsets = InGrid.GetNeighborOffsets();
+	Snapshot->Epoch = InGrid.GetEpoch();
+	Snapshot->ObstacleVersion = InGrid.GetObstacleVersion();
+	Snapshot->bComponentsUpToDate = InGrid.AreComponentsUpToDate();
+
+	TBitArray<> ChangedTiles;
+	const bool bShareTiles = InPrevious != nullptr && CollectChangedTiles(InGrid, *InPrevious, ChangedTiles);
+
+	const int32 NumTilesY = FMath::DivideAndRoundUp(Size.Y, FGrid::ChangeTileSize);
+	Snapshot->Tiles.Reserve(Snapshot->NumTilesX * NumTilesY);
+	for (int32 TileY = 0; TileY < NumTilesY; ++TileY)
+	{
+		for (int32 TileX = 0; TileX < Snapshot->NumTilesX; ++TileX)
+		{
+			const int32 TileIndex = Snapshot->Tiles.Num();
+			if (bShareTiles && !ChangedTiles[TileIndex])
+			{
+				Snapshot->Tiles.Add(InPrevious->Tiles[TileIndex]);
+			}
+			else
+			{
+				Snapshot->Tiles.Add(CopyTile(InGrid, TileX, TileY));
+			}
+		}
+	}
+	return Snapshot;
+}
+
+uint32 FGridSnapshot::GetEpoch() const
+{
+	return Epoch;
+}
+
+FIntPoint FGridSnapshot::GetSize() const
+{
+	return FIntPoint(SizeX, SizeY);
+}
+
+EGridType FGridSnapshot::GetGridType() const
+{
+	return GridType;
+}
+
+bool FGridSnapshot::IsPointOnGrid(const FIntPoint& Point) const
+{
+	return Point.X >= 0 && Point.X < SizeX && Point.Y >= 0 && Point.Y < SizeY;
+}
+
+const FGridPoint& FGridSnapshot::At(const FIntPoint& Point) const
+{
+	checkf(IsPointOnGrid(Point), TEXT("[FGridSnapshot::At] Coordinates out of bounds."));
+
+	constexpr int32 TileSize = FGrid::ChangeTileSize;
+	const FTile& Tile = *Tiles[Point.Y / TileSize * NumTilesX + Point.X / TileSize];
+	return Tile[Point.Y % TileSize * TileSize + Point.X % TileSize];
+}
+
+const FGridPoint& FGridSnapshot::At(int32 Index) const
+{
+	checkf(Index >= 0 && Index < SizeX * SizeY, TEXT("[FGridSnapshot::At] Argument Index out of bounds."));
+
+	// The same row-major layout as FGrid uses
+	return At(FIntPoint(Index % SizeX, Index / SizeX));
+}
+
+bool FGridSnapshot::AreConnected(const FIntPoint& PointA, const FIntPoint& PointB) const
+{
+	if (!IsPointOnGrid(PointA) || !IsPointOnGrid(PointB))
+	{
+		return false;
+	}
+	if (!bComponentsUpToDate)
+	{
+		return true;
+	}
+
+	const int32 Component = At(PointA).Component;
+	return Component != INDEX_NONE && Component == At(PointB).Component;
+}
+
+int32 FGridSnapshot::NumSharedTiles(const FGridSnapshot& InOther) const
+{
+	if (InOther.Tiles.Num() != Tiles.Num())
+	{
+		return 0;
+	}
+
+	int32 NumShared = 0;
+	for (int32 TileIndex = 0; TileIndex < Tiles.Num(); ++TileIndex)
+	{
+		NumShared += &Tiles[TileIndex].Get() == &InOther.Tiles[TileIndex].Get() ? 1 : 0;
+	}
+	return NumShared;
+}
+
+bool FGridSnapshot::CollectChangedTiles(const FGrid& InGrid, const FGridSnapshot& InPrevious,
+                                        TBitArray<>& OutChangedTiles)
+{
+	// The obstacles and the connectivity change the points far from the changed one
+	if (InPrevious.GetSize() != InGrid.GetSize() || InPrevious.GridType != InGrid.GetGridType()
+		|| InPrevious.ObstacleVersion != InGrid.GetObstacleVersion()
+		|| InPrevious.bComponentsUpToDate != InGrid.AreComponentsUpToDate())
+	{
+		return false;
+	}
+
+	TConstArrayView<FGridChange> Changes;
+	if (!InGrid.GetChangesSince(InPrevious.Epoch, Changes))
+	{
+		return false;
+	}
+
+	constexpr int32 TileSize = FGrid::ChangeTileSize;
+	OutChangedTiles.Init(false, InPrevious.Tiles.Num());
+	for (const FGridChange& Change : Changes)
+	{
+		if (Change.Type != FGridChange::EType::Occupancy)
+		{
+			return false;
+		}
+		OutChangedTiles[Change.Point.Y / TileSize * InPrevious.NumTilesX + Change.Point.X / TileSize] = true;
+	}
+	return true;
+}
+
+FGridSnapshot::FTileRef FGridSnapshot::CopyTile(const FGrid& InGrid, int32 InTileX, int32 InTileY)
+{
+	constexpr int32 TileSize = FGrid::ChangeTileSize;
+	const FIntPoint Size = InGrid.GetSize();
+	const FIntPoint Min(InTileX * TileSize, InTileY * TileSize);
+	const FIntPoint Max(FMath::Min(Min.X + TileSize, Size.X), FMath::Min(Min.Y + TileSize, Size.Y));
+
+	TSharedRef<FTile, ESPMode::ThreadSafe> Tile = MakeShared<FTile, ESPMode::ThreadSafe>();
+	Tile->SetNum(TileSize * TileSize);
+	for (int32 Y = Min.Y; Y < Max.Y; ++Y)
+	{
+		for (int32 X = Min.X; X < Max.X; ++X)
+		{
+			(*Tile)[(Y - Min.Y) * TileSize + X - Min.X] = InGrid.At(FIntPoint(X, Y));
+		}
+	}
+	return Tile;
+}
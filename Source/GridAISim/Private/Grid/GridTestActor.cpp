@@ -6,8 +6,8 @@
 // Sets default values
 AGS_GridTestActor::AGS_GridTestActor()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// Nothing to do per frame, the grid debug view is drawn by UGS_GridDebugOverlayComponent
+	PrimaryActorTick.bCanEverTick = false;
 
 }
 
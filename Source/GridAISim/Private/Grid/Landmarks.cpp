@@ -0,0 +1,189 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Grid/Landmarks.h"
+
+#include "Async/ParallelFor.h"
+#include "Grid/Grid.h"
+#include "GridAISim/GridAISim.h"
+#include "Simulation/SimStats.h"
+
+namespace
+{
+	/**
+	 * @return The obstacle-free point closest to the given one, in the growing square rings around it
+	 */
+	bool FindFreePointNear(const FGrid& InGrid, const FIntPoint& InPoint, FIntPoint& OutPoint)
+	{
+		const FIntPoint Size = InGrid.GetSize();
+		const int32 MaxRadius = FMath::Max(Size.X, Size.Y);
+		for (int32 Radius = 0; Radius < MaxRadius; ++Radius)
+		{
+			for (int32 Y = InPoint.Y - Radius; Y <= InPoint.Y + Radius; ++Y)
+			{
+				// Only the ring itself, the inner points were checked by the smaller radii
+				const bool bIsEdgeRow = Y == InPoint.Y - Radius || Y == InPoint.Y + Radius;
+				const int32 StepX = bIsEdgeRow ? 1 : 2 * Radius;
+				for (int32 X = InPoint.X - Radius; X <= InPoint.X + Radius; X += StepX)
+				{
+					const FIntPoint Point(X, Y);
+					if (InGrid.IsPointOnGrid(Point) && !InGrid.At(Point).bIsObstacle)
+					{
+						OutPoint = Point;
+						return true;
+					}
+				}
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * @return The point of the border at the given distance along it, going around from the origin
+	 */
+	FIntPoint GetBorderPoint(const FIntPoint& InSize, int32 InDistance)
+	{
+		const int32 Width = InSize.X - 1;
+		const int32 Height = InSize.Y - 1;
+		if (InDistance < Width)
+		{
+			return {InDistance, 0};
+		}
+		InDistance -= Width;
+		if (InDistance < Height)
+		{
+			return {Width, InDistance};
+		}
+		InDistance -= Height;
+		if (InDistance < Width)
+		{
+			return {Width - InDistance, Height};
+		}
+		InDistance -= Width;
+		return {0, FMath::Max(Height - InDistance, 0)};
+	}
+}
+
+void FGridLandmarks::Build(const FGrid& InGrid, int32 InNumLandmarks)
+{
+	LLM_SCOPE_BYTAG(GridSim_Pathfinding);
+	TRACE_CPUPROFILER_EVENT_SCOPE(GridSim_BuildLandmarks);
+
+	ObstacleVersion = InGrid.GetObstacleVersion();
+	Landmarks.Reset();
+	Distances.Empty();
+	NumLandmarks = 0;
+
+	const FIntPoint Size = InGrid.GetSize();
+	const int32 NumPoints = InGrid.GetGrid().Num();
+	if (InNumLandmarks <= 0 || NumPoints == 0)
+	{
+		return;
+	}
+
+	if (InNumLandmarks > MaxLandmarks)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FGridLandmarks::Build] %d landmarks requested, %d are used."), InNumLandmarks,
+		       MaxLandmarks);
+	}
+
+	// The landmarks behind the points make the best bounds, and the borders are behind most of the points
+	const int32 Perimeter = FMath::Max(2 * (Size.X - 1 + Size.Y - 1), 1);
+	const int32 NumRequested = FMath::Min(InNumLandmarks, MaxLandmarks);
+	for (int32 Index = 0; Index < NumRequested; ++Index)
+	{
+		FIntPoint Landmark;
+		if (FindFreePointNear(InGrid, GetBorderPoint(Size, Index * Perimeter / NumRequested), Landmark))
+		{
+			Landmarks.AddUnique(Landmark);
+		}
+	}
+
+	NumLandmarks = Landmarks.Num();
+	if (NumLandmarks == 0)
+	{
+		return;
+	}
+
+	// A breadth-first flood per landmark, each into its own table, so the workers don't share the cache lines
+	TArray<TArray<uint16>> LandmarkDistances;
+	LandmarkDistances.SetNum(NumLandmarks);
+	ParallelFor(NumLandmarks, [&InGrid, &LandmarkDistances, NumPoints, this](int32 LandmarkIndex)
+	{
+		LLM_SCOPE_BYTAG(GridSim_Pathfinding);
+
+		TArray<uint16>& Table = LandmarkDistances[LandmarkIndex];
+		Table.Init(Unreachable, NumPoints);
+
+		const FGridPoint& Start = InGrid.At(Landmarks[LandmarkIndex]);
+		TArray<int32> Queue;
+		Queue.Reserve(NumPoints);
+		Queue.Add(Start.Index);
+		Table[Start.Index] = 0;
+		for (int32 QueueIndex = 0; QueueIndex < Queue.Num(); ++QueueIndex)
+		{
+			const FGridPoint& Current = InGrid.GetGrid()[Queue[QueueIndex]];
+			const uint16 NextDistance = StaticCast<uint16>(FMath::Min(Table[Current.Index] + 1, Unreachable - 1));
+			InGrid.ForEachNeighbor(Current.GridCoords, [&Table, &Queue, NextDistance](const FGridPoint& Neighbor)
+			{
+				if (!Neighbor.bIsObstacle && Table[Neighbor.Index] == Unreachable)
+				{
+					Table[Neighbor.Index] = NextDistance;
+					Queue.Add(Neighbor.Index);
+				}
+			});
+		}
+	});
+
+	Distances.SetNumUninitialized(NumPoints * NumLandmarks);
+	ParallelFor(NumPoints, [&LandmarkDistances, this](int32 PointIndex)
+	{
+		for (int32 LandmarkIndex = 0; LandmarkIndex < NumLandmarks; ++LandmarkIndex)
+		{
+			Distances[PointIndex * NumLandmarks + LandmarkIndex] = LandmarkDistances[LandmarkIndex][PointIndex];
+		}
+	});
+
+	GRIDSIM_LOG(Verbose, TEXT("[FGridLandmarks::Build] %d landmarks over %d points."), NumLandmarks, NumPoints);
+}
+
+bool FGridLandmarks::IsUpToDate(const FGrid& InGrid) const
+{
+	return ObstacleVersion == InGrid.GetObstacleVersion();
+}
+
+int32 FGridLandmarks::Num() const
+{
+	return NumLandmarks;
+}
+
+void FGridLandmarks::GetDistances(int32 InPointIndex, FDistances& OutDistances) const
+{
+	OutDistances.Reset();
+	if (NumLandmarks > 0)
+	{
+		OutDistances.Append(Distances.GetData() + InPointIndex * NumLandmarks, NumLandmarks);
+	}
+}
+
+int32 FGridLandmarks::Estimate(int32 InPointIndex, const FDistances& InGoalDistances) const
+{
+	if (InGoalDistances.Num() != NumLandmarks)
+	{
+		return 0;
+	}
+
+	// A saturated distance only makes the bound smaller, so it stays a lower bound
+	int32 Bound = 0;
+	const uint16* PointDistances = Distances.GetData() + InPointIndex * NumLandmarks;
+	for (int32 LandmarkIndex = 0; LandmarkIndex < NumLandmarks; ++LandmarkIndex)
+	{
+		const uint16 PointDistance = PointDistances[LandmarkIndex];
+		const uint16 GoalDistance = InGoalDistances[LandmarkIndex];
+		if (PointDistance != Unreachable && GoalDistance != Unreachable)
+		{
+			Bound = FMath::Max(Bound, FMath::Abs(PointDistance - GoalDistance));
+		}
+	}
+	return Bound;
+}
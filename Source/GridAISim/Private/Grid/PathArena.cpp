@@ -0,0 +1,170 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Grid/PathArena.h"
+
+#include "GridAISim/GridAISim.h"
+#include "Simulation/SimStats.h"
+
+namespace
+{
+	// The step of every direction code. All the grid types move to a subset of these.
+	const FIntPoint StepDirections[] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+	// The direction code of every step, indexed by (X + 1) * 3 + Y + 1. The point itself has no code.
+	constexpr int32 DirectionCodes[] = {5, 4, 3, 6, INDEX_NONE, 2, 7, 0, 1};
+
+	int32 GetDirectionCode(const FIntPoint& InStep)
+	{
+		if (FMath::Abs(InStep.X) > 1 || FMath::Abs(InStep.Y) > 1)
+		{
+			return INDEX_NONE;
+		}
+		return DirectionCodes[(InStep.X + 1) * 3 + InStep.Y + 1];
+	}
+}
+
+FPathArena::FConstIterator::FConstIterator(const FPathArena& InArena, FPathHandle InPath)
+{
+	if (InArena.IsValid(InPath))
+	{
+		const FPathRecord& Record = InArena.Records[InPath];
+		Words = InArena.Words.GetData() + Record.FirstWord;
+		Point = Record.Start;
+		NumSteps = Record.NumSteps;
+	}
+}
+
+FPathArena::FConstIterator& FPathArena::FConstIterator::operator++()
+{
+	if (StepIndex < NumSteps)
+	{
+		const uint32 Code = (Words[StepIndex / StepsPerWord] >> (StepIndex % StepsPerWord * BitsPerStep)) & 0x7;
+		Point += StepDirections[Code];
+	}
+	++StepIndex;
+	return *this;
+}
+
+FPathHandle FPathArena::Add(TConstArrayView<FIntPoint> InPoints)
+{
+	LLM_SCOPE_BYTAG(GridSim_Pathfinding);
+
+	if (InPoints.Num() == 0)
+	{
+		return INDEX_NONE;
+	}
+
+	FPathRecord Record;
+	Record.Start = InPoints[0];
+	Record.NumSteps = InPoints.Num() - 1;
+
+	// Reclaiming the freed words first may save growing the arena
+	const int32 NumWords = Record.NumWords();
+	if (NumFreeWords > 0 && NumFreeWords >= Words.Num() / 2 && Words.Num() + NumWords > Words.Max())
+	{
+		Compact();
+	}
+
+	Record.FirstWord = Words.Num();
+	Words.AddZeroed(NumWords);
+	for (int32 StepIndex = 0; StepIndex < Record.NumSteps; ++StepIndex)
+	{
+		const int32 Code = GetDirectionCode(InPoints[StepIndex + 1] - InPoints[StepIndex]);
+		if (Code == INDEX_NONE)
+		{
+			UE_LOG(LogSim, Warning, TEXT("[FPathArena::Add] %s doesn't neighbor %s, the path is not stored."),
+			       *InPoints[StepIndex + 1].ToString(), *InPoints[StepIndex].ToString());
+			Words.SetNum(Record.FirstWord, false);
+			return INDEX_NONE;
+		}
+		const int32 Shift = StepIndex % StepsPerWord * BitsPerStep;
+		Words[Record.FirstWord + StepIndex / StepsPerWord] |= StaticCast<uint32>(Code) << Shift;
+	}
+
+	const FPathHandle Path = FreeRecords.Num() > 0 ? FreeRecords.Pop(false) : Records.AddDefaulted();
+	Records[Path] = Record;
+	return Path;
+}
+
+void FPathArena::Free(FPathHandle InPath)
+{
+	if (!IsValid(InPath))
+	{
+		return;
+	}
+
+	FPathRecord& Record = Records[InPath];
+	NumFreeWords += Record.NumWords();
+	Record.NumSteps = INDEX_NONE;
+	FreeRecords.Add(InPath);
+}
+
+void FPathArena::Reset()
+{
+	Records.Reset();
+	FreeRecords.Reset();
+	Words.Reset();
+	NumFreeWords = 0;
+}
+
+bool FPathArena::IsValid(FPathHandle InPath) const
+{
+	return Records.IsValidIndex(InPath) && Records[InPath].NumSteps != INDEX_NONE;
+}
+
+int32 FPathArena::Num(FPathHandle InPath) const
+{
+	return IsValid(InPath) ? Records[InPath].NumSteps + 1 : 0;
+}
+
+FIntPoint FPathArena::GetPoint(FPathHandle InPath, int32 InIndex) const
+{
+	FConstIterator It(*this, InPath);
+	for (int32 Index = 0; Index < InIndex && It; ++Index)
+	{
+		++It;
+	}
+	return It ? *It : FIntPoint::ZeroValue;
+}
+
+FPathArena::FConstIterator FPathArena::CreateConstIterator(FPathHandle InPath) const
+{
+	return FConstIterator(*this, InPath);
+}
+
+SIZE_T FPathArena::GetAllocatedSize() const
+{
+	return Records.GetAllocatedSize() + FreeRecords.GetAllocatedSize() + Words.GetAllocatedSize()
+		+ CompactOrder.GetAllocatedSize();
+}
+
+void FPathArena::Compact()
+{
+	CompactOrder.Reset();
+	for (int32 Index = 0; Index < Records.Num(); ++Index)
+	{
+		if (Records[Index].NumSteps != INDEX_NONE)
+		{
+			CompactOrder.Add(Index);
+		}
+	}
+	CompactOrder.Sort([this](FPathHandle InA, FPathHandle InB)
+	{
+		return Records[InA].FirstWord < Records[InB].FirstWord;
+	});
+
+	// Every path moves towards the front, so it never overwrites the ones after it
+	int32 NextWord = 0;
+	for (const FPathHandle Path : CompactOrder)
+	{
+		FPathRecord& Record = Records[Path];
+		const int32 NumWords = Record.NumWords();
+		FMemory::Memmove(Words.GetData() + NextWord, Words.GetData() + Record.FirstWord, NumWords * sizeof(uint32));
+		Record.FirstWord = NextWord;
+		NextWord += NumWords;
+	}
+
+	Words.SetNum(NextWord, false);
+	NumFreeWords = 0;
+}
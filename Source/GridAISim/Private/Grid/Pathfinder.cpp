@@ -6,6 +6,7 @@
 #include <functional>
 
 #include "GameModes/GameModeDefault.h" // FGrid
+#include "Grid/GridDebugOverlayComponent.h"
 #include "GridAISim/GridAISim.h"
 #include "ProfilingDebugging/CountersTrace.h"
 
@@ -17,7 +18,7 @@ static const int32 ConnectionCost = 1;
 bool Path::LessDistancePredicate::operator()(const FNodeRecord& LeftRecord, const FNodeRecord& RightRecord) const
 {
 	TRACE_COUNTER_INCREMENT(LessOpCount);
-	UE_LOG(LogSim, Display, TEXT("LeftRecord: [%s]: Est.Cost: %s, Compare Weight: %s, IsVisited:%s, "
+	GRIDSIM_LOG(VeryVerbose, TEXT("LeftRecord: [%s]: Est.Cost: %s, Compare Weight: %s, IsVisited:%s, "
 		       "\nFNodeRecord RightRecord[%s]: Est.Cost: %s,Compare Weight: %s, IsVisited:%s"),
 	       *LeftRecord.Node.XY.ToString(), *FString::SanitizeFloat(LeftRecord.EstimatedTotalCost),
 	       *FString::SanitizeFloat(LeftRecord.EstimatedTotalCost * StaticCast<int32>(LeftRecord.VisitStatus)),
@@ -49,7 +50,12 @@ TArray<Path::FConnection> Path::FGraph::GetNodeConnections(const FNodeRecord& In
 
 	TArray<Path::FConnection> Connections;
 
-	auto Points = GridRef.GetNodeConnections(FGridPoint());
+	if (GridRef == nullptr)
+	{
+		return Connections;
+	}
+
+	auto Points = GridRef->GetNodeConnections(FGridPoint());
 
 	for (auto Point : Points)
 	{
@@ -64,60 +70,199 @@ TArray<Path::FConnection> Path::FGraph::GetNodeConnections(const FNodeRecord& In
 
 TArray<Path::FNode> Path::FGraph::GetNodeConnections(const FNode& InNode) const
 {
-	TArray<Path::FNode> NodeConnections;
-
-	auto Points = GridRef.GetNodeConnections(FGridPoint(InNode.XY));
+	TArray<FNode, TInlineAllocator<8>> NodeConnections;
+	GetNodeConnections(InNode, NodeConnections);
+	return TArray<Path::FNode>(NodeConnections);
+}
 
-	for (auto Point : Points)
+void Path::FGraph::GetNodeConnections(const FNode& InNode, TArray<FNode, TInlineAllocator<8>>& OutNodes,
+                                       int32 InFootprintSize, bool bInIgnoreUnits, FUnitHandle InMover) const
+{
+	OutNodes.Reset();
+	auto AddNode = [this, &OutNodes, InFootprintSize, bInIgnoreUnits, InMover](const FGridPoint& Point)
 	{
 		Path::FNode Node(Point.GridCoords);
-		Node.bIsReachable = (Point.GameActor == nullptr ? true : false);
-		NodeConnections.Emplace(Node);
+		const bool bIsOpen = bInIgnoreUnits ? !Point.bIsObstacle : Point.IsFree();
+		Node.bIsReachable = bIsOpen && Point.Clearance >= InFootprintSize;
+		// The clearance covers the obstacles only, the cells of a larger footprint are looked at one by one
+		if (Node.bIsReachable && !bInIgnoreUnits && InFootprintSize > 1)
+		{
+			Node.bIsReachable = IsFootprintFree(Point.GridCoords, InFootprintSize, InMover);
+		}
+		OutNodes.Emplace(Node);
+	};
+
+	if (Snapshot.IsValid())
+	{
+		Snapshot->ForEachNeighbor(InNode.XY, AddNode);
+	}
+	else
+	{
+		GridRef->ForEachNeighbor(InNode.XY, AddNode);
 	}
+}
 
-	return NodeConnections;
+bool Path::FGraph::IsFootprintFree(const FIntPoint& InPoint, int32 InFootprintSize, FUnitHandle InMover) const
+{
+	for (int32 OffsetY = 0; OffsetY < InFootprintSize; ++OffsetY)
+	{
+		for (int32 OffsetX = 0; OffsetX < InFootprintSize; ++OffsetX)
+		{
+			const FUnitHandle Unit = At(InPoint + FIntPoint(OffsetX, OffsetY)).Unit;
+			if (Unit != INDEX_NONE && Unit != InMover)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool Path::FGraph::IsPointOnGrid(const FIntPoint& InPoint) const
+{
+	return Snapshot.IsValid() ? Snapshot->IsPointOnGrid(InPoint) : GridRef->IsPointOnGrid(InPoint);
+}
+
+const FGridPoint& Path::FGraph::At(const FIntPoint& InPoint) const
+{
+	return Snapshot.IsValid() ? Snapshot->At(InPoint) : GridRef->At(InPoint);
+}
+
+bool Path::FGraph::AreConnected(const FIntPoint& InPointA, const FIntPoint& InPointB) const
+{
+	return Snapshot.IsValid() ? Snapshot->AreConnected(InPointA, InPointB) : GridRef->AreConnected(InPointA, InPointB);
 }
 
 void GS_Pathfinder::InitGraph(const FGrid& InGrid)
 {
+	LLM_SCOPE_BYTAG(GridSim_Pathfinding);
+
 	Graph = MakeUnique<Path::FGraph>(InGrid);
 }
 
-TArray<Path::FNode> GS_Pathfinder::FindPath(const Path::FNode& InStartNode, const Path::FNode& InEndNode)
+void GS_Pathfinder::InitGraph(const FGridSnapshotRef& InSnapshot)
 {
-	UE_LOG(LogSim, Display, TEXT("[FindPath] Building a path from %s to %s"), *InStartNode.XY.ToString(),
-	       *InEndNode.XY.ToString());
-	using namespace Path;
+	LLM_SCOPE_BYTAG(GridSim_Pathfinding);
 
-	TArray<FNodeRecord*> NodesArray;
+	Graph = MakeUnique<Path::FGraph>(InSnapshot);
+	Landmarks = FGridLandmarks();
+}
 
+TArray<Path::FNode> GS_Pathfinder::FindPath(const Path::FNode& InStartNode, const Path::FNode& InEndNode,
+                                            int32 InFootprintSize, bool bInIgnoreUnits)
+{
 	TArray<Path::FNode> ResultNodes;
+	if (SearchPath(InStartNode, InEndNode, InFootprintSize, bInIgnoreUnits))
+	{
+		ResultNodes.Reserve(PathPoints.Num());
+		for (const FIntPoint& Point : PathPoints)
+		{
+			Path::FNode& Node = ResultNodes.AddDefaulted_GetRef();
+			Node.XY = Point;
+			Node.bIsReachable = true;
+		}
+	}
+	return ResultNodes;
+}
+
+FPathHandle GS_Pathfinder::FindPath(const Path::FNode& InStartNode, const Path::FNode& InEndNode,
+                                    FPathArena& OutPaths, int32 InFootprintSize, bool bInIgnoreUnits)
+{
+	return SearchPath(InStartNode, InEndNode, InFootprintSize, bInIgnoreUnits) ? OutPaths.Add(PathPoints) : INDEX_NONE;
+}
 
-	//Path::FNodeRecordPtr StartNodeRecord = MakeShared<Path::FNodeRecord>(StartNode);
-	FNodeRecord* StartNodeRecord = new FNodeRecord(InStartNode);
-	StartNodeRecord->HeuristicValue = Path::FHeuristic::Estimate(InStartNode, InEndNode);
+bool GS_Pathfinder::SearchPath(const Path::FNode& InStartNode, const Path::FNode& InEndNode, int32 InFootprintSize,
+                               bool bInIgnoreUnits)
+{
+	GRIDSIM_SCOPE(Pathfinding);
+	LLM_SCOPE_BYTAG(GridSim_Pathfinding);
+
+	GRIDSIM_LOG(Verbose, TEXT("[FindPath] Building a path from %s to %s"), *InStartNode.XY.ToString(),
+	            *InEndNode.XY.ToString());
+	using namespace Path;
+
+	// The records of the previous searches are reused, so the searches don't allocate once warmed up
+	TArray<FNodeRecord*>& NodesArray = SearchNodes;
+	NodesArray.Reset();
+	PathPoints.Reset();
+
+	if (InFootprintSize > FGrid::MaxClearance)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FindPath] Footprint %d is larger than the tracked clearance %d."),
+		       InFootprintSize, FGrid::MaxClearance);
+		return false;
+	}
+
+	// The searches for the walled off targets would flood the whole area of the start before failing
+	if (!Graph->AreConnected(InStartNode.XY, InEndNode.XY))
+	{
+		GRIDSIM_LOG(Verbose, TEXT("[FindPath] %s is not connected to %s"), *InEndNode.XY.ToString(),
+		            *InStartNode.XY.ToString());
+		return false;
+	}
+
+	// The neighbors are only entered by the footprints fitting them, the start has to fit as well
+	const FGridPoint& StartPoint = Graph->At(InStartNode.XY);
+	const FUnitHandle Mover = StartPoint.Unit;
+	if (StartPoint.Clearance < InFootprintSize
+		|| (!bInIgnoreUnits && InFootprintSize > 1 && !Graph->IsFootprintFree(InStartNode.XY, InFootprintSize, Mover)))
+	{
+		GRIDSIM_LOG(Verbose, TEXT("[FindPath] Footprint %d doesn't fit the start %s"), InFootprintSize,
+		            *InStartNode.XY.ToString());
+		return false;
+	}
+
+	UpdateLandmarks();
+	const Path::FGraph& SearchGraph = *Graph;
+	const bool bUseLandmarks = Landmarks.Num() > 0 && SearchGraph.IsPointOnGrid(InEndNode.XY);
+	FGridLandmarks::FDistances EndDistances;
+	if (bUseLandmarks)
+	{
+		Landmarks.GetDistances(SearchGraph.At(InEndNode.XY).Index, EndDistances);
+	}
+
+	// No step changes a coordinate by more than one on any of the grid types, so the larger coordinate difference
+	// is a lower bound too, for the points the landmarks tell nothing about
+	auto Estimate = [&](const FNode& InNode)
+	{
+		if (!bUseLandmarks)
+		{
+			return Path::FHeuristic::Estimate(InNode, InEndNode);
+		}
+		const FIntPoint Offset = InEndNode.XY - InNode.XY;
+		const int32 Bound = FMath::Max(FMath::Abs(Offset.X), FMath::Abs(Offset.Y));
+		return StaticCast<float>(FMath::Max(Bound, Landmarks.Estimate(SearchGraph.At(InNode.XY).Index, EndDistances)));
+	};
+
+	FNodeRecord* StartNodeRecord = AcquireRecord(FNodeRecord(InStartNode));
+	StartNodeRecord->HeuristicValue = Estimate(InStartNode);
 	StartNodeRecord->CostSoFar = 0.f;
 	StartNodeRecord->VisitStatus = Discovered;
 	StartNodeRecord->EstimatedTotalCost = StartNodeRecord->HeuristicValue;
 
 	NodesArray.HeapPush(StartNodeRecord, Path::LessDistancePredicate());
+	++Counters.HeapOperations;
 
 	Path::FNodeRecord* CurrentNodeRecord = nullptr;
+	TArray<Path::FNode, TInlineAllocator<8>> NeighborNodes;
 
 	while (NodesArray.Num() > 0)
 	{
 		//NodesArray.HeapSort(Path::LessDistancePredicate());
-		for (auto* Node : NodesArray)
+		if (UE_LOG_ACTIVE(LogSim, VeryVerbose))
 		{
-			UE_LOG(LogSim, Display, TEXT("[FindPath] NodeArray Node: %s, Est.Cost: %s. VisitStatus: %s"),
-			       *Node->Node.XY.ToString(),
-			       *FString::SanitizeFloat(Node->EstimatedTotalCost),
-			       *FString(Node->VisitStatus == Visited ? "Visited" : Node->VisitStatus == Discovered ? "Discovered"
-			        : Node->VisitStatus == EVisitStatus::Unvisited ? "Unvisited" : "Broken, or what?"));
+			for (auto* Node : NodesArray)
+			{
+				GRIDSIM_LOG(VeryVerbose, TEXT("[FindPath] NodeArray Node: %s, Est.Cost: %s. VisitStatus: %s"),
+				            *Node->Node.XY.ToString(),
+				            *FString::SanitizeFloat(Node->EstimatedTotalCost),
+				            *FString(Node->VisitStatus == Visited ? "Visited" : Node->VisitStatus == Discovered ? "Discovered"
+				             : Node->VisitStatus == EVisitStatus::Unvisited ? "Unvisited" : "Broken, or what?"));
+			}
 		}
 		if(CurrentNodeRecord == NodesArray.HeapTop())
 		{
-			UE_LOG(LogSim, Display, TEXT("[FindPath] Heap evaluation error. Welcome to the infinite loop! (jk, breaking the loop..)"));
+			GRIDSIM_LOG(Verbose, TEXT("[FindPath] Heap evaluation error. Welcome to the infinite loop! (jk, breaking the loop..)"));
 			break;
 		}
 		//That's how it worked:
@@ -127,6 +272,8 @@ TArray<Path::FNode> GS_Pathfinder::FindPath(const Path::FNode& InStartNode, cons
 		NodesArray.HeapPop(CurrentNodeRecord, Path::LessDistancePredicate(), false);
 		CurrentNodeRecord->VisitStatus = Visited;
 		NodesArray.HeapPush(CurrentNodeRecord, Path::LessDistancePredicate());
+		Counters.HeapOperations += 2;
+		++Counters.NodesExpanded;
 		//~
 		
 		// Check if the current node is the target node
@@ -135,14 +282,14 @@ TArray<Path::FNode> GS_Pathfinder::FindPath(const Path::FNode& InStartNode, cons
 			break;
 		}
 
-		UE_LOG(LogSim, Display, TEXT("[FindPath]Current Node: %s"), *CurrentNodeRecord->Node.XY.ToString());
+		GRIDSIM_LOG(VeryVerbose, TEXT("[FindPath]Current Node: %s"), *CurrentNodeRecord->Node.XY.ToString());
 
 		// // Get the current node's connections and iterate through them
-		TArray<Path::FNode> NeighborNodes = Graph->GetNodeConnections(CurrentNodeRecord->Node);
+		Graph->GetNodeConnections(CurrentNodeRecord->Node, NeighborNodes, InFootprintSize, bInIgnoreUnits, Mover);
 		for (auto& NeighborNode : NeighborNodes)
 		{
-			UE_LOG(LogSim, Display, TEXT("[FindPath]   Neighbor Node: %s is %s"), *NeighborNode.XY.ToString(),
-			       *FString(NeighborNode.bIsReachable ? "reachable" : "not reachable"));
+			GRIDSIM_LOG(VeryVerbose, TEXT("[FindPath]   Neighbor Node: %s is %s"), *NeighborNode.XY.ToString(),
+			            *FString(NeighborNode.bIsReachable ? "reachable" : "not reachable"));
 			if (!NeighborNode.bIsReachable)
 			{
 				continue;
@@ -176,7 +323,7 @@ TArray<Path::FNode> GS_Pathfinder::FindPath(const Path::FNode& InStartNode, cons
 			// Or to a new undiscovered node
 			else
 			{
-				NextNodeHeuristicValeue = Path::FHeuristic::Estimate(NeighborNode, InEndNode);
+				NextNodeHeuristicValeue = Estimate(NeighborNode);
 			}
 
 			NextNodeRecord.HeuristicValue = NextNodeHeuristicValeue;
@@ -187,7 +334,8 @@ TArray<Path::FNode> GS_Pathfinder::FindPath(const Path::FNode& InStartNode, cons
 			if (NextNodeRecord.VisitStatus == Unvisited)
 			{
 				NextNodeRecord.VisitStatus = Discovered;
-				NodesArray.HeapPush(new FNodeRecord(NextNodeRecord), Path::LessDistancePredicate());
+				NodesArray.HeapPush(AcquireRecord(NextNodeRecord), Path::LessDistancePredicate());
+				++Counters.HeapOperations;
 			}
 		}
 		//CurrentNodeRecord->VisitStatus = Visited;
@@ -195,17 +343,17 @@ TArray<Path::FNode> GS_Pathfinder::FindPath(const Path::FNode& InStartNode, cons
 		//NodesArray.HeapSort(Path::LessDistancePredicate());
 	}
 
-	if (CurrentNodeRecord->Node != InEndNode)
+	const bool bFound = CurrentNodeRecord->Node == InEndNode;
+	if (!bFound)
 	{
-		UE_LOG(LogSim, Display, TEXT("[FindPath] No path could be found from %s to %s"), *InStartNode.XY.ToString(),
-		   *InEndNode.XY.ToString());
-		return TArray<Path::FNode>();
+		GRIDSIM_LOG(Verbose, TEXT("[FindPath] No path could be found from %s to %s"), *InStartNode.XY.ToString(),
+		            *InEndNode.XY.ToString());
 	}
 	else
 	{
 		while (CurrentNodeRecord != nullptr)
 		{
-			ResultNodes.Add(CurrentNodeRecord->Node);
+			PathPoints.Add(CurrentNodeRecord->Node.XY);
 			if (auto* ParentNode = CurrentNodeRecord->ParentNodePtr)
 			{
 				CurrentNodeRecord = ParentNode;
@@ -215,71 +363,94 @@ TArray<Path::FNode> GS_Pathfinder::FindPath(const Path::FNode& InStartNode, cons
 				break;
 			}
 		}
-		Algo::Reverse(ResultNodes);
+		Algo::Reverse(PathPoints);
 	}
 
-	// TODO: make sure, that 
-	NodesArray = TArray<FNodeRecord*>();
-	/*for (auto* entry : NodesArray)
-	{
-		delete entry;
-	}*/
+	// Every record of the search is in the array, the visited ones are pushed back after the expansion
+	FreeRecords.Append(NodesArray);
+	NodesArray.Reset();
 
+	if (UE_LOG_ACTIVE(LogSim, Verbose) && PathPoints.Num() > 0)
+	{
+		LLM_SCOPE_BYTAG(GridSim_Logging);
+		FString NodesString;
+		for (const FIntPoint& Point : PathPoints)
+		{
+			NodesString.Appendf(TEXT(" [%s] "), *Point.ToString());
+		}
+		UE_LOG(LogSim, Verbose, TEXT("[FindPath] Path found: %s"), *NodesString);
+	}
+	return bFound;
+}
 
-	FString NodesString;
-	for (auto Node : ResultNodes)
+Path::FNodeRecord* GS_Pathfinder::AcquireRecord(const Path::FNodeRecord& InRecord)
+{
+	if (FreeRecords.Num() > 0)
 	{
-		NodesString.Appendf(TEXT(" [%s] "), *Node.XY.ToString());
+		Path::FNodeRecord* Record = FreeRecords.Pop(false);
+		*Record = InRecord;
+		return Record;
 	}
 
-	UE_LOG(LogSim, Display, TEXT("[FindPath] Path found: %s"), *NodesString);
-	return ResultNodes;
+	++Counters.Allocations;
+	return new Path::FNodeRecord(InRecord);
 }
 
-TArray<Path::FNode> GS_Pathfinder::GetNeighbors(const Path::FNode& InNode)
+const FSimStepCounters& GS_Pathfinder::GetCounters() const
 {
-	return Graph->GetNodeConnections(InNode);
+	return Counters;
 }
 
-void GS_Pathfinder::VisualizePath(UWorld* World, TArray<Path::FNode> Array, float GridScale)
+void GS_Pathfinder::ResetCounters()
 {
-	if (World == nullptr)
+	Counters.Reset();
+}
+
+void GS_Pathfinder::SetNumLandmarks(int32 InNumLandmarks)
+{
+	NumLandmarks = FMath::Clamp(InNumLandmarks, 0, FGridLandmarks::MaxLandmarks);
+	if (NumLandmarks != Landmarks.Num())
 	{
-		UE_LOG(LogSim, Warning, TEXT("[VisualizePath] World is nullptr."))
-		return;
+		// Built by the next search
+		Landmarks = FGridLandmarks();
 	}
+}
 
-	if (Array.Num() < 2)
+void GS_Pathfinder::UpdateLandmarks()
+{
+	if (NumLandmarks > 0 && Graph.IsValid() && Graph->GridRef != nullptr && !Landmarks.IsUpToDate(*Graph->GridRef))
 	{
-		UE_LOG(LogSim, Display, TEXT("[VisualizePath] Path is too short for visualization."))
-		return;
+		Landmarks.Build(*Graph->GridRef, NumLandmarks);
 	}
+}
 
-	const auto FirstNode = *Array.begin();
-	const FVector StartVec{
-		StaticCast<float>(FirstNode.XY.X) * GridScale, StaticCast<float>(FirstNode.XY.Y) * GridScale,
-		100.f
-	};
+TArray<Path::FNode> GS_Pathfinder::GetNeighbors(const Path::FNode& InNode)
+{
+	return Graph->GetNodeConnections(InNode);
+}
 
-	FVector PreviousLocation = StartVec;
-	for (const auto Node : Array)
+void GS_Pathfinder::VisualizePath(UGS_GridDebugOverlayComponent* InOverlay, const FPathArena& InPaths,
+                                  FPathHandle InPath) const
+{
+	if (InOverlay == nullptr || !InOverlay->IsLayerEnabled(EGridDebugLayer::Paths) || !InPaths.IsValid(InPath))
 	{
-		if (Node == FirstNode)
-		{
-			continue;
-		}
-		const FVector NodeVec{
-			StaticCast<float>(Node.XY.X) * GridScale, StaticCast<float>(Node.XY.Y) *
-			GridScale,
-			100.f
-		};
-		DrawDebugLine(World, PreviousLocation, NodeVec, FColor::Green, true, 100.f, 10, 5.f);
-		UE_LOG(LogSim, Display, TEXT("[VisualizePath] Draw line from %s to %s."), *PreviousLocation.ToString(),
-		       *NodeVec.ToString());
-		PreviousLocation = NodeVec;
+		return;
+	}
+
+	// Decoded for the overlay only, which keeps its own copy anyway
+	TArray<FIntPoint> OverlayPoints;
+	OverlayPoints.Reserve(InPaths.Num(InPath));
+	for (FPathArena::FConstIterator It = InPaths.CreateConstIterator(InPath); It; ++It)
+	{
+		OverlayPoints.Add(*It);
 	}
+	InOverlay->AddPath(OverlayPoints, FColor::Green);
 }
 
 GS_Pathfinder::~GS_Pathfinder()
 {
+	for (Path::FNodeRecord* Record : FreeRecords)
+	{
+		delete Record;
+	}
 }
@@ -0,0 +1,682 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/GridSimulation.h"
+
+#include "Async/ParallelFor.h"
+#include "Grid/Pathfinder.h"
+#include "GridAISim/GridAISim.h"
+
+static TAutoConsoleVariable<bool> CVarSquadPathfinding(
+	TEXT("GridSim.SquadPathfinding"),
+	true,
+	TEXT("Groups the nearby units approaching the same target into squads, which follow a shared path to it.\n"
+		"Otherwise, every unit steps straight towards its target."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarAssertNoStepAllocations(
+	TEXT("GridSim.AssertNoStepAllocations"),
+	0,
+	TEXT("Flags every simulation step, which allocates on the heap after the given number of warm-up steps. 0: off.\n"
+		"Needs the -GridSimCountAllocations command line switch, the allocations aren't counted otherwise.\n"
+		"Stats and CSV captures allocate on their own, keep them off meanwhile."),
+	ECVF_Cheat);
+
+FGridSimulation::FGridSimulation()
+	: Pathfinder(MakeUnique<GS_Pathfinder>())
+{
+	Utility.SetActions(FUtilityEvaluator::MakeDefaultActions());
+}
+
+FGridSimulation::~FGridSimulation()
+{
+	WaitForDecisions();
+}
+
+void FGridSimulation::Init(int32 InSizeX, int32 InSizeY, EGridType InGridType)
+{
+	LLM_SCOPE_BYTAG(GridSim_Grid);
+
+	InvalidateDecisions();
+	Units.Reset();
+	TargetCache.Reset();
+	StepEvents.Reset(INDEX_NONE);
+	SimulationStep = 0;
+
+	Grid.Init(InSizeX, InSizeY, InGridType);
+	GridSnapshot.Reset();
+	Influence.Init(InSizeX, InSizeY);
+	Presence.Init(InSizeX, InSizeY);
+	Pathfinder->InitGraph(Grid);
+}
+
+void FGridSimulation::SetTargetHysteresis(float InHysteresisCells)
+{
+	InvalidateDecisions();
+	TargetHysteresisCells = FMath::Max(0.f, InHysteresisCells);
+}
+
+void FGridSimulation::SetUtilityActions(TArray<FUtilityAction>&& InActions)
+{
+	InvalidateDecisions();
+	Utility.SetActions(MoveTemp(InActions));
+}
+
+void FGridSimulation::SetExternalActions(TConstArrayView<EUnitAction> InActions)
+{
+	// Applied on top of the intents, so the ones chosen in advance stay valid
+	ExternalActions = InActions;
+}
+
+FUnitHandle FGridSimulation::AddUnit(const FUnitState& InUnit)
+{
+	LLM_SCOPE_BYTAG(GridSim_Units);
+
+	InvalidateDecisions();
+	if (!Grid.IsPointOnGrid(InUnit.Cell) || !Grid.At(InUnit.Cell).IsFree())
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FGridSimulation::AddUnit] Cell %s is not free."), *InUnit.Cell.ToString());
+		return INDEX_NONE;
+	}
+
+	const FUnitHandle Handle = Units.Add(InUnit);
+	if (Handle != INDEX_NONE)
+	{
+		Grid.SetUnit(InUnit.Cell, Handle);
+		Influence.AddUnit(InUnit.Team, InUnit.Cell, InUnit.AttackPower);
+	}
+	return Handle;
+}
+
+bool FGridSimulation::RestoreUnit(FUnitHandle InHandle, const FUnitState& InUnit)
+{
+	LLM_SCOPE_BYTAG(GridSim_Units);
+
+	InvalidateDecisions();
+	if (!Grid.IsPointOnGrid(InUnit.Cell) || !Grid.At(InUnit.Cell).IsFree())
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FGridSimulation::RestoreUnit] Cell %s is not free."), *InUnit.Cell.ToString());
+		return false;
+	}
+
+	if (!Units.Restore(InHandle, InUnit))
+	{
+		return false;
+	}
+	Grid.SetUnit(InUnit.Cell, InHandle);
+	Influence.AddUnit(InUnit.Team, InUnit.Cell, InUnit.AttackPower);
+	return true;
+}
+
+void FGridSimulation::RemoveUnit(FUnitHandle InHandle)
+{
+	InvalidateDecisions();
+	if (!Units.IsValid(InHandle))
+	{
+		return;
+	}
+
+	const FIntPoint Cell = Units.GetCell(InHandle);
+	Grid.SetUnit(Cell, INDEX_NONE);
+	Influence.RemoveUnit(Units.GetTeam(InHandle), Cell, Units.GetAttackPower(InHandle));
+	TargetCache.Invalidate(InHandle);
+	Units.Remove(InHandle);
+}
+
+void FGridSimulation::RemoveAllUnits()
+{
+	InvalidateDecisions();
+	Units.ForEachUnit([this](FUnitHandle Handle)
+	{
+		Grid.SetUnit(Units.GetCell(Handle), INDEX_NONE);
+	});
+	Units.RemoveAll();
+	Influence.Reset();
+	TargetCache.Reset();
+}
+
+void FGridSimulation::Step()
+{
+	LLM_SCOPE_BYTAG(GridSim_Units);
+	const uint64 AllocationsBefore = FSimAllocationCounter::GetThreadAllocations();
+
+	WaitForDecisions();
+	StepEvents.Reset(SimulationStep + 1);
+	DamagedUnits.Reset();
+
+	const TConstArrayView<EUnitAction> StepActions = ExternalActions;
+	ExternalActions = TConstArrayView<EUnitAction>();
+
+	// If there is just one, or even no units - there is nothing to simulate
+	if (Units.Num() <= 1)
+	{
+		return;
+	}
+
+	GRIDSIM_SCOPE(Step);
+
+	StepCounters.Reset();
+
+	if (DecidedStep != SimulationStep)
+	{
+		// The connectivity is read by all the decisions, it has to be up to date before they start
+		Grid.UpdateComponents();
+		DecisionHeapAllocations = 0;
+		DecideIntents(false);
+	}
+
+	if (StepActions.Num() > 0)
+	{
+		for (const FUnitHandle Unit : DecisionUnits)
+		{
+			if (StepActions.IsValidIndex(Unit) && StepActions[Unit] < EUnitAction::MAX)
+			{
+				FUnitIntent& Intent = StepIntents[Unit];
+				Intent.Action = Intent.Target != INDEX_NONE ? StepActions[Unit] : EUnitAction::Guard;
+			}
+		}
+	}
+
+	// The decisions have caught up with the changes of the grid, from here on it journals the ones of this step
+	Grid.ResetChanges();
+
+	// A single scope for all the units, the scopes per unit would cost more than the actions they measure.
+	// The number of the units is counted by StepCounters.UnitsProcessed.
+	{
+		GRIDSIM_SCOPE(UnitActions);
+		Units.ForEachUnit([this](FUnitHandle Unit)
+		{
+			// The damage is resolved after all the units acted, so nobody dies in the middle of the step
+			++StepCounters.UnitsProcessed;
+
+			const FUnitIntent& Intent = StepIntents[Unit];
+			switch (Intent.Action)
+			{
+			// Whether the target is in range is checked again, the units have moved since the intents were chosen
+			case EUnitAction::Attack:
+			case EUnitAction::Approach:
+				Engage(Unit, Intent.Target);
+				break;
+			case EUnitAction::FocusFire:
+				FocusFire(Unit, Intent.Target);
+				break;
+			case EUnitAction::Retreat:
+				Retreat(Unit);
+				break;
+			default:
+				StepEvents.Halts.Add(Unit);
+				if (Intent.Target == INDEX_NONE)
+				{
+					GRIDSIM_LOG(Verbose, TEXT("[FGridSimulation::Step] Unit %d failed to find a target."), Unit);
+				}
+				break;
+			}
+		});
+	}
+
+	// All the attacks of the step are resolved simultaneously
+	ResolveCombat();
+
+	{
+		GRIDSIM_SCOPE(Cleanup);
+		for (const FUnitKill& Kill : StepKills)
+		{
+			Units.Remove(Kill.Target);
+		}
+		++SimulationStep;
+	}
+
+	const FSimStepCounters& PathfinderCounters = Pathfinder->GetCounters();
+	StepCounters.NodesExpanded += PathfinderCounters.NodesExpanded;
+	StepCounters.HeapOperations += PathfinderCounters.HeapOperations;
+	StepCounters.Allocations += PathfinderCounters.Allocations;
+	StepCounters.HeapAllocations = StaticCast<int32>(FSimAllocationCounter::GetThreadAllocations() - AllocationsBefore
+		+ DecisionHeapAllocations);
+	StepCounters.Publish();
+
+	// The warm-up steps grow the buffers to their working sizes, the steady state shouldn't allocate anymore
+	const int32 WarmupSteps = CVarAssertNoStepAllocations.GetValueOnAnyThread();
+	if (WarmupSteps > 0 && SimulationStep > WarmupSteps && StepCounters.HeapAllocations > 0)
+	{
+		UE_LOG(LogSim, Error, TEXT("[FGridSimulation::Step] Step %d made %d heap allocations."), SimulationStep,
+		       StepCounters.HeapAllocations);
+		ensureMsgf(false, TEXT("[FGridSimulation::Step] The simulation step allocated after the warm-up."));
+	}
+}
+
+void FGridSimulation::PrepareStep()
+{
+	WaitForDecisions();
+	if (Units.Num() <= 1 || DecidedStep == SimulationStep)
+	{
+		return;
+	}
+
+	// Labeled here, the decisions only read the grid, so the owning thread may read it meanwhile too
+	Grid.UpdateComponents();
+
+	DecisionsTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this]
+	{
+		// The worker isn't the thread making the step, its allocations are counted for the step separately
+		const uint64 AllocationsBefore = FSimAllocationCounter::GetThreadAllocations();
+		DecideIntents(true);
+		DecisionHeapAllocations = FSimAllocationCounter::GetThreadAllocations() - AllocationsBefore;
+	});
+}
+
+bool FGridSimulation::IsOver() const
+{
+	GRIDSIM_SCOPE(EndCheck);
+
+	// Technically we check, if any of teams is the only one that is left on the board.
+	return Units.NumTeamsWithUnits() <= 1;
+}
+
+FUnitHandle FGridSimulation::FindClosestUnit(FUnitHandle InUnit, int32& OutDistanceSqr) const
+{
+	if (!Units.IsValid(InUnit))
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FGridSimulation::FindClosestUnit] Invalid unit handle %d."), InUnit);
+		return INDEX_NONE;
+	}
+
+	const ETeam Team = Units.GetTeam(InUnit);
+	const FIntPoint Cell = Units.GetCell(InUnit);
+
+	int32 ClosestDist = -1;
+	FUnitHandle ClosestTarget = INDEX_NONE;
+	for (int32 TeamIndex = 0; TeamIndex < StaticCast<int32>(ETeam::MAX); ++TeamIndex)
+	{
+		if (StaticCast<ETeam>(TeamIndex) == Team)
+		{
+			continue;
+		}
+
+		const FTeamUnits& Opponents = Units.GetTeamUnits(StaticCast<ETeam>(TeamIndex));
+		for (int32 Index = 0; Index < Opponents.Num(); ++Index)
+		{
+			// The walled off opponents can't be reached, no matter how close they are
+			if (Opponents.Health[Index] <= 0.f || !Grid.AreConnected(Cell, Opponents.Cells[Index]))
+			{
+				continue;
+			}
+
+			const int32 DistSqr = FIntPoint(Cell - Opponents.Cells[Index]).SizeSquared();
+			if ((ClosestDist < 0) || (DistSqr < ClosestDist))
+			{
+				ClosestDist = DistSqr;
+				ClosestTarget = Opponents.Handles[Index];
+
+				// Nothing can be closer than a neighbor
+				if (DistSqr <= 1)
+				{
+					OutDistanceSqr = ClosestDist;
+					return ClosestTarget;
+				}
+			}
+		}
+	}
+
+	if (ClosestTarget != INDEX_NONE)
+	{
+		OutDistanceSqr = ClosestDist;
+	}
+	return ClosestTarget;
+}
+
+FUnitHandle FGridSimulation::FindTarget(FUnitHandle InUnit, int32& OutDistanceSqr)
+{
+	const FIntPoint Cell = Units.GetCell(InUnit);
+	auto DistanceToTarget = [this, &Cell](FUnitHandle InTarget)
+	{
+		return (Units.IsValid(InTarget) && Units.GetHealth(InTarget) > 0.f
+			       && Grid.AreConnected(Cell, Units.GetCell(InTarget)))
+			       ? FIntPoint(Cell - Units.GetCell(InTarget)).SizeSquared()
+			       : -1;
+	};
+
+	const FUnitHandle CachedTarget = TargetCache.Find(InUnit, DistanceToTarget, TargetHysteresisCells);
+	if (CachedTarget != INDEX_NONE)
+	{
+		OutDistanceSqr = DistanceToTarget(CachedTarget);
+		return CachedTarget;
+	}
+
+	const FUnitHandle ClosestTarget = FindClosestUnit(InUnit, OutDistanceSqr);
+	if (ClosestTarget != INDEX_NONE)
+	{
+		TargetCache.Store(InUnit, ClosestTarget, OutDistanceSqr);
+	}
+	return ClosestTarget;
+}
+
+int32 FGridSimulation::GetStep() const
+{
+	return SimulationStep;
+}
+
+void FGridSimulation::SetStep(int32 InStep)
+{
+	InvalidateDecisions();
+	SimulationStep = InStep;
+}
+
+const FGrid& FGridSimulation::GetGrid() const
+{
+	return Grid;
+}
+
+FGrid& FGridSimulation::GetGrid()
+{
+	return Grid;
+}
+
+FGridSnapshotRef FGridSimulation::GetGridSnapshot()
+{
+	// Out of date only after the obstacle changes, which are not made while the decisions run
+	Grid.UpdateComponents();
+
+	// The steps nobody reads the snapshots of don't pay for the copies
+	if (!GridSnapshot.IsValid() || GridSnapshot->GetEpoch() != Grid.GetEpoch())
+	{
+		GridSnapshot = FGridSnapshot::Create(Grid, GridSnapshot.Get());
+	}
+	return GridSnapshot.ToSharedRef();
+}
+
+const FUnitRegistry& FGridSimulation::GetUnits() const
+{
+	return Units;
+}
+
+const FInfluenceMap& FGridSimulation::GetInfluence() const
+{
+	return Influence;
+}
+
+const FTeamPresenceTables& FGridSimulation::GetPresence() const
+{
+	return Presence;
+}
+
+GS_Pathfinder& FGridSimulation::GetPathfinder()
+{
+	return *Pathfinder;
+}
+
+void FGridSimulation::VisualizeSquadPaths(UGS_GridDebugOverlayComponent* InOverlay)
+{
+	WaitForDecisions();
+	Squads.VisualizePaths(*Pathfinder, InOverlay);
+}
+
+const FSimStepEvents& FGridSimulation::GetStepEvents() const
+{
+	return StepEvents;
+}
+
+const TArray<FUnitHandle>& FGridSimulation::GetDamagedUnits() const
+{
+	return DamagedUnits;
+}
+
+const FSimStepCounters& FGridSimulation::GetStepCounters() const
+{
+	return StepCounters;
+}
+
+void FGridSimulation::DecideIntents(bool bInParallel)
+{
+	// The squads plan their paths here, so the searches are counted by the step the intents are chosen for
+	Pathfinder->ResetCounters();
+
+	TargetCache.OnStepStarted();
+	TargetCache.Reserve(Units.NumHandles());
+	StepIntents.SetNum(Units.NumHandles(), false);
+
+	DecisionUnits.Reset();
+	Units.ForEachUnit([this](FUnitHandle Unit)
+	{
+		DecisionUnits.Add(Unit);
+	});
+	Utility.Reset(DecisionUnits.Num());
+
+	{
+		GRIDSIM_SCOPE(PresenceTables);
+		Presence.Update(Units, Grid);
+	}
+
+	{
+		GRIDSIM_SCOPE(TargetSearch);
+
+		const TArrayView<float> TargetDistances = Utility.GetInputs(EUtilityInput::TargetDistance);
+		const TArrayView<float> RelativeHealths = Utility.GetInputs(EUtilityInput::RelativeHealth);
+		const TArrayView<float> Threats = Utility.GetInputs(EUtilityInput::Threat);
+		const TArrayView<float> OpponentsInRange = Utility.GetInputs(EUtilityInput::OpponentsInRange);
+		ParallelFor(DecisionUnits.Num(), [&](int32 Index)
+		{
+			const FUnitHandle Unit = DecisionUnits[Index];
+			int32 DistanceSqr = 0;
+			const FUnitHandle Target = FindTarget(Unit, DistanceSqr);
+			StepIntents[Unit].Target = Target;
+
+			const ETeam Team = Units.GetTeam(Unit);
+			const FIntPoint Cell = Units.GetCell(Unit);
+			const float Health = Units.GetHealth(Unit);
+			const float TargetHealth = Units.GetHealth(Target);
+			const float Threat = Influence.GetThreat(Team, Cell);
+			const float Support = Influence.GetSupport(Team, Cell);
+
+			// The units without a target guard anyway, their distance only has to be far out of range
+			const int32 Range = FMath::Max(1, Units.GetAttackRange(Unit));
+			TargetDistances[Index] = Target != INDEX_NONE ? FMath::Sqrt(StaticCast<float>(DistanceSqr)) / Range : 1000.f;
+			RelativeHealths[Index] = Health / FMath::Max(Health + TargetHealth, SMALL_NUMBER);
+			Threats[Index] = Threat / FMath::Max(Threat + Support, SMALL_NUMBER);
+			OpponentsInRange[Index] = StaticCast<float>(
+				Presence.CountOpponents(Team, Cell - FIntPoint(Range), Cell + FIntPoint(Range)));
+		}, bInParallel ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+	}
+
+	{
+		GRIDSIM_SCOPE(UtilityEvaluation);
+
+		DecisionActions.SetNumUninitialized(DecisionUnits.Num(), false);
+		Utility.Evaluate(DecisionActions);
+		for (int32 Index = 0; Index < DecisionUnits.Num(); ++Index)
+		{
+			FUnitIntent& Intent = StepIntents[DecisionUnits[Index]];
+			Intent.Action = Intent.Target != INDEX_NONE ? DecisionActions[Index] : EUnitAction::Guard;
+		}
+	}
+
+	{
+		GRIDSIM_SCOPE(SquadPlanning);
+		if (CVarSquadPathfinding.GetValueOnAnyThread())
+		{
+			Squads.Plan(Units, DecisionUnits, StepIntents, *Pathfinder);
+		}
+		else
+		{
+			Squads.Reset();
+		}
+	}
+
+	DecidedStep = SimulationStep;
+}
+
+void FGridSimulation::WaitForDecisions()
+{
+	if (DecisionsTask.IsValid())
+	{
+		DecisionsTask.Wait();
+		DecisionsTask = UE::Tasks::FTask();
+	}
+}
+
+void FGridSimulation::InvalidateDecisions()
+{
+	WaitForDecisions();
+	DecidedStep = INDEX_NONE;
+}
+
+void FGridSimulation::Attack(FUnitHandle InUnit, FUnitHandle InTarget)
+{
+	GRIDSIM_LOG(Verbose, TEXT("[FGridSimulation::Attack] Target: %d, Instigator %d."), InTarget, InUnit);
+
+	// The damage is applied for all the attacks at once by ResolveCombat
+	Units.QueueDamage(InTarget, InUnit);
+	StepEvents.Attacks.Add({InUnit, InTarget});
+}
+
+void FGridSimulation::Engage(FUnitHandle InUnit, FUnitHandle InTarget)
+{
+	const int32 DistanceSqr = FIntPoint(Units.GetCell(InUnit) - Units.GetCell(InTarget)).SizeSquared();
+	if (DistanceSqr <= FMath::Square(Units.GetAttackRange(InUnit)))
+	{
+		Attack(InUnit, InTarget);
+	}
+	else
+	{
+		MoveTowards(InUnit, InTarget);
+	}
+}
+
+void FGridSimulation::FocusFire(FUnitHandle InUnit, FUnitHandle InTarget)
+{
+	const ETeam Team = Units.GetTeam(InUnit);
+	const FIntPoint Cell = Units.GetCell(InUnit);
+	const int32 Range = Units.GetAttackRange(InUnit);
+
+	// The attack ranges are a few cells, so looking at the cells in range is cheaper than at the opponents
+	FUnitHandle WeakestTarget = INDEX_NONE;
+	float WeakestHealth = 0.f;
+	for (int32 OffsetY = -Range; OffsetY <= Range; ++OffsetY)
+	{
+		for (int32 OffsetX = -Range; OffsetX <= Range; ++OffsetX)
+		{
+			const FIntPoint Offset(OffsetX, OffsetY);
+			if (Offset.SizeSquared() > Range * Range || !Grid.IsPointOnGrid(Cell + Offset))
+			{
+				continue;
+			}
+
+			const FUnitHandle Opponent = Grid.At(Cell + Offset).Unit;
+			if (Opponent == INDEX_NONE || Units.GetTeam(Opponent) == Team)
+			{
+				continue;
+			}
+
+			const float Health = Units.GetHealth(Opponent);
+			if (WeakestTarget == INDEX_NONE || Health < WeakestHealth)
+			{
+				WeakestTarget = Opponent;
+				WeakestHealth = Health;
+			}
+		}
+	}
+
+	if (WeakestTarget != INDEX_NONE)
+	{
+		Attack(InUnit, WeakestTarget);
+	}
+	else
+	{
+		Engage(InUnit, InTarget);
+	}
+}
+
+void FGridSimulation::Retreat(FUnitHandle InUnit)
+{
+	const ETeam Team = Units.GetTeam(InUnit);
+	const FIntPoint UnitCell = Units.GetCell(InUnit);
+
+	bool bFound = false;
+	FIntPoint NextMove = UnitCell;
+	float LeastThreat = Influence.GetThreat(Team, UnitCell);
+	Grid.ForEachNeighbor(UnitCell, [&](const FGridPoint& Point)
+	{
+		const float Threat = Influence.GetThreat(Team, Point.GridCoords);
+		if (Point.IsFree() && Threat < LeastThreat)
+		{
+			LeastThreat = Threat;
+			NextMove = Point.GridCoords;
+			bFound = true;
+		}
+	});
+
+	if (!bFound)
+	{
+		StepEvents.Halts.Add(InUnit);
+		return;
+	}
+
+	MoveTo(InUnit, NextMove);
+}
+
+void FGridSimulation::ResolveCombat()
+{
+	GRIDSIM_SCOPE(CombatResolution);
+
+	Units.ResolveDamage(DamagedUnits, StepKills);
+
+	for (const FUnitKill& Kill : StepKills)
+	{
+		GRIDSIM_LOG(Verbose, TEXT("[FGridSimulation::ResolveCombat] %d is killed by %d."),
+		       Kill.Target, Kill.Instigator);
+
+		const FIntPoint Cell = Units.GetCell(Kill.Target);
+		Grid.SetUnit(Cell, INDEX_NONE);
+		Influence.RemoveUnit(Units.GetTeam(Kill.Target), Cell, Units.GetAttackPower(Kill.Target));
+		// The own entry of the killed unit, the ones targeting it are dropped by their next lookup
+		TargetCache.Invalidate(Kill.Target);
+		StepEvents.Deaths.Add({Kill.Target, Kill.Instigator});
+	}
+}
+
+bool FGridSimulation::GetNextMoveLocation(FUnitHandle InUnit, const FIntPoint& InGoal, FIntPoint& OutLocation) const
+{
+	const FIntPoint UnitCell = Units.GetCell(InUnit);
+
+	bool bFound = false;
+	int32 LeastDistance = FIntPoint(InGoal - UnitCell).SizeSquared();
+	Grid.ForEachNeighbor(UnitCell, [&](const FGridPoint& Point)
+	{
+		const int32 Distance = FIntPoint(Point.GridCoords - InGoal).SizeSquared();
+		if (Point.IsFree() && Distance < LeastDistance)
+		{
+			LeastDistance = Distance;
+			OutLocation = Point.GridCoords;
+			bFound = true;
+		}
+	});
+	return bFound;
+}
+
+void FGridSimulation::MoveTowards(FUnitHandle InUnit, FUnitHandle InTarget)
+{
+	GRIDSIM_LOG(Verbose, TEXT("[FGridSimulation::MoveTowards] Target: %d, Unit %d."), InTarget, InUnit);
+
+	// The squad members head along the path of the squad, the rest straight to the target
+	FIntPoint Goal = Units.GetCell(InTarget);
+	Squads.GetWaypoint(InUnit, Units.GetCell(InUnit), Grid, Goal);
+
+	FIntPoint NextMove = FIntPoint::ZeroValue;
+	if (!GetNextMoveLocation(InUnit, Goal, NextMove))
+	{
+		GRIDSIM_LOG(Verbose, TEXT("[FGridSimulation::MoveTowards] Unit %d failed to find a point closer."), InUnit);
+		return;
+	}
+
+	MoveTo(InUnit, NextMove);
+}
+
+void FGridSimulation::MoveTo(FUnitHandle InUnit, const FIntPoint& InCell)
+{
+	// Clear the current point on the grid, then move the unit to the new one
+	const FIntPoint CurrentCell = Units.GetCell(InUnit);
+	Grid.SetUnit(CurrentCell, INDEX_NONE);
+	Influence.MoveUnit(Units.GetTeam(InUnit), CurrentCell, InCell, Units.GetAttackPower(InUnit));
+	Units.SetCell(InUnit, InCell);
+	Grid.SetUnit(InCell, InUnit);
+	StepEvents.Moves.Add({InUnit, Grid.At(InCell).Index});
+}
@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/InfluenceMap.h"
+
+#include "GridAISim/GridAISim.h"
+#include "Simulation/SimStats.h"
+
+void FInfluenceMap::Init(int32 InSizeX, int32 InSizeY)
+{
+	SizeX = FMath::Max(0, InSizeX);
+	SizeY = FMath::Max(0, InSizeY);
+
+	// The falloff is separable: the weight of an offset is the product of the weights of its X and Y parts
+	float Falloff[KernelSize];
+	for (int32 Offset = -Radius; Offset <= Radius; ++Offset)
+	{
+		Falloff[Offset + Radius] = StaticCast<float>(Radius + 1 - FMath::Abs(Offset)) / (Radius + 1);
+	}
+	for (int32 Y = 0; Y < KernelSize; ++Y)
+	{
+		for (int32 X = 0; X < KernelSize; ++X)
+		{
+			Kernel[Y * KernelSize + X] = FMath::RoundToInt(Falloff[X] * Falloff[Y] * KernelScale);
+		}
+	}
+
+	for (TArray<int32>& Influence : TeamInfluence)
+	{
+		Influence.Empty();
+	}
+}
+
+void FInfluenceMap::Reset()
+{
+	for (TArray<int32>& Influence : TeamInfluence)
+	{
+		FMemory::Memzero(Influence.GetData(), Influence.Num() * Influence.GetTypeSize());
+	}
+}
+
+void FInfluenceMap::AddUnit(ETeam InTeam, const FIntPoint& InCell, float InStrength)
+{
+	ApplyKernel(InTeam, InCell, QuantizeStrength(InStrength));
+}
+
+void FInfluenceMap::RemoveUnit(ETeam InTeam, const FIntPoint& InCell, float InStrength)
+{
+	ApplyKernel(InTeam, InCell, -QuantizeStrength(InStrength));
+}
+
+void FInfluenceMap::MoveUnit(ETeam InTeam, const FIntPoint& InFromCell, const FIntPoint& InToCell, float InStrength)
+{
+	const int32 Strength = QuantizeStrength(InStrength);
+	ApplyKernel(InTeam, InFromCell, -Strength);
+	ApplyKernel(InTeam, InToCell, Strength);
+}
+
+float FInfluenceMap::GetSupport(ETeam InTeam, const FIntPoint& InCell) const
+{
+	const int32 CellIndex = GetCellIndex(InCell);
+	if (CellIndex == INDEX_NONE || InTeam >= ETeam::MAX)
+	{
+		return 0.f;
+	}
+
+	const TArray<int32>& Influence = TeamInfluence[StaticCast<int32>(InTeam)];
+	return Influence.Num() > 0 ? StaticCast<float>(Influence[CellIndex]) / (KernelScale * StrengthScale) : 0.f;
+}
+
+float FInfluenceMap::GetThreat(ETeam InTeam, const FIntPoint& InCell) const
+{
+	const int32 CellIndex = GetCellIndex(InCell);
+	if (CellIndex == INDEX_NONE)
+	{
+		return 0.f;
+	}
+
+	int32 Threat = 0;
+	for (int32 TeamIndex = 0; TeamIndex < TeamInfluence.Num(); ++TeamIndex)
+	{
+		const TArray<int32>& Influence = TeamInfluence[TeamIndex];
+		if (StaticCast<ETeam>(TeamIndex) != InTeam && Influence.Num() > 0)
+		{
+			Threat += Influence[CellIndex];
+		}
+	}
+	return StaticCast<float>(Threat) / (KernelScale * StrengthScale);
+}
+
+void FInfluenceMap::ApplyKernel(ETeam InTeam, const FIntPoint& InCell, int32 InStrength)
+{
+	if (InTeam >= ETeam::MAX || GetCellIndex(InCell) == INDEX_NONE)
+	{
+		return;
+	}
+
+	TArray<int32>& Influence = TeamInfluence[StaticCast<int32>(InTeam)];
+	if (Influence.Num() == 0)
+	{
+		LLM_SCOPE_BYTAG(GridSim_Units);
+		Influence.SetNumZeroed(SizeX * SizeY);
+	}
+
+	// The kernel is clipped by the grid borders
+	const int32 MinX = FMath::Max(InCell.X - Radius, 0);
+	const int32 MaxX = FMath::Min(InCell.X + Radius, SizeX - 1);
+	const int32 MinY = FMath::Max(InCell.Y - Radius, 0);
+	const int32 MaxY = FMath::Min(InCell.Y + Radius, SizeY - 1);
+	const int32 RowLength = MaxX - MinX + 1;
+
+	const VectorRegister4Int StrengthVec = VectorIntSet1(InStrength);
+	for (int32 Y = MinY; Y <= MaxY; ++Y)
+	{
+		int32* RESTRICT Row = Influence.GetData() + Y * SizeX + MinX;
+		const int32* RESTRICT KernelRow = Kernel + (Y - InCell.Y + Radius) * KernelSize + (MinX - InCell.X + Radius);
+
+		// Four cells per iteration
+		int32 Index = 0;
+		for (; Index + 4 <= RowLength; Index += 4)
+		{
+			const VectorRegister4Int Weights = VectorIntMultiply(VectorIntLoad(KernelRow + Index), StrengthVec);
+			VectorIntStore(VectorIntAdd(VectorIntLoad(Row + Index), Weights), Row + Index);
+		}
+
+		// The tail
+		for (; Index < RowLength; ++Index)
+		{
+			Row[Index] += KernelRow[Index] * InStrength;
+		}
+	}
+}
+
+int32 FInfluenceMap::QuantizeStrength(float InStrength)
+{
+	return FMath::Max(0, FMath::RoundToInt(InStrength * StrengthScale));
+}
+
+int32 FInfluenceMap::GetCellIndex(const FIntPoint& InCell) const
+{
+	if (InCell.X < 0 || InCell.Y < 0 || InCell.X >= SizeX || InCell.Y >= SizeY)
+	{
+		return INDEX_NONE;
+	}
+	return InCell.Y * SizeX + InCell.X;
+}
@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/PresenceTables.h"
+
+#include "Grid/Grid.h"
+#include "Simulation/SimStats.h"
+#include "Simulation/UnitRegistry.h"
+
+void FTeamPresenceTables::Init(int32 InSizeX, int32 InSizeY)
+{
+	SizeX = FMath::Max(0, InSizeX);
+	SizeY = FMath::Max(0, InSizeY);
+	Stride = SizeX + 1;
+	GridEpoch = 0;
+
+	for (TArray<int32>& Table : Tables)
+	{
+		Table.Empty();
+	}
+}
+
+void FTeamPresenceTables::Rebuild(const FUnitRegistry& InUnits)
+{
+	GridEpoch = 0;
+	RebuildRows(InUnits, 0);
+}
+
+void FTeamPresenceTables::Update(const FUnitRegistry& InUnits, const FGrid& InGrid)
+{
+	int32 FirstRow = 0;
+	TConstArrayView<FGridChange> Changes;
+	if (GridEpoch != 0 && InGrid.GetChangesSince(GridEpoch, Changes))
+	{
+		FirstRow = SizeY;
+		for (const FGridChange& Change : Changes)
+		{
+			if (Change.Type == FGridChange::EType::Occupancy)
+			{
+				FirstRow = FMath::Min(FirstRow, Change.Point.Y);
+			}
+		}
+	}
+
+	if (FirstRow < SizeY)
+	{
+		RebuildRows(InUnits, FirstRow);
+	}
+	GridEpoch = InGrid.GetEpoch();
+}
+
+void FTeamPresenceTables::RebuildRows(const FUnitRegistry& InUnits, int32 InFirstRow)
+{
+	LLM_SCOPE_BYTAG(GridSim_Units);
+
+	for (int32 TeamIndex = 0; TeamIndex < Tables.Num(); ++TeamIndex)
+	{
+		TArray<int32>& Table = Tables[TeamIndex];
+		const FTeamUnits& TeamUnits = InUnits.GetTeamUnits(StaticCast<ETeam>(TeamIndex));
+		if (TeamUnits.Num() == 0)
+		{
+			// An empty table counts zero everywhere
+			Table.Reset();
+			continue;
+		}
+
+		// A table of a team which had no units is built from scratch
+		const int32 FirstRow = Table.Num() > 0 ? FMath::Clamp(InFirstRow, 0, SizeY) : 0;
+		Table.SetNumUninitialized(Stride * (SizeY + 1), false);
+		int32* RESTRICT TableData = Table.GetData();
+
+		// The rows of the table are shifted by one, the leading one is always zero
+		const int32 FirstTableRow = FirstRow == 0 ? 0 : FirstRow + 1;
+		FMemory::Memzero(TableData + FirstTableRow * Stride, (Table.Num() - FirstTableRow * Stride) * sizeof(int32));
+
+		for (const FIntPoint& Cell : TeamUnits.Cells)
+		{
+			if (Cell.X < 0 || Cell.Y < FirstRow || Cell.X >= SizeX || Cell.Y >= SizeY)
+			{
+				continue;
+			}
+			++TableData[(Cell.Y + 1) * Stride + Cell.X + 1];
+		}
+
+		for (int32 Y = FirstRow + 1; Y <= SizeY; ++Y)
+		{
+			int32* RESTRICT Row = TableData + Y * Stride;
+			const int32* RESTRICT PreviousRow = Row - Stride;
+
+			// The prefix sums along the row are sequential
+			for (int32 X = 1; X <= SizeX; ++X)
+			{
+				Row[X] += Row[X - 1];
+			}
+
+			// Adding the row above is independent per column, four columns per iteration
+			int32 X = 0;
+			for (; X + 4 <= Stride; X += 4)
+			{
+				VectorIntStore(VectorIntAdd(VectorIntLoad(Row + X), VectorIntLoad(PreviousRow + X)), Row + X);
+			}
+			for (; X < Stride; ++X)
+			{
+				Row[X] += PreviousRow[X];
+			}
+		}
+	}
+}
+
+int32 FTeamPresenceTables::CountUnits(ETeam InTeam, const FIntPoint& InMin, const FIntPoint& InMax) const
+{
+	if (InTeam >= ETeam::MAX)
+	{
+		return 0;
+	}
+
+	const TArray<int32>& Table = Tables[StaticCast<int32>(InTeam)];
+	const int32 MinX = FMath::Max(InMin.X, 0);
+	const int32 MinY = FMath::Max(InMin.Y, 0);
+	const int32 MaxX = FMath::Min(InMax.X, SizeX - 1);
+	const int32 MaxY = FMath::Min(InMax.Y, SizeY - 1);
+	if (Table.Num() == 0 || MinX > MaxX || MinY > MaxY)
+	{
+		return 0;
+	}
+
+	// The table is shifted by one row and one column, so the entry (X + 1, Y + 1) covers the cells up to (X, Y)
+	return Table[(MaxY + 1) * Stride + MaxX + 1] - Table[MinY * Stride + MaxX + 1]
+		- Table[(MaxY + 1) * Stride + MinX] + Table[MinY * Stride + MinX];
+}
+
+int32 FTeamPresenceTables::CountOpponents(ETeam InTeam, const FIntPoint& InMin, const FIntPoint& InMax) const
+{
+	int32 Count = 0;
+	for (int32 TeamIndex = 0; TeamIndex < Tables.Num(); ++TeamIndex)
+	{
+		if (StaticCast<ETeam>(TeamIndex) != InTeam)
+		{
+			Count += CountUnits(StaticCast<ETeam>(TeamIndex), InMin, InMax);
+		}
+	}
+	return Count;
+}
@@ -0,0 +1,393 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/SimCheckpoints.h"
+
+#include "Algo/BinarySearch.h"
+#include "Grid/Grid.h"
+#include "GridAISim/GridAISim.h"
+#include "Simulation/SimSerialization.h"
+
+using namespace SimSerialization;
+
+namespace
+{
+	// Delta record flags
+	constexpr uint8 DeltaNewUnit = 1 << 0;
+	constexpr uint8 DeltaCell = 1 << 1;
+	constexpr uint8 DeltaHealth = 1 << 2;
+
+	void WriteUnit(TArray<uint8>& OutData, const FUnitSnapshot& InUnit)
+	{
+		WriteByte(OutData, StaticCast<uint8>(InUnit.Team));
+		WriteVarUInt(OutData, InUnit.CellIndex);
+		WriteFloat(OutData, InUnit.Health);
+		WriteFloat(OutData, InUnit.AttackPower);
+		WriteVarUInt(OutData, InUnit.AttackRange);
+	}
+
+	void ReadUnit(FByteReader& Reader, FUnitSnapshot& OutUnit)
+	{
+		OutUnit.Team = StaticCast<ETeam>(Reader.ReadByte());
+		OutUnit.CellIndex = Reader.ReadVarUInt();
+		OutUnit.Health = Reader.ReadFloat();
+		OutUnit.AttackPower = Reader.ReadFloat();
+		OutUnit.AttackRange = Reader.ReadVarUInt();
+	}
+}
+
+const FUnitSnapshot* FSimSnapshot::FindUnit(FUnitHandle InHandle) const
+{
+	const int32 Index = Algo::LowerBoundBy(Units, InHandle, &FUnitSnapshot::Handle);
+	return (Units.IsValidIndex(Index) && Units[Index].Handle == InHandle) ? &Units[Index] : nullptr;
+}
+
+void GS_SimCheckpoints::Configure(int32 InKeyframeInterval, int64 InMemoryCapBytes)
+{
+	KeyframeInterval = FMath::Max(1, InKeyframeInterval);
+	MemoryCapBytes = FMath::Max<int64>(0, InMemoryCapBytes);
+	EvictToMemoryCap();
+}
+
+void GS_SimCheckpoints::Reset()
+{
+	Checkpoints.Empty();
+	LatestSnapshot = FSimSnapshot();
+	MemoryUsage = 0;
+	StepsSinceKeyframe = 0;
+}
+
+void GS_SimCheckpoints::Capture(int32 InStep, const FUnitRegistry& InUnits, const FGrid& InGrid)
+{
+	if (Checkpoints.Num() > 0 && InStep <= Checkpoints.Last().Step)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[GS_SimCheckpoints::Capture] Step %d is already captured."), InStep);
+		return;
+	}
+
+	FSimSnapshot Snapshot;
+	Snapshot.Step = InStep;
+	Snapshot.Units.Reserve(InUnits.Num());
+	for (int32 TeamIndex = 0; TeamIndex < StaticCast<int32>(ETeam::MAX); ++TeamIndex)
+	{
+		const FTeamUnits& TeamUnits = InUnits.GetTeamUnits(StaticCast<ETeam>(TeamIndex));
+		for (int32 Index = 0; Index < TeamUnits.Num(); ++Index)
+		{
+			FUnitSnapshot& Unit = Snapshot.Units.AddDefaulted_GetRef();
+			Unit.Handle = TeamUnits.Handles[Index];
+			Unit.Team = StaticCast<ETeam>(TeamIndex);
+			Unit.CellIndex = InGrid.At(TeamUnits.Cells[Index]).Index;
+			Unit.Health = TeamUnits.Health[Index];
+			Unit.AttackPower = TeamUnits.AttackPower[Index];
+			Unit.AttackRange = TeamUnits.AttackRange[Index];
+		}
+	}
+	Snapshot.Units.Sort([](const FUnitSnapshot& Left, const FUnitSnapshot& Right)
+	{
+		return Left.Handle < Right.Handle;
+	});
+
+	FCheckpoint Checkpoint;
+	Checkpoint.Step = InStep;
+	// A delta needs the previous step as the base, so any gap in steps starts a new keyframe
+	Checkpoint.bIsKeyframe = Checkpoints.Num() == 0
+		|| StepsSinceKeyframe + 1 >= KeyframeInterval
+		|| LatestSnapshot.Step != InStep - 1;
+
+	if (Checkpoint.bIsKeyframe)
+	{
+		EncodeKeyframe(Snapshot, Checkpoint.Data);
+		StepsSinceKeyframe = 0;
+	}
+	else
+	{
+		EncodeDelta(LatestSnapshot, Snapshot, Checkpoint.Data);
+		++StepsSinceKeyframe;
+	}
+	Checkpoint.Data.Shrink();
+
+	MemoryUsage += Checkpoint.Data.GetAllocatedSize();
+	Checkpoints.Add(MoveTemp(Checkpoint));
+	LatestSnapshot = MoveTemp(Snapshot);
+
+	EvictToMemoryCap();
+}
+
+bool GS_SimCheckpoints::Reconstruct(int32 InStep, FSimSnapshot& OutSnapshot) const
+{
+	if (Checkpoints.Num() == 0 || InStep < Checkpoints.First().Step || InStep > Checkpoints.Last().Step)
+	{
+		return false;
+	}
+
+	if (InStep == LatestSnapshot.Step)
+	{
+		OutSnapshot = LatestSnapshot;
+		return true;
+	}
+
+	// Find the latest keyframe at, or before the step
+	int32 KeyframeIndex = INDEX_NONE;
+	for (int32 Index = Checkpoints.Num() - 1; Index >= 0; --Index)
+	{
+		if (Checkpoints[Index].Step <= InStep && Checkpoints[Index].bIsKeyframe)
+		{
+			KeyframeIndex = Index;
+			break;
+		}
+	}
+
+	if (KeyframeIndex == INDEX_NONE || !DecodeKeyframe(Checkpoints[KeyframeIndex].Data, OutSnapshot))
+	{
+		return false;
+	}
+	OutSnapshot.Step = Checkpoints[KeyframeIndex].Step;
+
+	for (int32 Index = KeyframeIndex + 1; Index < Checkpoints.Num() && Checkpoints[Index].Step <= InStep; ++Index)
+	{
+		if (!DecodeDelta(Checkpoints[Index].Data, OutSnapshot))
+		{
+			UE_LOG(LogSim, Error, TEXT("[GS_SimCheckpoints::Reconstruct] Corrupted delta of step %d."),
+			       Checkpoints[Index].Step);
+			return false;
+		}
+		OutSnapshot.Step = Checkpoints[Index].Step;
+	}
+
+	return OutSnapshot.Step == InStep;
+}
+
+void GS_SimCheckpoints::TruncateAfter(int32 InStep)
+{
+	while (Checkpoints.Num() > 0 && Checkpoints.Last().Step > InStep)
+	{
+		MemoryUsage -= Checkpoints.Last().Data.GetAllocatedSize();
+		Checkpoints.PopBack();
+	}
+
+	// Rebuild the base for the next delta, the next capture starts a keyframe if it's not possible
+	if (!Reconstruct(InStep, LatestSnapshot))
+	{
+		LatestSnapshot = FSimSnapshot();
+	}
+
+	StepsSinceKeyframe = 0;
+	for (int32 Index = Checkpoints.Num() - 1; Index >= 0 && !Checkpoints[Index].bIsKeyframe; --Index)
+	{
+		++StepsSinceKeyframe;
+	}
+}
+
+int32 GS_SimCheckpoints::GetOldestStep() const
+{
+	return Checkpoints.Num() > 0 ? Checkpoints.First().Step : INDEX_NONE;
+}
+
+int32 GS_SimCheckpoints::GetLatestStep() const
+{
+	return Checkpoints.Num() > 0 ? Checkpoints.Last().Step : INDEX_NONE;
+}
+
+int64 GS_SimCheckpoints::GetMemoryUsage() const
+{
+	return MemoryUsage;
+}
+
+void GS_SimCheckpoints::EncodeKeyframe(const FSimSnapshot& InSnapshot, TArray<uint8>& OutData)
+{
+	WriteVarUInt(OutData, InSnapshot.Units.Num());
+
+	// Handles are sorted, so the differences are written instead of the handles themselves
+	FUnitHandle PreviousHandle = 0;
+	for (const FUnitSnapshot& Unit : InSnapshot.Units)
+	{
+		WriteVarUInt(OutData, Unit.Handle - PreviousHandle);
+		PreviousHandle = Unit.Handle;
+		WriteUnit(OutData, Unit);
+	}
+}
+
+void GS_SimCheckpoints::EncodeDelta(const FSimSnapshot& InPrevious, const FSimSnapshot& InCurrent,
+                                     TArray<uint8>& OutData)
+{
+	// Both arrays are sorted by handles, walk them together
+	TArray<FUnitHandle, TInlineAllocator<64>> Removed;
+	int32 PreviousIndex = 0;
+	for (const FUnitSnapshot& Unit : InCurrent.Units)
+	{
+		while (PreviousIndex < InPrevious.Units.Num() && InPrevious.Units[PreviousIndex].Handle < Unit.Handle)
+		{
+			Removed.Add(InPrevious.Units[PreviousIndex++].Handle);
+		}
+		if (PreviousIndex < InPrevious.Units.Num() && InPrevious.Units[PreviousIndex].Handle == Unit.Handle)
+		{
+			++PreviousIndex;
+		}
+	}
+	while (PreviousIndex < InPrevious.Units.Num())
+	{
+		Removed.Add(InPrevious.Units[PreviousIndex++].Handle);
+	}
+
+	WriteVarUInt(OutData, Removed.Num());
+	FUnitHandle PreviousHandle = 0;
+	for (const FUnitHandle Handle : Removed)
+	{
+		WriteVarUInt(OutData, Handle - PreviousHandle);
+		PreviousHandle = Handle;
+	}
+
+	// The changed units are counted while writing them, so they go to a separate buffer first
+	int32 NumChanged = 0;
+	TArray<uint8> Changes;
+	PreviousHandle = 0;
+	for (const FUnitSnapshot& Unit : InCurrent.Units)
+	{
+		const FUnitSnapshot* PreviousUnit = InPrevious.FindUnit(Unit.Handle);
+
+		uint8 Flags = 0;
+		if (PreviousUnit == nullptr)
+		{
+			Flags = DeltaNewUnit;
+		}
+		else
+		{
+			Flags |= PreviousUnit->CellIndex != Unit.CellIndex ? DeltaCell : 0;
+			Flags |= PreviousUnit->Health != Unit.Health ? DeltaHealth : 0;
+		}
+
+		if (Flags == 0)
+		{
+			continue;
+		}
+
+		++NumChanged;
+		WriteVarUInt(Changes, Unit.Handle - PreviousHandle);
+		PreviousHandle = Unit.Handle;
+		WriteByte(Changes, Flags);
+
+		if (Flags & DeltaNewUnit)
+		{
+			WriteUnit(Changes, Unit);
+			continue;
+		}
+		if (Flags & DeltaCell)
+		{
+			WriteVarUInt(Changes, Unit.CellIndex);
+		}
+		if (Flags & DeltaHealth)
+		{
+			WriteFloat(Changes, Unit.Health);
+		}
+	}
+
+	WriteVarUInt(OutData, NumChanged);
+	OutData.Append(Changes);
+}
+
+bool GS_SimCheckpoints::DecodeKeyframe(TArrayView<const uint8> InData, FSimSnapshot& OutSnapshot)
+{
+	FByteReader Reader(InData);
+
+	OutSnapshot.Units.Reset();
+	const int32 NumUnits = Reader.ReadVarUInt();
+	OutSnapshot.Units.Reserve(NumUnits);
+
+	FUnitHandle Handle = 0;
+	for (int32 Index = 0; Index < NumUnits && !Reader.HasError(); ++Index)
+	{
+		FUnitSnapshot& Unit = OutSnapshot.Units.AddDefaulted_GetRef();
+		Handle += Reader.ReadVarUInt();
+		Unit.Handle = Handle;
+		ReadUnit(Reader, Unit);
+	}
+
+	return !Reader.HasError();
+}
+
+bool GS_SimCheckpoints::DecodeDelta(TArrayView<const uint8> InData, FSimSnapshot& InOutSnapshot)
+{
+	FByteReader Reader(InData);
+
+	// Removals
+	const int32 NumRemoved = Reader.ReadVarUInt();
+	FUnitHandle Handle = 0;
+	for (int32 Index = 0; Index < NumRemoved && !Reader.HasError(); ++Index)
+	{
+		Handle += Reader.ReadVarUInt();
+		const int32 UnitIndex = Algo::LowerBoundBy(InOutSnapshot.Units, Handle, &FUnitSnapshot::Handle);
+		if (InOutSnapshot.Units.IsValidIndex(UnitIndex) && InOutSnapshot.Units[UnitIndex].Handle == Handle)
+		{
+			InOutSnapshot.Units.RemoveAt(UnitIndex, 1, false);
+		}
+	}
+
+	// Changes and new units
+	const int32 NumChanged = Reader.ReadVarUInt();
+	Handle = 0;
+	for (int32 Index = 0; Index < NumChanged && !Reader.HasError(); ++Index)
+	{
+		Handle += Reader.ReadVarUInt();
+		const uint8 Flags = Reader.ReadByte();
+
+		const int32 UnitIndex = Algo::LowerBoundBy(InOutSnapshot.Units, Handle, &FUnitSnapshot::Handle);
+		const bool bExists = InOutSnapshot.Units.IsValidIndex(UnitIndex) && InOutSnapshot.Units[UnitIndex].Handle == Handle;
+
+		if (Flags & DeltaNewUnit)
+		{
+			FUnitSnapshot Unit;
+			Unit.Handle = Handle;
+			ReadUnit(Reader, Unit);
+			if (bExists)
+			{
+				InOutSnapshot.Units[UnitIndex] = Unit;
+			}
+			else
+			{
+				InOutSnapshot.Units.Insert(Unit, UnitIndex);
+			}
+			continue;
+		}
+
+		if (!bExists)
+		{
+			return false;
+		}
+
+		FUnitSnapshot& Unit = InOutSnapshot.Units[UnitIndex];
+		if (Flags & DeltaCell)
+		{
+			Unit.CellIndex = Reader.ReadVarUInt();
+		}
+		if (Flags & DeltaHealth)
+		{
+			Unit.Health = Reader.ReadFloat();
+		}
+	}
+
+	return !Reader.HasError();
+}
+
+void GS_SimCheckpoints::EvictToMemoryCap()
+{
+	while (MemoryUsage > MemoryCapBytes && Checkpoints.Num() > 0)
+	{
+		// The deltas are useless without their keyframe, so the whole group goes at once.
+		// The latest group is kept anyway, otherwise nothing could be restored at all.
+		int32 NextKeyframe = 1;
+		while (NextKeyframe < Checkpoints.Num() && !Checkpoints[NextKeyframe].bIsKeyframe)
+		{
+			++NextKeyframe;
+		}
+		if (NextKeyframe >= Checkpoints.Num())
+		{
+			break;
+		}
+
+		for (int32 Index = 0; Index < NextKeyframe; ++Index)
+		{
+			MemoryUsage -= Checkpoints.First().Data.GetAllocatedSize();
+			Checkpoints.PopFront();
+		}
+	}
+}
@@ -0,0 +1,408 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/SimReplay.h"
+
+#include "Containers/Queue.h"
+#include "GridAISim/GridAISim.h"
+#include "HAL/FileManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/FileHelper.h"
+#include "Simulation/SimSerialization.h"
+
+using namespace SimSerialization;
+
+namespace
+{
+	constexpr uint32 ReplayMagic = 0x50525347; // "GSRP"
+	constexpr uint32 ReplayVersion = 1;
+
+	// The handles index the arrays of the actors, so the corrupted ones must not make them huge
+	constexpr uint32 MaxReplayHandle = 1 << 24;
+	constexpr uint32 MaxReplayGridSize = 1 << 14;
+
+	void WriteString(TArray<uint8>& OutBytes, const FString& InString)
+	{
+		const FTCHARToUTF8 Utf8String(*InString);
+		WriteVarUInt(OutBytes, Utf8String.Length());
+		OutBytes.Append(reinterpret_cast<const uint8*>(Utf8String.Get()), Utf8String.Length());
+	}
+
+	FString ReadString(FByteReader& Reader)
+	{
+		const int32 Length = Reader.ReadVarUInt();
+		TArray<UTF8CHAR> Utf8String;
+		Utf8String.Reserve(Length + 1);
+		for (int32 Index = 0; Index < Length && !Reader.HasError(); ++Index)
+		{
+			Utf8String.Add(StaticCast<UTF8CHAR>(Reader.ReadByte()));
+		}
+		Utf8String.Add(UTF8CHAR(0));
+		return FString(UTF8_TO_TCHAR(Utf8String.GetData()));
+	}
+
+	// Handles of the instigators may be INDEX_NONE, so they are shifted by one to stay unsigned
+	void WriteOptionalHandle(TArray<uint8>& OutBytes, FUnitHandle InHandle)
+	{
+		WriteVarUInt(OutBytes, InHandle + 1);
+	}
+
+	FUnitHandle ReadOptionalHandle(FByteReader& Reader)
+	{
+		return StaticCast<FUnitHandle>(Reader.ReadVarUInt()) - 1;
+	}
+}
+
+/**
+ * The background thread writing the encoded steps to the replay file.
+ */
+class FReplayWriter : public FRunnable
+{
+public:
+	explicit FReplayWriter(FArchive* InFileWriter)
+		: FileWriter(InFileWriter)
+	{
+		WorkEvent = FPlatformProcess::GetSynchEventFromPool();
+		Thread = FRunnableThread::Create(this, TEXT("GridSimReplayWriter"), 0, TPri_BelowNormal);
+	}
+
+	virtual ~FReplayWriter() override
+	{
+		bStopRequested = true;
+		WorkEvent->Trigger();
+		if (Thread != nullptr)
+		{
+			Thread->WaitForCompletion();
+			delete Thread;
+		}
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+
+		// Whatever was queued after the thread has stopped
+		WritePending();
+		FileWriter->Close();
+		delete FileWriter;
+	}
+
+	/**
+	 * Should be called from a single producer thread
+	 */
+	void Enqueue(TArray<uint8>&& InBytes)
+	{
+		PendingChunks.Enqueue(MoveTemp(InBytes));
+		WorkEvent->Trigger();
+	}
+
+	/**
+	 * Gives back an empty chunk already written to the file, to reuse its memory. Called by the producer thread.
+	 * @return False, if all the chunks are still pending
+	 */
+	bool DequeueFreeChunk(TArray<uint8>& OutChunk)
+	{
+		return FreeChunks.Dequeue(OutChunk);
+	}
+
+	virtual uint32 Run() override
+	{
+		while (!bStopRequested)
+		{
+			WorkEvent->Wait();
+			WritePending();
+		}
+		return 0;
+	}
+
+private:
+	void WritePending()
+	{
+		TArray<uint8> Chunk;
+		while (PendingChunks.Dequeue(Chunk))
+		{
+			FileWriter->Serialize(Chunk.GetData(), Chunk.Num());
+			Chunk.Reset();
+			FreeChunks.Enqueue(MoveTemp(Chunk));
+		}
+	}
+
+	FArchive* FileWriter = nullptr;
+	FRunnableThread* Thread = nullptr;
+	FEvent* WorkEvent = nullptr;
+	TQueue<TArray<uint8>, EQueueMode::Spsc> PendingChunks;
+	// The written chunks going back to the producer
+	TQueue<TArray<uint8>, EQueueMode::Spsc> FreeChunks;
+	std::atomic<bool> bStopRequested = false;
+};
+
+GS_ReplayRecorder::GS_ReplayRecorder() = default;
+
+GS_ReplayRecorder::~GS_ReplayRecorder()
+{
+	End();
+}
+
+bool GS_ReplayRecorder::Begin(const FString& InFilePath, const FReplayHeader& InHeader)
+{
+	End();
+
+	FArchive* FileWriter = IFileManager::Get().CreateFileWriter(*InFilePath);
+	if (FileWriter == nullptr)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[GS_ReplayRecorder::Begin] Failed to create %s."), *InFilePath);
+		return false;
+	}
+
+	TArray<uint8> HeaderBytes;
+	WriteVarUInt(HeaderBytes, ReplayMagic);
+	WriteVarUInt(HeaderBytes, ReplayVersion);
+	WriteVarUInt(HeaderBytes, InHeader.GridSizeX);
+	WriteVarUInt(HeaderBytes, InHeader.GridSizeY);
+	WriteFloat(HeaderBytes, InHeader.StepDuration);
+
+	WriteVarUInt(HeaderBytes, InHeader.UnitClassPaths.Num());
+	for (const FString& ClassPath : InHeader.UnitClassPaths)
+	{
+		WriteString(HeaderBytes, ClassPath);
+	}
+
+	WriteVarUInt(HeaderBytes, InHeader.Units.Num());
+	for (const FReplayUnit& Unit : InHeader.Units)
+	{
+		WriteVarUInt(HeaderBytes, Unit.Handle);
+		WriteVarUInt(HeaderBytes, Unit.ClassIndex);
+		WriteByte(HeaderBytes, StaticCast<uint8>(Unit.Team));
+		WriteVarUInt(HeaderBytes, Unit.CellIndex);
+		WriteFloat(HeaderBytes, Unit.Health);
+	}
+
+	Writer = MakeUnique<FReplayWriter>(FileWriter);
+	Writer->Enqueue(MoveTemp(HeaderBytes));
+
+	UE_LOG(LogSim, Display, TEXT("[GS_ReplayRecorder::Begin] Recording to %s."), *InFilePath);
+	return true;
+}
+
+void GS_ReplayRecorder::RecordStep(const FSimStepEvents& InEvents)
+{
+	if (!Writer.IsValid())
+	{
+		return;
+	}
+
+	EncodeBuffer.Reset();
+	WriteVarUInt(EncodeBuffer, InEvents.Step);
+
+	WriteVarUInt(EncodeBuffer, InEvents.Moves.Num());
+	for (const FSimMoveEvent& Move : InEvents.Moves)
+	{
+		WriteVarUInt(EncodeBuffer, Move.Unit);
+		WriteVarUInt(EncodeBuffer, Move.CellIndex);
+	}
+
+	WriteVarUInt(EncodeBuffer, InEvents.Attacks.Num());
+	for (const FSimAttackEvent& Attack : InEvents.Attacks)
+	{
+		WriteVarUInt(EncodeBuffer, Attack.Unit);
+		WriteVarUInt(EncodeBuffer, Attack.Target);
+	}
+
+	WriteVarUInt(EncodeBuffer, InEvents.Deaths.Num());
+	for (const FSimDeathEvent& Death : InEvents.Deaths)
+	{
+		WriteVarUInt(EncodeBuffer, Death.Unit);
+		WriteOptionalHandle(EncodeBuffer, Death.Instigator);
+	}
+
+	// The size prefix lets the reader find the step boundaries without decoding the events.
+	// The chunks circulate between the threads, so the steady recording doesn't allocate.
+	TArray<uint8> StepRecord;
+	Writer->DequeueFreeChunk(StepRecord);
+	StepRecord.Reserve(EncodeBuffer.Num() + 5);
+	WriteVarUInt(StepRecord, EncodeBuffer.Num());
+	StepRecord.Append(EncodeBuffer);
+	Writer->Enqueue(MoveTemp(StepRecord));
+}
+
+void GS_ReplayRecorder::End()
+{
+	if (!Writer.IsValid())
+	{
+		return;
+	}
+
+	TArray<uint8> EndMarker;
+	WriteVarUInt(EndMarker, 0);
+	Writer->Enqueue(MoveTemp(EndMarker));
+
+	// Joins the writing thread and closes the file
+	Writer.Reset();
+}
+
+bool GS_ReplayRecorder::IsRecording() const
+{
+	return Writer.IsValid();
+}
+
+bool GS_ReplayPlayer::Open(const FString& InFilePath)
+{
+	Header = FReplayHeader();
+	FileData.Reset();
+	ReadOffset = 0;
+	bIsFinished = true;
+
+	if (!FFileHelper::LoadFileToArray(FileData, *InFilePath))
+	{
+		UE_LOG(LogSim, Warning, TEXT("[GS_ReplayPlayer::Open] Failed to read %s."), *InFilePath);
+		return false;
+	}
+
+	FByteReader Reader(FileData);
+	if (Reader.ReadVarUInt() != ReplayMagic || Reader.ReadVarUInt() != ReplayVersion)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[GS_ReplayPlayer::Open] %s is not a supported replay."), *InFilePath);
+		return false;
+	}
+
+	const uint32 SizeX = Reader.ReadVarUInt();
+	const uint32 SizeY = Reader.ReadVarUInt();
+	if (SizeX == 0 || SizeY == 0 || SizeX > MaxReplayGridSize || SizeY > MaxReplayGridSize)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[GS_ReplayPlayer::Open] %s has an invalid grid size %ux%u."), *InFilePath,
+		       SizeX, SizeY);
+		return false;
+	}
+	Header.GridSizeX = SizeX;
+	Header.GridSizeY = SizeY;
+	Header.StepDuration = Reader.ReadFloat();
+
+	const int32 NumClasses = Reader.ReadVarUInt();
+	for (int32 Index = 0; Index < NumClasses && !Reader.HasError(); ++Index)
+	{
+		Header.UnitClassPaths.Add(ReadString(Reader));
+	}
+
+	const int32 NumUnits = Reader.ReadVarUInt();
+	for (int32 Index = 0; Index < NumUnits && !Reader.HasError(); ++Index)
+	{
+		const uint32 Handle = Reader.ReadVarUInt();
+		const uint32 ClassIndex = Reader.ReadVarUInt();
+		const uint8 Team = Reader.ReadByte();
+		const uint32 CellIndex = Reader.ReadVarUInt();
+		const float Health = Reader.ReadFloat();
+		if (Handle >= MaxReplayHandle || ClassIndex >= StaticCast<uint32>(Header.UnitClassPaths.Num())
+			|| Team >= StaticCast<uint8>(ETeam::MAX) || !IsValidCell(CellIndex))
+		{
+			UE_LOG(LogSim, Warning, TEXT("[GS_ReplayPlayer::Open] %s has an invalid unit %u."), *InFilePath, Handle);
+			return false;
+		}
+
+		FReplayUnit& Unit = Header.Units.AddDefaulted_GetRef();
+		Unit.Handle = Handle;
+		Unit.ClassIndex = ClassIndex;
+		Unit.Team = StaticCast<ETeam>(Team);
+		Unit.CellIndex = CellIndex;
+		Unit.Health = Health;
+	}
+
+	if (Reader.HasError())
+	{
+		UE_LOG(LogSim, Warning, TEXT("[GS_ReplayPlayer::Open] %s has a corrupted header."), *InFilePath);
+		return false;
+	}
+
+	ReadOffset = Reader.GetOffset();
+	bIsFinished = false;
+	return true;
+}
+
+const FReplayHeader& GS_ReplayPlayer::GetHeader() const
+{
+	return Header;
+}
+
+bool GS_ReplayPlayer::ReadNextStep(FSimStepEvents& OutEvents)
+{
+	while (!bIsFinished)
+	{
+		FByteReader SizeReader(TArrayView<const uint8>(FileData).Slice(ReadOffset, FileData.Num() - ReadOffset));
+		const uint32 PayloadSize = SizeReader.ReadVarUInt();
+		if (SizeReader.HasError() || PayloadSize == 0)
+		{
+			// The recording may have been interrupted before the end marker, which is fine
+			bIsFinished = true;
+			return false;
+		}
+
+		const int32 PayloadOffset = ReadOffset + SizeReader.GetOffset();
+		if (PayloadSize > StaticCast<uint32>(FileData.Num() - PayloadOffset))
+		{
+			UE_LOG(LogSim, Warning, TEXT("[GS_ReplayPlayer::ReadNextStep] The step record is truncated."));
+			bIsFinished = true;
+			return false;
+		}
+
+		// The next record starts after the payload, however the payload decodes
+		ReadOffset = PayloadOffset + PayloadSize;
+		if (DecodeStep(TArrayView<const uint8>(FileData).Slice(PayloadOffset, PayloadSize), OutEvents))
+		{
+			return true;
+		}
+		UE_LOG(LogSim, Warning, TEXT("[GS_ReplayPlayer::ReadNextStep] Skipping the corrupted step record."));
+	}
+	return false;
+}
+
+bool GS_ReplayPlayer::IsFinished() const
+{
+	return bIsFinished;
+}
+
+bool GS_ReplayPlayer::DecodeStep(TArrayView<const uint8> InPayload, FSimStepEvents& OutEvents) const
+{
+	// OutEvents is reset rather than reallocated, so the playback reuses a single buffer for all the steps
+	FByteReader Reader(InPayload);
+	OutEvents.Reset(Reader.ReadVarUInt());
+
+	const uint32 NumMoves = Reader.ReadVarUInt();
+	for (uint32 Index = 0; Index < NumMoves && !Reader.HasError(); ++Index)
+	{
+		const uint32 Unit = Reader.ReadVarUInt();
+		const uint32 CellIndex = Reader.ReadVarUInt();
+		if (Unit >= MaxReplayHandle || !IsValidCell(CellIndex))
+		{
+			return false;
+		}
+		OutEvents.Moves.Add({StaticCast<FUnitHandle>(Unit), StaticCast<int32>(CellIndex)});
+	}
+
+	const uint32 NumAttacks = Reader.ReadVarUInt();
+	for (uint32 Index = 0; Index < NumAttacks && !Reader.HasError(); ++Index)
+	{
+		const uint32 Unit = Reader.ReadVarUInt();
+		const uint32 Target = Reader.ReadVarUInt();
+		if (Unit >= MaxReplayHandle || Target >= MaxReplayHandle)
+		{
+			return false;
+		}
+		OutEvents.Attacks.Add({StaticCast<FUnitHandle>(Unit), StaticCast<FUnitHandle>(Target)});
+	}
+
+	const uint32 NumDeaths = Reader.ReadVarUInt();
+	for (uint32 Index = 0; Index < NumDeaths && !Reader.HasError(); ++Index)
+	{
+		const uint32 Unit = Reader.ReadVarUInt();
+		const FUnitHandle Instigator = ReadOptionalHandle(Reader);
+		if (Unit >= MaxReplayHandle || Instigator >= StaticCast<FUnitHandle>(MaxReplayHandle) || Instigator < INDEX_NONE)
+		{
+			return false;
+		}
+		OutEvents.Deaths.Add({StaticCast<FUnitHandle>(Unit), Instigator});
+	}
+
+	// The payload has to be decoded to its very end
+	return !Reader.HasError() && Reader.GetOffset() == InPayload.Num();
+}
+
+bool GS_ReplayPlayer::IsValidCell(uint32 InCellIndex) const
+{
+	return InCellIndex < StaticCast<uint32>(Header.GridSizeX) * StaticCast<uint32>(Header.GridSizeY);
+}
@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/SimStats.h"
+
+#include "HAL/MemoryBase.h"
+
+#include <atomic>
+
+DEFINE_STAT(STAT_GridSim_Step);
+DEFINE_STAT(STAT_GridSim_PresenceTables);
+DEFINE_STAT(STAT_GridSim_TargetSearch);
+DEFINE_STAT(STAT_GridSim_UtilityEvaluation);
+DEFINE_STAT(STAT_GridSim_SquadPlanning);
+DEFINE_STAT(STAT_GridSim_Pathfinding);
+DEFINE_STAT(STAT_GridSim_UnitActions);
+DEFINE_STAT(STAT_GridSim_CombatResolution);
+DEFINE_STAT(STAT_GridSim_Cleanup);
+DEFINE_STAT(STAT_GridSim_GridSnapshot);
+DEFINE_STAT(STAT_GridSim_EndCheck);
+
+DEFINE_STAT(STAT_GridSim_UnitsProcessed);
+DEFINE_STAT(STAT_GridSim_NodesExpanded);
+DEFINE_STAT(STAT_GridSim_HeapOperations);
+DEFINE_STAT(STAT_GridSim_Allocations);
+DEFINE_STAT(STAT_GridSim_HeapAllocations);
+
+TRACE_DECLARE_INT_COUNTER(GridSim_UnitsProcessed, TEXT("GridSim/Units Processed"));
+TRACE_DECLARE_INT_COUNTER(GridSim_NodesExpanded, TEXT("GridSim/Nodes Expanded"));
+TRACE_DECLARE_INT_COUNTER(GridSim_HeapOperations, TEXT("GridSim/Heap Operations"));
+TRACE_DECLARE_INT_COUNTER(GridSim_Allocations, TEXT("GridSim/Allocations"));
+TRACE_DECLARE_INT_COUNTER(GridSim_HeapAllocations, TEXT("GridSim/Heap Allocations"));
+
+CSV_DEFINE_CATEGORY_MODULE(GRIDAISIM_API, GridSim, true);
+
+LLM_DEFINE_TAG(GridSim_Grid);
+LLM_DEFINE_TAG(GridSim_Pathfinding);
+LLM_DEFINE_TAG(GridSim_Units);
+LLM_DEFINE_TAG(GridSim_Logging);
+
+namespace
+{
+	thread_local uint64 ThreadAllocations = 0;
+
+	/**
+	 * Forwards everything to the allocator it wraps, counting the allocations of the calling thread on the way
+	 */
+	class FMallocCountingProxy final : public FMalloc
+	{
+	public:
+		explicit FMallocCountingProxy(FMalloc* InMalloc)
+			: UsedMalloc(InMalloc)
+		{
+		}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			++ThreadAllocations;
+			return UsedMalloc->Malloc(Count, Alignment);
+		}
+
+		virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+		{
+			++ThreadAllocations;
+			return UsedMalloc->TryMalloc(Count, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			// Shrinking to zero is a free
+			ThreadAllocations += Count > 0 ? 1 : 0;
+			return UsedMalloc->Realloc(Original, Count, Alignment);
+		}
+
+		virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			ThreadAllocations += Count > 0 ? 1 : 0;
+			return UsedMalloc->TryRealloc(Original, Count, Alignment);
+		}
+
+		virtual void Free(void* Original) override
+		{
+			UsedMalloc->Free(Original);
+		}
+
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+		{
+			return UsedMalloc->QuantizeSize(Count, Alignment);
+		}
+
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return UsedMalloc->GetAllocationSize(Original, SizeOut);
+		}
+
+		virtual void Trim(bool bTrimThreadCaches) override
+		{
+			UsedMalloc->Trim(bTrimThreadCaches);
+		}
+
+		virtual void SetupTLSCachesOnCurrentThread() override
+		{
+			UsedMalloc->SetupTLSCachesOnCurrentThread();
+		}
+
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+		{
+			UsedMalloc->ClearAndDisableTLSCachesOnCurrentThread();
+		}
+
+		virtual void InitializeStatsMetadata() override
+		{
+			UsedMalloc->InitializeStatsMetadata();
+		}
+
+		virtual void UpdateStats() override
+		{
+			UsedMalloc->UpdateStats();
+		}
+
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override
+		{
+			UsedMalloc->GetAllocatorStats(OutStats);
+		}
+
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override
+		{
+			UsedMalloc->DumpAllocatorStats(Ar);
+		}
+
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return UsedMalloc->IsInternallyThreadSafe();
+		}
+
+		virtual bool ValidateHeap() override
+		{
+			return UsedMalloc->ValidateHeap();
+		}
+
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return UsedMalloc->GetDescriptiveName();
+		}
+
+	private:
+		FMalloc* UsedMalloc = nullptr;
+	};
+
+	std::atomic<bool> bAllocationCounterEnabled = false;
+}
+
+void FSimStepCounters::Publish() const
+{
+	SET_DWORD_STAT(STAT_GridSim_UnitsProcessed, UnitsProcessed);
+	SET_DWORD_STAT(STAT_GridSim_NodesExpanded, NodesExpanded);
+	SET_DWORD_STAT(STAT_GridSim_HeapOperations, HeapOperations);
+	SET_DWORD_STAT(STAT_GridSim_Allocations, Allocations);
+	SET_DWORD_STAT(STAT_GridSim_HeapAllocations, HeapAllocations);
+
+	TRACE_COUNTER_SET(GridSim_UnitsProcessed, UnitsProcessed);
+	TRACE_COUNTER_SET(GridSim_NodesExpanded, NodesExpanded);
+	TRACE_COUNTER_SET(GridSim_HeapOperations, HeapOperations);
+	TRACE_COUNTER_SET(GridSim_Allocations, Allocations);
+	TRACE_COUNTER_SET(GridSim_HeapAllocations, HeapAllocations);
+
+	CSV_CUSTOM_STAT(GridSim, UnitsProcessed, UnitsProcessed, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(GridSim, NodesExpanded, NodesExpanded, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(GridSim, HeapOperations, HeapOperations, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(GridSim, Allocations, Allocations, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(GridSim, HeapAllocations, HeapAllocations, ECsvCustomStatOp::Set);
+}
+
+void FSimAllocationCounter::Enable()
+{
+	check(IsInGameThread());
+	if (bAllocationCounterEnabled)
+	{
+		return;
+	}
+
+	// Called at the module startup, before the simulation allocates anything. The proxy forwards everything
+	// to the wrapped allocator, so the blocks allocated before it are freed the same way. It's never removed,
+	// as the blocks allocated through it may be freed at any point later.
+	GMalloc = new FMallocCountingProxy(GMalloc);
+	bAllocationCounterEnabled = true;
+	UE_LOG(LogSim, Display, TEXT("[FSimAllocationCounter::Enable] Counting the heap allocations."));
+}
+
+bool FSimAllocationCounter::IsEnabled()
+{
+	return bAllocationCounterEnabled;
+}
+
+uint64 FSimAllocationCounter::GetThreadAllocations()
+{
+	return ThreadAllocations;
+}
@@ -0,0 +1,246 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/SimVecEnv.h"
+
+#include "Async/ParallelFor.h"
+#include "GridAISim/GridAISim.h"
+#include "Simulation/GridSimulation.h"
+
+FGridSimVecEnv::FGridSimVecEnv(const FSimVecEnvConfig& InConfig)
+	: Config(InConfig)
+{
+	LLM_SCOPE_BYTAG(GridSim_Units);
+
+	Config.NumEnvs = FMath::Max(1, Config.NumEnvs);
+	Config.SizeX = FMath::Max(2, Config.SizeX);
+	Config.SizeY = FMath::Max(1, Config.SizeY);
+	Config.MaxEpisodeSteps = FMath::Max(1, Config.MaxEpisodeSteps);
+
+	// Every team has to fit its half of the grid
+	const int32 MaxUnitsPerTeam = Config.SizeX / 2 * Config.SizeY;
+	if (Config.UnitsPerTeam > MaxUnitsPerTeam)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FGridSimVecEnv::FGridSimVecEnv] %d units per team don't fit the %dx%d grid."),
+		       Config.UnitsPerTeam, Config.SizeX, Config.SizeY);
+	}
+	Config.UnitsPerTeam = FMath::Clamp(Config.UnitsPerTeam, 1, MaxUnitsPerTeam);
+
+	Envs.SetNum(Config.NumEnvs);
+	for (FEnv& Env : Envs)
+	{
+		Env.Simulation = MakeUnique<FGridSimulation>();
+	}
+}
+
+FGridSimVecEnv::~FGridSimVecEnv() = default;
+
+bool FGridSimVecEnv::Reset(int32 InSeed, const FSimVecEnvBuffers& OutBuffers)
+{
+	if (!CheckBuffers(OutBuffers))
+	{
+		return false;
+	}
+
+	Seed = InSeed;
+	ParallelFor(Envs.Num(), [this, &OutBuffers](int32 EnvIndex)
+	{
+		Envs[EnvIndex].Episode = 0;
+		StartEpisode(EnvIndex);
+		WriteObservations(EnvIndex, OutBuffers);
+	});
+
+	FMemory::Memzero(OutBuffers.Rewards.GetData(), OutBuffers.Rewards.Num() * sizeof(float));
+	FMemory::Memzero(OutBuffers.Dones.GetData(), OutBuffers.Dones.Num() * sizeof(uint8));
+	return true;
+}
+
+bool FGridSimVecEnv::Step(TConstArrayView<EUnitAction> InActions, const FSimVecEnvBuffers& OutBuffers)
+{
+	if (InActions.Num() != Envs.Num() * NumUnitsPerEnv())
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FGridSimVecEnv::Step] %d actions given, %d expected."), InActions.Num(),
+		       Envs.Num() * NumUnitsPerEnv());
+		return false;
+	}
+	if (!CheckBuffers(OutBuffers))
+	{
+		return false;
+	}
+
+	// The simulations only choose the intents in parallel when asked to, so every one of them stays on its worker
+	ParallelFor(Envs.Num(), [this, InActions, &OutBuffers](int32 EnvIndex)
+	{
+		FEnv& Env = Envs[EnvIndex];
+		FGridSimulation& Simulation = *Env.Simulation;
+
+		// The unit handles are the indices of the units, so the actions of the environment are passed as they are
+		Simulation.SetExternalActions(InActions.Slice(EnvIndex * NumUnitsPerEnv(), NumUnitsPerEnv()));
+		Simulation.Step();
+		++Env.EpisodeStep;
+		WriteRewards(EnvIndex, OutBuffers);
+
+		const bool bIsDone = Simulation.IsOver() || Env.EpisodeStep >= Config.MaxEpisodeSteps;
+		OutBuffers.Dones[EnvIndex] = bIsDone ? 1 : 0;
+		if (bIsDone)
+		{
+			++Env.Episode;
+			StartEpisode(EnvIndex);
+		}
+		WriteObservations(EnvIndex, OutBuffers);
+	});
+	return true;
+}
+
+int32 FGridSimVecEnv::NumEnvs() const
+{
+	return Envs.Num();
+}
+
+int32 FGridSimVecEnv::NumUnitsPerEnv() const
+{
+	return Config.UnitsPerTeam * 2;
+}
+
+int32 FGridSimVecEnv::GetNumPlaneValues() const
+{
+	return Envs.Num() * NumTeams * Config.SizeX * Config.SizeY;
+}
+
+int32 FGridSimVecEnv::GetNumUnitFeatureValues() const
+{
+	return Envs.Num() * NumUnitsPerEnv() * NumUnitFeatures;
+}
+
+int32 FGridSimVecEnv::GetNumRewardValues() const
+{
+	return Envs.Num() * NumTeams;
+}
+
+const FGridSimulation& FGridSimVecEnv::GetSimulation(int32 InEnvIndex) const
+{
+	checkf(Envs.IsValidIndex(InEnvIndex), TEXT("[FGridSimVecEnv::GetSimulation] Invalid environment %d."), InEnvIndex);
+	return *Envs[InEnvIndex].Simulation;
+}
+
+bool FGridSimVecEnv::CheckBuffers(const FSimVecEnvBuffers& InBuffers) const
+{
+	if (InBuffers.Occupancy.Num() != GetNumPlaneValues() || InBuffers.Health.Num() != GetNumPlaneValues()
+		|| InBuffers.UnitFeatures.Num() != GetNumUnitFeatureValues()
+		|| InBuffers.Rewards.Num() != GetNumRewardValues() || InBuffers.Dones.Num() != Envs.Num())
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FGridSimVecEnv::CheckBuffers] The buffers don't match %d environments "
+			       "of %dx%d cells and %d units."), Envs.Num(), Config.SizeX, Config.SizeY, NumUnitsPerEnv());
+		return false;
+	}
+	return true;
+}
+
+void FGridSimVecEnv::StartEpisode(int32 InEnvIndex)
+{
+	FEnv& Env = Envs[InEnvIndex];
+	FGridSimulation& Simulation = *Env.Simulation;
+	Env.EpisodeStep = 0;
+
+	const uint32 EpisodeSeed = HashCombine(HashCombine(GetTypeHash(Seed), GetTypeHash(InEnvIndex)),
+	                                       GetTypeHash(Env.Episode));
+	FRandomStream Stream(StaticCast<int32>(EpisodeSeed));
+
+	Simulation.Init(Config.SizeX, Config.SizeY, Config.GridType);
+	FGrid& Grid = Simulation.GetGrid();
+
+	// The units go first, so they always find a free cell, the obstacles fill the cells left
+	const int32 HalfSizeX = Config.SizeX / 2;
+	for (int32 Index = 0; Index < NumUnitsPerEnv(); ++Index)
+	{
+		FUnitState Unit;
+		Unit.Team = Index < Config.UnitsPerTeam ? ETeam::RedTeam : ETeam::BlueTeam;
+		Unit.Health = Config.UnitHealth;
+		Unit.AttackPower = Config.UnitAttackPower;
+		Unit.AttackRange = Config.UnitAttackRange;
+
+		// Taken cells are passed by, starting from a random one of the half of the team
+		const int32 MinX = Unit.Team == ETeam::RedTeam ? 0 : Config.SizeX - HalfSizeX;
+		const int32 NumHalfCells = HalfSizeX * Config.SizeY;
+		const int32 FirstCell = Stream.RandRange(0, NumHalfCells - 1);
+		for (int32 Offset = 0; Offset < NumHalfCells; ++Offset)
+		{
+			const int32 HalfCell = (FirstCell + Offset) % NumHalfCells;
+			Unit.Cell = FIntPoint(MinX + HalfCell % HalfSizeX, HalfCell / HalfSizeX);
+			if (Grid.At(Unit.Cell).IsFree())
+			{
+				break;
+			}
+		}
+
+		const FUnitHandle Handle = Simulation.AddUnit(Unit);
+		checkf(Handle == Index, TEXT("[FGridSimVecEnv::StartEpisode] Unit %d got the handle %d."), Index, Handle);
+	}
+
+	const int32 NumObstacles = FMath::RoundToInt(Config.SizeX * Config.SizeY * Config.ObstacleDensity);
+	for (int32 Index = 0; Index < NumObstacles; ++Index)
+	{
+		const FIntPoint Cell(Stream.RandRange(0, Config.SizeX - 1), Stream.RandRange(0, Config.SizeY - 1));
+		if (Grid.At(Cell).IsFree())
+		{
+			Grid.SetObstacle(Cell, true);
+		}
+	}
+	Grid.UpdateComponents();
+}
+
+void FGridSimVecEnv::WriteRewards(int32 InEnvIndex, const FSimVecEnvBuffers& OutBuffers) const
+{
+	float* RESTRICT Rewards = OutBuffers.Rewards.GetData() + InEnvIndex * NumTeams;
+	FMemory::Memzero(Rewards, NumTeams * sizeof(float));
+
+	for (const FSimDeathEvent& Death : Envs[InEnvIndex].Simulation->GetStepEvents().Deaths)
+	{
+		// The dead units are off the registry already, their team follows from the handle
+		const int32 DeadPlane = GetTeamPlane(Death.Unit < Config.UnitsPerTeam ? ETeam::RedTeam : ETeam::BlueTeam);
+		for (int32 Plane = 0; Plane < NumTeams; ++Plane)
+		{
+			Rewards[Plane] += Plane == DeadPlane ? -1.f : 1.f;
+		}
+	}
+}
+
+void FGridSimVecEnv::WriteObservations(int32 InEnvIndex, const FSimVecEnvBuffers& OutBuffers) const
+{
+	const int32 PlaneSize = Config.SizeX * Config.SizeY;
+	float* RESTRICT Occupancy = OutBuffers.Occupancy.GetData() + InEnvIndex * NumTeams * PlaneSize;
+	float* RESTRICT Health = OutBuffers.Health.GetData() + InEnvIndex * NumTeams * PlaneSize;
+	float* RESTRICT Features = OutBuffers.UnitFeatures.GetData() + InEnvIndex * NumUnitsPerEnv() * NumUnitFeatures;
+	FMemory::Memzero(Occupancy, NumTeams * PlaneSize * sizeof(float));
+	FMemory::Memzero(Health, NumTeams * PlaneSize * sizeof(float));
+	FMemory::Memzero(Features, NumUnitsPerEnv() * NumUnitFeatures * sizeof(float));
+
+	const FUnitRegistry& Units = Envs[InEnvIndex].Simulation->GetUnits();
+	for (FUnitHandle Unit = 0; Unit < NumUnitsPerEnv(); ++Unit)
+	{
+		if (!Units.IsValid(Unit))
+		{
+			continue;
+		}
+
+		const FUnitState State = Units.Get(Unit);
+		const int32 Plane = GetTeamPlane(State.Team);
+		const int32 PlaneIndex = Plane * PlaneSize + State.Cell.Y * Config.SizeX + State.Cell.X;
+		Occupancy[PlaneIndex] = 1.f;
+		Health[PlaneIndex] = State.Health;
+
+		float* RESTRICT UnitFeatures = Features + Unit * NumUnitFeatures;
+		UnitFeatures[StaticCast<int32>(ESimUnitFeature::Alive)] = 1.f;
+		UnitFeatures[StaticCast<int32>(ESimUnitFeature::Team)] = StaticCast<float>(Plane);
+		UnitFeatures[StaticCast<int32>(ESimUnitFeature::X)] = StaticCast<float>(State.Cell.X) / Config.SizeX;
+		UnitFeatures[StaticCast<int32>(ESimUnitFeature::Y)] = StaticCast<float>(State.Cell.Y) / Config.SizeY;
+		UnitFeatures[StaticCast<int32>(ESimUnitFeature::Health)] = State.Health;
+		UnitFeatures[StaticCast<int32>(ESimUnitFeature::AttackPower)] = State.AttackPower;
+		UnitFeatures[StaticCast<int32>(ESimUnitFeature::AttackRange)] = StaticCast<float>(State.AttackRange);
+	}
+}
+
+int32 FGridSimVecEnv::GetTeamPlane(ETeam InTeam)
+{
+	return StaticCast<int32>(InTeam) - 1;
+}
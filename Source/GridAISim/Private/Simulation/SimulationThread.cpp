@@ -0,0 +1,222 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/SimulationThread.h"
+
+#include "GridAISim/GridAISim.h"
+#include "HAL/RunnableThread.h"
+#include "Simulation/GridSimulation.h"
+
+void FSimFrame::Capture(FGridSimulation& InSimulation)
+{
+	const FUnitRegistry& SimUnits = InSimulation.GetUnits();
+	Grid = InSimulation.GetGridSnapshot();
+
+	Step = InSimulation.GetStep();
+	bIsOver = InSimulation.IsOver();
+
+	Units.SetNum(SimUnits.NumHandles(), false);
+	for (FUnitHandle Handle = 0; Handle < Units.Num(); ++Handle)
+	{
+		FSimFrameUnit& Unit = Units[Handle];
+		if (SimUnits.IsValid(Handle))
+		{
+			Unit.CellIndex = Grid->At(SimUnits.GetCell(Handle)).Index;
+			Unit.Health = SimUnits.GetHealth(Handle);
+			Unit.Team = SimUnits.GetTeam(Handle);
+		}
+		else
+		{
+			Unit = FSimFrameUnit();
+		}
+	}
+
+	const FSimStepEvents& StepEvents = InSimulation.GetStepEvents();
+	Events.Reset(StepEvents.Step);
+	Events.Moves.Append(StepEvents.Moves);
+	Events.Attacks.Append(StepEvents.Attacks);
+	Events.Deaths.Append(StepEvents.Deaths);
+	Events.Halts.Append(StepEvents.Halts);
+}
+
+FGridSimulationThread::FGridSimulationThread(FGridSimulation& InSimulation)
+	: Simulation(InSimulation)
+{
+}
+
+FGridSimulationThread::~FGridSimulationThread()
+{
+	Shutdown();
+}
+
+void FGridSimulationThread::SetOnStepped(TFunction<void(const FGridSimulation&)>&& InOnStepped)
+{
+	check(!IsLaunched());
+	OnStepped = MoveTemp(InOnStepped);
+}
+
+bool FGridSimulationThread::Launch(float InStepDuration)
+{
+	check(!IsLaunched());
+
+	if (!FPlatformProcess::SupportsMultithreading())
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FGridSimulationThread::Launch] The platform doesn't support threads."));
+		return false;
+	}
+
+	StepDuration = FMath::Max(0.f, InStepDuration);
+	bStepping = false;
+	bStopRequested = false;
+
+	// The game thread starts from the current state as well
+	PublishFrame();
+
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool();
+	Thread = FRunnableThread::Create(this, TEXT("GridSimulation"), 0, TPri_AboveNormal);
+	if (Thread == nullptr)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FGridSimulationThread::Launch] Failed to create the thread."));
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void FGridSimulationThread::Shutdown()
+{
+	if (Thread == nullptr)
+	{
+		return;
+	}
+
+	// Kill calls Stop and waits for Run to return
+	Thread->Kill(true);
+	delete Thread;
+	Thread = nullptr;
+
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+
+	Commands.Empty();
+}
+
+bool FGridSimulationThread::IsLaunched() const
+{
+	return Thread != nullptr;
+}
+
+void FGridSimulationThread::Enqueue(const FSimCommand& InCommand)
+{
+	if (!IsLaunched())
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FGridSimulationThread::Enqueue] The thread is not launched."));
+		return;
+	}
+
+	Commands.Enqueue(InCommand);
+	WakeEvent->Trigger();
+}
+
+const FSimFrame* FGridSimulationThread::ConsumeFrame()
+{
+	return Frames.IsDirty() ? &Frames.SwapAndRead() : nullptr;
+}
+
+bool FGridSimulationThread::DequeueSpawnResult(FSimSpawnResult& OutResult)
+{
+	return SpawnResults.Dequeue(OutResult);
+}
+
+uint32 FGridSimulationThread::Run()
+{
+	while (!bStopRequested)
+	{
+		ProcessCommands();
+
+		if (!bStepping)
+		{
+			WakeEvent->Wait();
+			continue;
+		}
+
+		if (Simulation.IsOver())
+		{
+			bStepping = false;
+			PublishFrame();
+			continue;
+		}
+
+		const double StepStartTime = FPlatformTime::Seconds();
+		Simulation.Step();
+		if (!Simulation.IsOver())
+		{
+			Simulation.PrepareStep();
+		}
+		if (OnStepped)
+		{
+			OnStepped(Simulation);
+		}
+		PublishFrame();
+
+		// Keeps the pace of the steps, unless they take longer than that. The commands cut the wait short.
+		const double RemainingTime = StepDuration - (FPlatformTime::Seconds() - StepStartTime);
+		if (RemainingTime > 0.0)
+		{
+			WakeEvent->Wait(FTimespan::FromSeconds(RemainingTime));
+		}
+	}
+	return 0;
+}
+
+void FGridSimulationThread::Stop()
+{
+	bStopRequested = true;
+	WakeEvent->Trigger();
+}
+
+void FGridSimulationThread::ProcessCommands()
+{
+	bool bUnitsChanged = false;
+	FSimCommand Command;
+	while (Commands.Dequeue(Command))
+	{
+		switch (Command.Type)
+		{
+		case ESimCommandType::Start:
+			bStepping = true;
+			break;
+		case ESimCommandType::Stop:
+			bStepping = false;
+			break;
+		case ESimCommandType::Spawn:
+			{
+				FSimSpawnResult& Result = HeldSpawnResults.AddDefaulted_GetRef();
+				Result.SpawnRequest = Command.SpawnRequest;
+				Result.Unit = Simulation.AddUnit(Command.Unit);
+				bUnitsChanged = true;
+			}
+			break;
+		}
+	}
+
+	// The spawned units show up even while the simulation is paused
+	if (bUnitsChanged)
+	{
+		PublishFrame();
+	}
+
+	// Queued after the frame, so the game thread finds the spawned units in the next frame it consumes at the latest
+	for (const FSimSpawnResult& Result : HeldSpawnResults)
+	{
+		SpawnResults.Enqueue(Result);
+	}
+	HeldSpawnResults.Reset();
+}
+
+void FGridSimulationThread::PublishFrame()
+{
+	Frames.GetWriteBuffer().Capture(Simulation);
+	Frames.SwapWriteBuffers();
+}
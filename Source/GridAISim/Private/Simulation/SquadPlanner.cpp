@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/SquadPlanner.h"
+
+#include "Grid/Grid.h"
+#include "Grid/Pathfinder.h"
+#include "Simulation/SimStats.h"
+
+void FSquadPlanner::Plan(const FUnitRegistry& InRegistry, TConstArrayView<FUnitHandle> InUnits,
+                         TConstArrayView<FUnitIntent> InIntents, GS_Pathfinder& InPathfinder)
+{
+	LLM_SCOPE_BYTAG(GridSim_Pathfinding);
+
+	Reset();
+	UnitSquads.SetNumUninitialized(InIntents.Num(), false);
+	for (int32& Squad : UnitSquads)
+	{
+		Squad = INDEX_NONE;
+	}
+
+	for (const FUnitHandle Unit : InUnits)
+	{
+		const FUnitIntent& Intent = InIntents[Unit];
+		if (Intent.Action != EUnitAction::Approach || !InRegistry.IsValid(Intent.Target))
+		{
+			continue;
+		}
+
+		const FIntPoint Cell = InRegistry.GetCell(Unit);
+		const uint64 Key = MakeSquadKey(InRegistry.GetTeam(Unit), Intent.Target, Cell);
+		int32& SquadIndex = SquadsByKey.FindOrAdd(Key, INDEX_NONE);
+		if (SquadIndex == INDEX_NONE)
+		{
+			// The first unit of the squad leads it
+			SquadIndex = Squads.Num();
+			FSquad& Squad = Squads.AddDefaulted_GetRef();
+			Squad.Target = Intent.Target;
+			Squad.LeaderCell = Cell;
+		}
+
+		++Squads[SquadIndex].NumMembers;
+		UnitSquads[Unit] = SquadIndex;
+	}
+
+	for (FSquad& Squad : Squads)
+	{
+		const FIntPoint TargetCell = InRegistry.GetCell(Squad.Target);
+		const FIntPoint Offset = TargetCell - Squad.LeaderCell;
+		const int32 Distance = FMath::Max(FMath::Abs(Offset.X), FMath::Abs(Offset.Y));
+		if (Squad.NumMembers < MinSquadSize || Distance > MaxPathDistance)
+		{
+			continue;
+		}
+
+		// The units move every step, the path only goes around the obstacles
+		Squad.Path = InPathfinder.FindPath(Path::FNode(Squad.LeaderCell), Path::FNode(TargetCell), Paths, 1, true);
+	}
+}
+
+void FSquadPlanner::Reset()
+{
+	for (const FSquad& Squad : Squads)
+	{
+		Paths.Free(Squad.Path);
+	}
+	Squads.Reset();
+	SquadsByKey.Reset();
+	UnitSquads.Reset();
+}
+
+bool FSquadPlanner::GetWaypoint(FUnitHandle InUnit, const FIntPoint& InCell, const FGrid& InGrid,
+                                FIntPoint& OutWaypoint) const
+{
+	if (!UnitSquads.IsValidIndex(InUnit) || UnitSquads[InUnit] == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// The path starts at the cell of the leader
+	const FSquad& Squad = Squads[UnitSquads[InUnit]];
+	const int32 NumPathPoints = Paths.Num(Squad.Path);
+	if (NumPathPoints <= 1)
+	{
+		return false;
+	}
+
+	const FIntPoint PathPoint = Paths.GetPoint(Squad.Path, FMath::Min(WaypointLookahead, NumPathPoints - 1));
+	const FIntPoint Offset = InCell - Squad.LeaderCell;
+	const FIntPoint ClampedOffset(FMath::Clamp(Offset.X, -MaxMemberOffset, MaxMemberOffset),
+	                              FMath::Clamp(Offset.Y, -MaxMemberOffset, MaxMemberOffset));
+
+	// The shifted point may end up in an obstacle, the path itself never does
+	const FIntPoint ShiftedPoint = PathPoint + ClampedOffset;
+	const bool bIsShiftedPointOpen = InGrid.IsPointOnGrid(ShiftedPoint) && !InGrid.At(ShiftedPoint).bIsObstacle;
+	OutWaypoint = bIsShiftedPointOpen ? ShiftedPoint : PathPoint;
+	return true;
+}
+
+int32 FSquadPlanner::NumSquads() const
+{
+	return Squads.Num();
+}
+
+void FSquadPlanner::VisualizePaths(const GS_Pathfinder& InPathfinder, UGS_GridDebugOverlayComponent* InOverlay) const
+{
+	for (const FSquad& Squad : Squads)
+	{
+		InPathfinder.VisualizePath(InOverlay, Paths, Squad.Path);
+	}
+}
+
+uint64 FSquadPlanner::MakeSquadKey(ETeam InTeam, FUnitHandle InTarget, const FIntPoint& InCell)
+{
+	// The blocks of the grids up to 2^14 blocks a side don't overlap
+	const uint64 BlockX = StaticCast<uint64>(InCell.X / SquadBlockSize) & 0x3FFF;
+	const uint64 BlockY = StaticCast<uint64>(InCell.Y / SquadBlockSize) & 0x3FFF;
+	return (StaticCast<uint64>(InTarget) << 32) | (StaticCast<uint64>(InTeam) << 28) | (BlockY << 14) | BlockX;
+}
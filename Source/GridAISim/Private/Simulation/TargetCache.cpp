@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/TargetCache.h"
+
+void FUnitTargetCache::Reset()
+{
+	Entries.Reset();
+}
+
+void FUnitTargetCache::OnStepStarted()
+{
+	for (FTargetCacheEntry& Entry : Entries)
+	{
+		++Entry.StepsSinceAcquired;
+	}
+}
+
+void FUnitTargetCache::Reserve(int32 InNumUnits)
+{
+	if (Entries.Num() < InNumUnits)
+	{
+		Entries.SetNum(InNumUnits);
+	}
+}
+
+void FUnitTargetCache::Store(FUnitHandle InUnit, FUnitHandle InTarget, int32 InDistanceSqr)
+{
+	if (InUnit < 0)
+	{
+		return;
+	}
+
+	if (!Entries.IsValidIndex(InUnit))
+	{
+		Entries.SetNum(InUnit + 1);
+	}
+
+	FTargetCacheEntry& Entry = Entries[InUnit];
+	Entry.Target = InTarget;
+	Entry.AcquiredDistance = FMath::Sqrt(StaticCast<float>(InDistanceSqr));
+	Entry.StepsSinceAcquired = 0;
+}
+
+void FUnitTargetCache::Invalidate(FUnitHandle InUnit)
+{
+	if (Entries.IsValidIndex(InUnit))
+	{
+		Entries[InUnit] = FTargetCacheEntry();
+	}
+}
@@ -0,0 +1,291 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/UnitRegistry.h"
+
+#include "GridAISim/GridAISim.h"
+
+void FUnitRegistry::Reset()
+{
+	for (FTeamUnits& TeamUnits : Teams)
+	{
+		TeamUnits.Handles.Reset();
+		TeamUnits.Cells.Reset();
+		TeamUnits.Health.Reset();
+		TeamUnits.AttackPower.Reset();
+		TeamUnits.AttackRange.Reset();
+		TeamUnits.PendingDamage.Reset();
+		TeamUnits.LastInstigators.Reset();
+	}
+	HandleToSlot.Reset();
+	NumUnits = 0;
+}
+
+FUnitHandle FUnitRegistry::Add(const FUnitState& InUnit)
+{
+	if (InUnit.Team >= ETeam::MAX)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FUnitRegistry::Add] Invalid team %d."), StaticCast<int32>(InUnit.Team));
+		return INDEX_NONE;
+	}
+
+	const FUnitHandle Handle = HandleToSlot.AddDefaulted();
+	AddToTeam(Handle, InUnit);
+	return Handle;
+}
+
+bool FUnitRegistry::Restore(FUnitHandle InHandle, const FUnitState& InUnit)
+{
+	if (InUnit.Team >= ETeam::MAX)
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FUnitRegistry::Restore] Invalid team %d."), StaticCast<int32>(InUnit.Team));
+		return false;
+	}
+
+	if (!HandleToSlot.IsValidIndex(InHandle) || IsValid(InHandle))
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FUnitRegistry::Restore] Handle %d is not available."), InHandle);
+		return false;
+	}
+
+	AddToTeam(InHandle, InUnit);
+	return true;
+}
+
+void FUnitRegistry::AddToTeam(FUnitHandle InHandle, const FUnitState& InUnit)
+{
+	FTeamUnits& TeamUnits = Teams[StaticCast<int32>(InUnit.Team)];
+
+	FUnitSlot& Slot = HandleToSlot[InHandle];
+	Slot.Team = InUnit.Team;
+	Slot.Index = TeamUnits.Handles.Add(InHandle);
+	TeamUnits.Cells.Add(InUnit.Cell);
+	TeamUnits.Health.Add(InUnit.Health);
+	TeamUnits.AttackPower.Add(InUnit.AttackPower);
+	TeamUnits.AttackRange.Add(InUnit.AttackRange);
+	TeamUnits.PendingDamage.Add(0.f);
+	TeamUnits.LastInstigators.Add(INDEX_NONE);
+
+	++NumUnits;
+}
+
+bool FUnitRegistry::Remove(FUnitHandle InHandle)
+{
+	if (!IsValid(InHandle))
+	{
+		return false;
+	}
+
+	FUnitSlot& Slot = HandleToSlot[InHandle];
+	FTeamUnits& TeamUnits = Teams[StaticCast<int32>(Slot.Team)];
+
+	// Move the last unit of the team into the freed slot, and let its handle know about it
+	const int32 LastIndex = TeamUnits.Num() - 1;
+	if (Slot.Index != LastIndex)
+	{
+		const FUnitHandle MovedHandle = TeamUnits.Handles[LastIndex];
+		HandleToSlot[MovedHandle].Index = Slot.Index;
+	}
+	TeamUnits.Handles.RemoveAtSwap(Slot.Index, 1, false);
+	TeamUnits.Cells.RemoveAtSwap(Slot.Index, 1, false);
+	TeamUnits.Health.RemoveAtSwap(Slot.Index, 1, false);
+	TeamUnits.AttackPower.RemoveAtSwap(Slot.Index, 1, false);
+	TeamUnits.AttackRange.RemoveAtSwap(Slot.Index, 1, false);
+	TeamUnits.PendingDamage.RemoveAtSwap(Slot.Index, 1, false);
+	TeamUnits.LastInstigators.RemoveAtSwap(Slot.Index, 1, false);
+
+	Slot = FUnitSlot();
+	--NumUnits;
+	return true;
+}
+
+void FUnitRegistry::RemoveAll()
+{
+	const int32 NumHandles = HandleToSlot.Num();
+	Reset();
+	HandleToSlot.SetNum(NumHandles);
+}
+
+bool FUnitRegistry::IsValid(FUnitHandle InHandle) const
+{
+	return HandleToSlot.IsValidIndex(InHandle) && HandleToSlot[InHandle].Index != INDEX_NONE;
+}
+
+FUnitState FUnitRegistry::Get(FUnitHandle InHandle) const
+{
+	checkf(IsValid(InHandle), TEXT("[FUnitRegistry::Get] Invalid unit handle %d."), InHandle);
+
+	const FUnitSlot& Slot = HandleToSlot[InHandle];
+	const FTeamUnits& TeamUnits = Teams[StaticCast<int32>(Slot.Team)];
+
+	FUnitState Unit;
+	Unit.Team = Slot.Team;
+	Unit.Cell = TeamUnits.Cells[Slot.Index];
+	Unit.Health = TeamUnits.Health[Slot.Index];
+	Unit.AttackPower = TeamUnits.AttackPower[Slot.Index];
+	Unit.AttackRange = TeamUnits.AttackRange[Slot.Index];
+	return Unit;
+}
+
+int32 FUnitRegistry::NumHandles() const
+{
+	return HandleToSlot.Num();
+}
+
+int32 FUnitRegistry::Num() const
+{
+	return NumUnits;
+}
+
+int32 FUnitRegistry::Num(ETeam InTeam) const
+{
+	return GetTeamUnits(InTeam).Num();
+}
+
+int32 FUnitRegistry::NumTeamsWithUnits() const
+{
+	int32 Result = 0;
+	for (const FTeamUnits& TeamUnits : Teams)
+	{
+		Result += TeamUnits.Num() > 0 ? 1 : 0;
+	}
+	return Result;
+}
+
+const FTeamUnits& FUnitRegistry::GetTeamUnits(ETeam InTeam) const
+{
+	checkf(InTeam < ETeam::MAX, TEXT("[FUnitRegistry::GetTeamUnits] Invalid team."));
+	return Teams[StaticCast<int32>(InTeam)];
+}
+
+float FUnitRegistry::GetHealth(FUnitHandle InHandle) const
+{
+	if (!IsValid(InHandle))
+	{
+		return 0.f;
+	}
+
+	const FUnitSlot& Slot = HandleToSlot[InHandle];
+	return Teams[StaticCast<int32>(Slot.Team)].Health[Slot.Index];
+}
+
+ETeam FUnitRegistry::GetTeam(FUnitHandle InHandle) const
+{
+	return IsValid(InHandle) ? HandleToSlot[InHandle].Team : ETeam::NoTeam;
+}
+
+FIntPoint FUnitRegistry::GetCell(FUnitHandle InHandle) const
+{
+	checkf(IsValid(InHandle), TEXT("[FUnitRegistry::GetCell] Invalid unit handle %d."), InHandle);
+
+	const FUnitSlot& Slot = HandleToSlot[InHandle];
+	return Teams[StaticCast<int32>(Slot.Team)].Cells[Slot.Index];
+}
+
+void FUnitRegistry::SetCell(FUnitHandle InHandle, const FIntPoint& InCell)
+{
+	checkf(IsValid(InHandle), TEXT("[FUnitRegistry::SetCell] Invalid unit handle %d."), InHandle);
+
+	const FUnitSlot& Slot = HandleToSlot[InHandle];
+	Teams[StaticCast<int32>(Slot.Team)].Cells[Slot.Index] = InCell;
+}
+
+int32 FUnitRegistry::GetAttackRange(FUnitHandle InHandle) const
+{
+	if (!IsValid(InHandle))
+	{
+		return 0;
+	}
+
+	const FUnitSlot& Slot = HandleToSlot[InHandle];
+	return Teams[StaticCast<int32>(Slot.Team)].AttackRange[Slot.Index];
+}
+
+float FUnitRegistry::GetAttackPower(FUnitHandle InHandle) const
+{
+	if (!IsValid(InHandle))
+	{
+		return 0.f;
+	}
+
+	const FUnitSlot& Slot = HandleToSlot[InHandle];
+	return Teams[StaticCast<int32>(Slot.Team)].AttackPower[Slot.Index];
+}
+
+void FUnitRegistry::QueueDamage(FUnitHandle InTarget, FUnitHandle InInstigator)
+{
+	if (!IsValid(InTarget) || !IsValid(InInstigator))
+	{
+		UE_LOG(LogSim, Warning, TEXT("[FUnitRegistry::QueueDamage] Invalid unit handle."));
+		return;
+	}
+
+	const FUnitSlot& InstigatorSlot = HandleToSlot[InInstigator];
+	const float Damage = Teams[StaticCast<int32>(InstigatorSlot.Team)].AttackPower[InstigatorSlot.Index];
+
+	const FUnitSlot& TargetSlot = HandleToSlot[InTarget];
+	FTeamUnits& TargetTeam = Teams[StaticCast<int32>(TargetSlot.Team)];
+	TargetTeam.PendingDamage[TargetSlot.Index] += Damage;
+	TargetTeam.LastInstigators[TargetSlot.Index] = InInstigator;
+}
+
+void FUnitRegistry::ResolveDamage(TArray<FUnitHandle>& OutDamaged, TArray<FUnitKill>& OutKilled)
+{
+	OutDamaged.Reset();
+	OutKilled.Reset();
+
+	auto CollectResults = [&OutDamaged, &OutKilled](const FTeamUnits& TeamUnits, int32 InIndex, bool bInKilled)
+	{
+		OutDamaged.Add(TeamUnits.Handles[InIndex]);
+		if (bInKilled)
+		{
+			OutKilled.Add({TeamUnits.Handles[InIndex], TeamUnits.LastInstigators[InIndex]});
+		}
+	};
+
+	const VectorRegister4Float Zero = VectorZero();
+	for (FTeamUnits& TeamUnits : Teams)
+	{
+		float* RESTRICT Health = TeamUnits.Health.GetData();
+		float* RESTRICT Damage = TeamUnits.PendingDamage.GetData();
+		const int32 NumTeamUnits = TeamUnits.Num();
+
+		// Four units per iteration. Most of the units don't get hit during a step, so the results are collected
+		// only for the groups that have any damage.
+		int32 Index = 0;
+		for (; Index + 4 <= NumTeamUnits; Index += 4)
+		{
+			const VectorRegister4Float DamageVec = VectorLoad(Damage + Index);
+			const VectorRegister4Float HealthVec = VectorSubtract(VectorLoad(Health + Index), DamageVec);
+			VectorStore(HealthVec, Health + Index);
+			VectorStore(Zero, Damage + Index);
+
+			const VectorRegister4Float DamagedMask = VectorCompareGT(DamageVec, Zero);
+			const int32 DamagedBits = VectorMaskBits(DamagedMask);
+			if (DamagedBits == 0)
+			{
+				continue;
+			}
+
+			const int32 KilledBits = VectorMaskBits(VectorBitwiseAnd(DamagedMask, VectorCompareLE(HealthVec, Zero)));
+			for (int32 Lane = 0; Lane < 4; ++Lane)
+			{
+				if (DamagedBits & (1 << Lane))
+				{
+					CollectResults(TeamUnits, Index + Lane, (KilledBits & (1 << Lane)) != 0);
+				}
+			}
+		}
+
+		// The tail
+		for (; Index < NumTeamUnits; ++Index)
+		{
+			if (Damage[Index] > 0.f)
+			{
+				Health[Index] -= Damage[Index];
+				Damage[Index] = 0.f;
+				CollectResults(TeamUnits, Index, Health[Index] <= 0.f);
+			}
+		}
+	}
+}
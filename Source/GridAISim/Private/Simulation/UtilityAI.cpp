@@ -0,0 +1,195 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Simulation/UtilityAI.h"
+
+namespace
+{
+	/**
+	 * Multiplies the scores by the curve over the inputs, four units per iteration
+	 */
+	void MultiplyByCurve(const FUtilityCurve& InCurve, const float* RESTRICT InInputs, float* RESTRICT Scores,
+	                     int32 InNum)
+	{
+		const VectorRegister4Float Zero = VectorZero();
+		const VectorRegister4Float One = VectorOne();
+		const VectorRegister4Float Slope = VectorSetFloat1(InCurve.Slope);
+		const VectorRegister4Float Midpoint = VectorSetFloat1(InCurve.Midpoint);
+		const VectorRegister4Float Intercept = VectorSetFloat1(InCurve.Intercept);
+
+		for (int32 Index = 0; Index < InNum; Index += 4)
+		{
+			const VectorRegister4Float X = VectorLoad(InInputs + Index);
+			VectorRegister4Float Y;
+			switch (InCurve.Type)
+			{
+			case EUtilityCurveType::Quadratic:
+				{
+					const VectorRegister4Float Offset = VectorSubtract(X, Midpoint);
+					Y = VectorMultiplyAdd(Slope, VectorMultiply(Offset, Offset), Intercept);
+				}
+				break;
+			case EUtilityCurveType::Logistic:
+				Y = VectorDivide(One, VectorAdd(One, VectorExp(VectorMultiply(VectorNegate(Slope),
+				                                                              VectorSubtract(X, Midpoint)))));
+				break;
+			default:
+				Y = VectorMultiplyAdd(Slope, X, Intercept);
+				break;
+			}
+
+			Y = VectorMin(VectorMax(Y, Zero), One);
+			VectorStore(VectorMultiply(VectorLoad(Scores + Index), Y), Scores + Index);
+		}
+	}
+
+	FUtilityConsideration MakeConsideration(EUtilityInput InInput, EUtilityCurveType InType, float InSlope,
+	                                        float InMidpoint, float InIntercept)
+	{
+		FUtilityConsideration Consideration;
+		Consideration.Input = InInput;
+		Consideration.Curve.Type = InType;
+		Consideration.Curve.Slope = InSlope;
+		Consideration.Curve.Midpoint = InMidpoint;
+		Consideration.Curve.Intercept = InIntercept;
+		return Consideration;
+	}
+}
+
+float FUtilityCurve::Evaluate(float InX) const
+{
+	float Y = 0.f;
+	switch (Type)
+	{
+	case EUtilityCurveType::Quadratic:
+		Y = Slope * FMath::Square(InX - Midpoint) + Intercept;
+		break;
+	case EUtilityCurveType::Logistic:
+		Y = 1.f / (1.f + FMath::Exp(-Slope * (InX - Midpoint)));
+		break;
+	default:
+		Y = Slope * InX + Intercept;
+		break;
+	}
+	return FMath::Clamp(Y, 0.f, 1.f);
+}
+
+TArray<FUtilityAction> FUtilityEvaluator::MakeDefaultActions()
+{
+	// A steep step right past the edge of the attack range
+	constexpr float RangeSlope = 50.f;
+	constexpr float RangeEdge = 1.05f;
+
+	TArray<FUtilityAction> Actions;
+
+	FUtilityAction& Attack = Actions.AddDefaulted_GetRef();
+	Attack.Action = EUnitAction::Attack;
+	Attack.Considerations.Add(MakeConsideration(EUtilityInput::TargetDistance, EUtilityCurveType::Logistic,
+	                                            -RangeSlope, RangeEdge, 0.f));
+	Attack.Considerations.Add(MakeConsideration(EUtilityInput::Threat, EUtilityCurveType::Linear, -0.5f, 0.f, 1.f));
+
+	// Takes over from the plain attack, when the opponents around outweigh the support
+	// and there is more than one opponent to choose from
+	FUtilityAction& FocusFire = Actions.AddDefaulted_GetRef();
+	FocusFire.Action = EUnitAction::FocusFire;
+	FocusFire.Considerations.Add(MakeConsideration(EUtilityInput::TargetDistance, EUtilityCurveType::Logistic,
+	                                               -RangeSlope, RangeEdge, 0.f));
+	FocusFire.Considerations.Add(MakeConsideration(EUtilityInput::Threat, EUtilityCurveType::Linear, 1.f, 0.f, 0.f));
+	FocusFire.Considerations.Add(MakeConsideration(EUtilityInput::OpponentsInRange, EUtilityCurveType::Logistic,
+	                                               10.f, 1.5f, 0.f));
+
+	FUtilityAction& Approach = Actions.AddDefaulted_GetRef();
+	Approach.Action = EUnitAction::Approach;
+	Approach.Weight = 0.9f;
+	Approach.Considerations.Add(MakeConsideration(EUtilityInput::TargetDistance, EUtilityCurveType::Logistic,
+	                                              RangeSlope, RangeEdge, 0.f));
+
+	// Only the weak and heavily outnumbered units run
+	FUtilityAction& Retreat = Actions.AddDefaulted_GetRef();
+	Retreat.Action = EUnitAction::Retreat;
+	Retreat.Considerations.Add(MakeConsideration(EUtilityInput::Threat, EUtilityCurveType::Logistic, 12.f, 0.8f, 0.f));
+	Retreat.Considerations.Add(MakeConsideration(EUtilityInput::RelativeHealth, EUtilityCurveType::Linear,
+	                                             -1.f, 0.f, 1.f));
+
+	FUtilityAction& Guard = Actions.AddDefaulted_GetRef();
+	Guard.Action = EUnitAction::Guard;
+	Guard.Weight = 0.05f;
+
+	return Actions;
+}
+
+void FUtilityEvaluator::SetActions(TArray<FUtilityAction>&& InActions)
+{
+	Actions = MoveTemp(InActions);
+}
+
+void FUtilityEvaluator::Reset(int32 InNumUnits)
+{
+	NumUnits = InNumUnits;
+
+	const int32 PaddedNum = Align(InNumUnits, 4);
+	for (TArray<float>& Column : InputColumns)
+	{
+		Column.SetNumZeroed(PaddedNum, false);
+	}
+	Scores.SetNumUninitialized(PaddedNum, false);
+	BestScores.SetNumUninitialized(PaddedNum, false);
+	BestActions.SetNumUninitialized(PaddedNum, false);
+}
+
+TArrayView<float> FUtilityEvaluator::GetInputs(EUtilityInput InInput)
+{
+	return TArrayView<float>(InputColumns[StaticCast<int32>(InInput)].GetData(), NumUnits);
+}
+
+void FUtilityEvaluator::Evaluate(TArrayView<EUnitAction> OutActions)
+{
+	check(OutActions.Num() == NumUnits);
+
+	const int32 PaddedNum = Scores.Num();
+	float* RESTRICT ScoreData = Scores.GetData();
+	float* RESTRICT BestScoreData = BestScores.GetData();
+	float* RESTRICT BestActionData = BestActions.GetData();
+
+	const VectorRegister4Float MinScore = VectorSetFloat1(-1.f);
+	for (int32 Index = 0; Index < PaddedNum; Index += 4)
+	{
+		VectorStore(MinScore, BestScoreData + Index);
+		VectorStore(VectorZero(), BestActionData + Index);
+	}
+
+	for (int32 ActionIndex = 0; ActionIndex < Actions.Num(); ++ActionIndex)
+	{
+		const FUtilityAction& Action = Actions[ActionIndex];
+
+		const VectorRegister4Float Weight = VectorSetFloat1(Action.Weight);
+		for (int32 Index = 0; Index < PaddedNum; Index += 4)
+		{
+			VectorStore(Weight, ScoreData + Index);
+		}
+
+		for (const FUtilityConsideration& Consideration : Action.Considerations)
+		{
+			MultiplyByCurve(Consideration.Curve, InputColumns[StaticCast<int32>(Consideration.Input)].GetData(),
+			                ScoreData, PaddedNum);
+		}
+
+		// The first of the equally scored actions wins
+		const VectorRegister4Float ActionValue = VectorSetFloat1(StaticCast<float>(ActionIndex));
+		for (int32 Index = 0; Index < PaddedNum; Index += 4)
+		{
+			const VectorRegister4Float Score = VectorLoad(ScoreData + Index);
+			const VectorRegister4Float BestScore = VectorLoad(BestScoreData + Index);
+			const VectorRegister4Float BetterMask = VectorCompareGT(Score, BestScore);
+			VectorStore(VectorSelect(BetterMask, Score, BestScore), BestScoreData + Index);
+			VectorStore(VectorSelect(BetterMask, ActionValue, VectorLoad(BestActionData + Index)),
+			            BestActionData + Index);
+		}
+	}
+
+	for (int32 Index = 0; Index < NumUnits; ++Index)
+	{
+		const int32 ActionIndex = StaticCast<int32>(BestActionData[Index]);
+		OutActions[Index] = Actions.IsValidIndex(ActionIndex) ? Actions[ActionIndex].Action : EUnitAction::Guard;
+	}
+}
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ActorPoolSubsystem.generated.h"
+
+class AGS_GameActorBase;
+
+/**
+ * Inactive actors of a single class.
+ */
+USTRUCT()
+struct FGS_ActorPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<TObjectPtr<AGS_GameActorBase>> FreeActors;
+};
+
+/**
+ * The pool of game actors. Killed, or otherwise unneeded actors are returned here instead of being destroyed,
+ * and are handed out again with their state reset, so neither spawning nor GC get in the way of repeated runs.
+ */
+UCLASS()
+class GRIDAISIM_API UGS_ActorPoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Makes sure that there are at least InCount inactive actors of the class in the pool
+	 * @param InClass The class of actors
+	 * @param InCount The number of actors to keep ready
+	 */
+	void Prewarm(TSubclassOf<AGS_GameActorBase> InClass, int32 InCount);
+
+	/**
+	 * Hands out an actor of the class, spawning a new one if the pool is empty
+	 * @param InClass The class of the actor
+	 * @param InTransform The transform to place the actor at
+	 * @return An active actor with its state reset
+	 */
+	AGS_GameActorBase* Acquire(TSubclassOf<AGS_GameActorBase> InClass, const FTransform& InTransform);
+
+	/**
+	 * Hands out a whole batch of actors at once. The missing actors are spawned in a single deferred batch,
+	 * so their construction and component registration happen together, instead of being interleaved with the setup.
+	 * @param InClass The class of the actors
+	 * @param InCount The number of actors
+	 * @param OutActors Active actors with their state reset, placed at the origin
+	 */
+	void AcquireBatch(TSubclassOf<AGS_GameActorBase> InClass, int32 InCount, TArray<AGS_GameActorBase*>& OutActors);
+
+	/**
+	 * Deactivates the actor and returns it to the pool of its class
+	 */
+	void Release(AGS_GameActorBase* InActor);
+
+	int32 GetNumFree(TSubclassOf<AGS_GameActorBase> InClass) const;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	/**
+	 * Spawns inactive actors straight into the pool
+	 */
+	void SpawnIntoPool(UClass* InClass, int32 InCount);
+
+	UPROPERTY()
+	TMap<TObjectPtr<UClass>, FGS_ActorPool> Pools;
+};
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "StaticData.h"
+#include "Simulation/UnitRegistry.h"
+#include "CrowdRenderer.generated.h"
+
+class UInstancedStaticMeshComponent;
+
+/**
+ * Draws the game actors through instanced static meshes, one instanced component per unit class and team,
+ * instead of every actor drawing its own skeletal mesh.
+ *
+ * The instances are rebuilt in bulk from the actors added between BeginUpdate and EndUpdate.
+ * Each instance gets two custom data floats: the EActorState of the unit and the time the state was entered,
+ * so the material can play a baked vertex animation.
+ */
+UCLASS()
+class GRIDAISIM_API AGS_CrowdRenderer : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AGS_CrowdRenderer();
+
+	static constexpr int32 NumCustomDataFloats = 2;
+
+	void BeginUpdate();
+
+	/**
+	 * Adds an instance for the actor to the batch of its class and team
+	 */
+	void AddInstance(const AGS_GameActorBase* InActor);
+
+	/**
+	 * Pushes the collected transforms and custom data to the instanced components
+	 */
+	void EndUpdate();
+
+	/**
+	 * @return The number of instances drawn for the unit class and team
+	 */
+	int32 GetNumInstances(const UClass* InClass, ETeam InTeam) const;
+
+	/**
+	 * Checks that every registered unit is drawn exactly once, by the batch of its class and team,
+	 * and that the instance transforms match the actor locations. Doesn't need a renderer, so it works headless.
+	 * @param InUnits The units of the simulation
+	 * @param InUnitActors The actors of the units, indexed by the unit handles
+	 * @return False, if any mismatch was found. The mismatches are logged.
+	 */
+	bool ValidateInstances(const FUnitRegistry& InUnits,
+	                       TConstArrayView<TObjectPtr<AGS_GameActorBase>> InUnitActors) const;
+
+private:
+	/**
+	 * The instances of a single unit class and team
+	 */
+	struct FCrowdBatch
+	{
+		const UClass* Class = nullptr;
+		ETeam Team = ETeam::NoTeam;
+
+		// The actors drawn by the instances, indexed by the instance index
+		TArray<const AGS_GameActorBase*> InstanceActors;
+		TArray<FTransform> Transforms;
+		TArray<float> CustomData;
+	};
+
+	/**
+	 * @return The index of the batch of the actor's class and team, or INDEX_NONE if the class has no crowd mesh
+	 */
+	int32 FindOrAddBatch(const AGS_GameActorBase* InActor);
+
+	// Parallel to Batches
+	UPROPERTY()
+	TArray<TObjectPtr<UInstancedStaticMeshComponent>> BatchComponents;
+
+	TArray<FCrowdBatch> Batches;
+
+	TMap<const UClass*, int32> BatchIndices[StaticCast<int32>(ETeam::MAX)];
+};
@@ -6,6 +6,7 @@
 #include "GameFramework/Actor.h"
 #include "StaticData.h"
 #include "GameModes/GameModeDefault.h"
+#include "Simulation/UnitRegistry.h"
 #include "GameActorBase.generated.h"
 
 UCLASS()
@@ -17,7 +18,6 @@ public:
 	// Sets default values for this actor's properties
 	AGS_GameActorBase();
 
-	virtual void Tick(float DeltaSeconds) override;
 	virtual void BeginPlay() override;
 	
 	ETeam GetTeam() const;
@@ -33,6 +33,9 @@ public:
 	
 	int32 GetGridPointIndex() const;
 	void SetGridPointIndex(const int32 InGridPointIndex);
+
+	FUnitHandle GetUnitHandle() const;
+	void SetUnitHandle(FUnitHandle InUnitHandle);
 	
 	void SetAttackPower(float InNewAttackPower);
 	float GetAttackPower() const;
@@ -56,12 +59,45 @@ public:
 	void PlayHit();
 	void PlayAttack(const AGS_GameActorBase* InTargetActor);
 	void HandleZeroHealth();
+
+	/**
+	 * Returns the actor to the actor pool, or destroys it if there is no pool
+	 */
 	void StartDestroy();
 
+	/**
+	 * Brings a pooled actor back to the freshly spawned state, so it can be set up as a new unit
+	 */
+	void ResetForReuse();
+
+	/**
+	 * Hides and deactivates the actor, when it's returned to the pool
+	 */
+	void OnReturnedToPool();
+
+	/**
+	 * Moves the actor to the location over the given time, by the means of the movement interpolator
+	 */
 	void MoveActorInterp(const FVector& InNewLocation, float InInterpTime_ms);
+	void StopMovement();
 	void SetActionDuration(float InGameActionDurationSeconds);
 	void Halt();
 
+	EActorState GetActorState() const;
+
+	/**
+	 * @return The world time when the actor entered its current state
+	 */
+	float GetActorStateStartTime() const;
+
+	/**
+	 * Switches the actor to be drawn by AGS_CrowdRenderer. The own skeletal mesh is hidden and doesn't animate.
+	 */
+	void SetCrowdRendered(bool bInCrowdRendered);
+
+	UStaticMesh* GetCrowdMesh() const;
+	UMaterialInterface* GetTeamMaterial() const;
+
 protected:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Game Actor|Visual|Mesh")
 	TObjectPtr<UStaticMeshComponent> StaticMeshComp;
@@ -73,6 +109,10 @@ protected:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Game Actor|Visual|Materials")
 	UMaterialInterface* BlueTeamMaterial;
 
+	// The mesh used to draw the actors of this class in the instanced crowd mode
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Game Actor|Visual|Mesh")
+	TObjectPtr<UStaticMesh> CrowdMesh;
+
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Game Actor|Visual|Animations")
 	TObjectPtr<UAnimSequenceBase> IdleAnimation;
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Game Actor|Visual|Animations")
@@ -120,6 +160,10 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Game Actor|Debug")
 	int32 GridPointIndex;
 
+	// The handle of the unit in the GameMode's unit registry
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Game Actor|Debug")
+	int32 UnitHandle = INDEX_NONE;
+
 protected:
 	// TODO: check movement components
 	FVector TargetLocation;
@@ -132,8 +176,15 @@ protected:
 	// This is the length of a single game action, so the visuals could be scaled in time
 	float GameActionDurationSeconds = 1.f;
 
+	// The delay between the death and returning the actor to the pool
+	FTimerHandle DestroyTimerHandle;
+
 	// Set it with a corresponding setter
 	EActorState ActorState = EActorState::Idle;
+	float ActorStateStartTime = 0.f;
+
+	// Whether the actor is drawn by the crowd renderer instead of its own meshes
+	bool bCrowdRendered = false;
 
 	void SetActorState(EActorState NewState);
 	void OnActorStateChanged(EActorState NewState){};
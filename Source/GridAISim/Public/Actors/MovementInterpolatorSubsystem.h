@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MovementInterpolatorSubsystem.generated.h"
+
+class AGS_GameActorBase;
+
+/**
+ * Moves the game actors towards their target locations at a constant speed, instead of the actors ticking themselves.
+ *
+ * Only the moving actors are kept, in dense parallel arrays, and all of them are advanced in a single vectorized pass
+ * per frame. Only the actors that actually changed their location get their transforms updated,
+ * and the ones that arrived are dropped from the list, so the cost scales with the number of moving actors.
+ */
+UCLASS()
+class GRIDAISIM_API UGS_MovementInterpolatorSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/**
+	 * Starts moving the actor from its current location to the target one
+	 * @param InActor The actor to move
+	 * @param InTargetLocation The location to move to
+	 * @param InDuration The time the movement should take
+	 */
+	void MoveTo(AGS_GameActorBase* InActor, const FVector& InTargetLocation, float InDuration);
+
+	/**
+	 * Stops the movement of the actor at its current location
+	 */
+	void Stop(const AGS_GameActorBase* InActor);
+
+	int32 GetNumMoving() const;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void RemoveAtSwap(int32 InSlot);
+
+	UPROPERTY()
+	TArray<TObjectPtr<AGS_GameActorBase>> MovingActors;
+
+	// Parallel to MovingActors
+	TArray<float> LocationsX;
+	TArray<float> LocationsY;
+	TArray<float> LocationsZ;
+	TArray<float> TargetsX;
+	TArray<float> TargetsY;
+	TArray<float> TargetsZ;
+	TArray<float> Speeds;
+
+	TMap<const AGS_GameActorBase*, int32> ActorToSlot;
+
+	// Per frame lists, kept as members to reuse the allocations
+	TArray<int32> DirtySlots;
+	TArray<int32> ArrivedSlots;
+};
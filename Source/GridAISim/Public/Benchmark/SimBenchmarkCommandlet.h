@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SimBenchmarkCommandlet.generated.h"
+
+/**
+ * Runs the simulation headless over a matrix of grid sizes, unit counts, obstacle densities and topologies,
+ * and measures the pathfinding, the closest opponent search and the full simulation step.
+ * Every scenario is generated from a fixed seed, so the runs are comparable with each other.
+ *
+ * The median and p99 timings and the allocation counts are written to Saved/Benchmarks. When a baseline is given,
+ * the results are compared to it and the commandlet fails, if any metric regressed past the threshold.
+ *
+ * Usage: UnrealEditor-Cmd GridAISim.uproject -run=GS_SimBenchmark [options]
+ *   -iterations=N    The number of measured samples per benchmark, 20 by default
+ *   -filter=Text     Only runs the scenarios, which names contain the text, e.g. -filter=G500_
+ *   -baseline=Path   The baseline to compare to, Saved/Benchmarks/SimBaseline.csv by default
+ *   -threshold=P     The allowed regression in percent, 10 by default
+ *   -savebaseline    Writes the results as the new baseline instead of comparing to it
+ *   -GridSimCountAllocations  Counts the heap allocations, the results report none otherwise
+ */
+UCLASS()
+class GRIDAISIM_API UGS_SimBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGS_SimBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
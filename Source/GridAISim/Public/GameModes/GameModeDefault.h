@@ -5,7 +5,10 @@
 #include "CoreMinimal.h"
 #include "GameFramework/GameModeBase.h"
 #include "StaticData.h"
-#include "Grid/Grid.h"
+#include "Simulation/GridSimulation.h"
+#include "Simulation/SimCheckpoints.h"
+#include "Simulation/SimReplay.h"
+#include "Simulation/SimulationThread.h"
 #include "GameModeDefault.generated.h"
 
 USTRUCT(Blueprintable)
@@ -17,7 +20,8 @@ struct GRIDAISIM_API FUnitsCountData
 	int32 UnitCount;
 };
 
-class AGS_GridTestActor;
+class AGS_CrowdRenderer;
+class UGS_GridDebugOverlayComponent;
 /**
  * 
  */
@@ -35,10 +39,46 @@ public:
 	
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	void SpawnActorAt(TSubclassOf<AGS_GameActorBase> ActorClass, FIntPoint GridPoint, ETeam Team);
 
 	UFUNCTION(BlueprintCallable, Category="Simulation Control", DisplayName="Start Simulation")
 	void K2_StartSimulation();
+
+	/**
+	 * Pauses the simulation. Start Simulation continues it.
+	 */
+	UFUNCTION(BlueprintCallable, Category="Simulation Control", DisplayName="Stop Simulation")
+	void K2_StopSimulation();
+
+	/**
+	 * Restores the state of the simulation at the end of the given step from the checkpoints and pauses it.
+	 * Start Simulation continues from the restored step.
+	 * @param Step The step to restore
+	 * @return False, if the step is not in the checkpoints buffer
+	 */
+	UFUNCTION(BlueprintCallable, Category="Simulation Control", DisplayName="Rewind To Step")
+	bool K2_RewindToStep(int32 Step);
+
+	UFUNCTION(BlueprintPure, Category="Simulation Control", DisplayName="Get Simulation Step")
+	int32 K2_GetSimulationStep() const;
+
+	/**
+	 * Replaces the simulated units with the ones from the replay and plays the recorded events back,
+	 * without running the simulation
+	 * @param ReplayName The name of the replay in the Saved/Replays folder
+	 * @return False, if the replay can't be played on this grid
+	 */
+	UFUNCTION(BlueprintCallable, Category="Simulation Control", DisplayName="Start Replay Playback")
+	bool K2_StartReplayPlayback(const FString& ReplayName);
+
+	/**
+	 * Checks the instances of the crowd renderer against the simulated units. Works without rendering.
+	 * @return False, if the crowd mode is off, or the instances don't match the units
+	 */
+	UFUNCTION(BlueprintCallable, Category="Simulation Control", DisplayName="Validate Crowd Instances")
+	bool K2_ValidateCrowdInstances() const;
 	
 protected:
 	
@@ -78,9 +118,10 @@ protected:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings")
 	TArray<FUnitsCountData> ActorClasses;
 	 */
-	// The subclass to be used for the simulation. It's just a single class at the moment tho
+	
+	// The number of actors of each class to spawn into the actor pool before the simulation
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings")
-	TSubclassOf<AGS_GridTestActor> GridActorDummyClass;
+	TMap<TSubclassOf<AGS_GameActorBase>, int32> ActorPoolPrewarmCounts;
 	
 	// Minimum Attack power that will be used for random AttackPower setup
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings|ActorsSetting|Attack")
@@ -97,6 +138,41 @@ protected:
 	// TimeStep duration that will be used for simulation.
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings")
 	float SimulationTimeStep_ms = 0.1f;
+
+	// How much further (in grid cells) the cached target may be compared to the closest possible opponent,
+	// before the full closest opponent search is triggered again
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings", meta = (ClampMin = "0"))
+	float TargetHysteresisCells = 1.f;
+
+	// Whether the state of every step should be stored for rewinding
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings|Checkpoints")
+	bool bRecordCheckpoints = true;
+
+	// The number of steps between the full checkpoints. The steps in between are stored as deltas.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings|Checkpoints", meta = (ClampMin = "1"))
+	int32 CheckpointKeyframeInterval = 30;
+
+	// The maximum memory taken by the checkpoints. The oldest ones are dropped when it's exceeded.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings|Checkpoints", meta = (ClampMin = "1"))
+	int32 CheckpointMemoryCapKB = 4096;
+
+	// Whether the simulation should be recorded to a replay file
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings|Replay")
+	bool bRecordReplay = false;
+
+	// The name of the recorded replay in the Saved/Replays folder
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings|Replay")
+	FString ReplayName = TEXT("LastBattle");
+
+	// Whether the units should be drawn as instanced static meshes, instead of own skeletal meshes.
+	// Meant for the large unit counts.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings|Rendering")
+	bool bUseInstancedCrowd = false;
+
+	// Whether the simulation steps should run on their own thread, so their cost doesn't add to the frame time.
+	// The actors follow the latest state published by the thread.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="GameSettings|Threading")
+	bool bRunSimulationOnThread = false;
 	
 
 private:
@@ -110,11 +186,37 @@ private:
 	 */
 	void StartSimulation();
 
+	/**
+	 * Pauses the simulation
+	 */
+	void StopSimulation();
+
 	/**
 	 * Ends the simulation
 	 */
 	void EndSimulation(/*EReason*/);
-	void IsSimulationOver();
+
+	/**
+	 * Hands the simulation over to the simulation thread and starts stepping it there
+	 * @return False, if the thread can't be launched
+	 */
+	bool LaunchSimulationThread();
+
+	/**
+	 * Stops the simulation thread, if it's launched, and applies its last results.
+	 * The simulation can be used on the game thread again afterwards.
+	 */
+	void ShutdownSimulationThread();
+
+	/**
+	 * Binds the actors of the units spawned by the simulation thread and applies the latest published frame
+	 */
+	void ConsumeSimulationThreadResults();
+
+	/**
+	 * Plays the difference between the applied frame and the given one on the actors
+	 */
+	void ApplySimulationFrame(const FSimFrame& InFrame);
 
 	/**
 	 * Or rather a Step, not a turn.. A simulation iteration functional unit.
@@ -122,19 +224,58 @@ private:
 	void MakeSimulationTurn();
 
 	/**
-	 * Find the closest opponent
-	 * @param InActor An actor to look opponents for
-	 * @param OutDistanceSqr Square distance to the found opponent 
-	 * @return Pointer to the found opponent
+	 * Plays the events of a simulation step on the actors: the moves, the attacks, the hits and the deaths.
+	 * Shared by the simulation and the replay playback, which forget the actors of the killed units afterwards.
+	 * @param InEvents The events of the step
+	 * @param InDamagedUnits The units that were hit during the step
+	 * @param InGetActor Returns the actor of the unit handle, or nullptr
+	 * @param InGetHealth Returns the health of the damaged unit after the step
+	 * @param InStepDuration The duration of the step, for the movement interpolation
 	 */
-	AGS_GameActorBase* FindClosestActor(AGS_GameActorBase* InActor, int32& OutDistanceSqr);
-	
-	void ActorAttack(AGS_GameActorBase* InTargetActor, AGS_GameActorBase* InInstigatorActor);
+	void ApplyStepEvents(const FSimStepEvents& InEvents, TConstArrayView<FUnitHandle> InDamagedUnits,
+	                     TFunctionRef<AGS_GameActorBase*(FUnitHandle)> InGetActor,
+	                     TFunctionRef<float(FUnitHandle)> InGetHealth, float InStepDuration);
 
-	FIntPoint GetNextMoveLocation(AGS_GameActorBase* InActionActor, AGS_GameActorBase* InTargetActor, const FGrid& InGrid);
-	void ActorMoveTowards(AGS_GameActorBase* InTargetActor, AGS_GameActorBase* InInstigatorActor);
+	/**
+	 * @return The actor presenting the simulated unit, or nullptr
+	 */
+	AGS_GameActorBase* GetUnitActor(FUnitHandle InHandle) const;
 
-	void HandleActorKilled(AGS_GameActorBase* InTargetActor, AGS_GameActorBase* InInstigatorActor);
+	/**
+	 * Replaces the current units with the ones stored in the checkpoint of the step.
+	 * The actors of the units that are still alive are reused, the rest are spawned again.
+	 */
+	bool RewindToStep(int32 InStep);
+
+	/**
+	 * Takes an actor of the class from the actor pool and places it at the grid coordinates
+	 */
+	AGS_GameActorBase* AcquireUnitActor(TSubclassOf<AGS_GameActorBase> InClass, const FIntPoint& InCoordinates);
+
+	/**
+	 * Returns the actor to the actor pool
+	 */
+	void ReleaseUnitActor(AGS_GameActorBase* InActor);
+
+	FString GetReplayFilePath(const FString& InReplayName) const;
+
+	/**
+	 * Writes the current units to the replay header and starts recording the steps.
+	 * The units spawned later are not in the replay, see GS_ReplayRecorder.
+	 */
+	void BeginReplayRecording();
+
+	bool StartReplayPlayback(const FString& InReplayName);
+
+	/**
+	 * Applies the events of the next recorded step to the replay actors
+	 */
+	void MakeReplayPlaybackStep();
+
+	/**
+	 * Pushes the transforms and states of the units, or of the replay actors during the playback, to the crowd renderer
+	 */
+	void UpdateCrowdRenderer();
 	
 	/**
 	 * A conversion method to receive Global coordinates from the Grid Coordinates
@@ -145,27 +286,103 @@ private:
 	FVector GridToGlobal(const FIntPoint& GridCoordinates ) const;
 
 	/**
-	 * Spawns info actors at each Grid cell
+	 * @return The point of the grid at the index. While the simulation thread owns the grid, the point is read
+	 * from the grid of the applied frame.
+	 */
+	const FGridPoint& GetGridPoint(int32 InCellIndex) const;
+
+	/**
+	 * Applies the GridSim.DebugOverlay console variable to the debug overlay
+	 */
+	void UpdateDebugOverlayLayers();
+
+	/**
+	 * Redraws the occupancy layer of the debug overlay. Does nothing while the overlay is off.
+	 */
+	void UpdateDebugOverlay();
+
+	/**
+	 * Registers the spawned actor as a simulation unit
 	 */
-	void TestGrid();
+	void RegisterUnit(AGS_GameActorBase* InActor);
+
+	/**
+	 * @return The simulation state of the unit presented by the actor
+	 */
+	FUnitState MakeUnitState(const AGS_GameActorBase* InActor) const;
+
+	/**
+	 * Makes the actor present the registered unit
+	 */
+	void SetUnitActor(FUnitHandle InHandle, AGS_GameActorBase* InActor);
+
+	/**
+	 * Remembers the class of the registered unit, to spawn it back when rewinding. Grows the arrays indexed
+	 * by the unit handles to fit the handle.
+	 */
+	void SetUnitClass(FUnitHandle InHandle, TSubclassOf<AGS_GameActorBase> InClass);
 
 	// TODO: Move it to GameState.
-	// An array of Game Actors.
-	TArray<class AGS_GameActorBase*> GameActors;
+	// The grid and the units on it
+	FGridSimulation Simulation;
+
+	// Runs the simulation steps, when bRunSimulationOnThread is set. Owns the simulation while it's launched.
+	FGridSimulationThread SimulationThread{Simulation};
+
+	// The latest frame of the simulation thread played on the actors
+	FSimFrame AppliedFrame;
+
+	// The difference between the applied frame and the next one. Kept as members to reuse the allocations.
+	FSimStepEvents FrameStepEvents;
+	TArray<FUnitHandle> FrameDamagedUnits;
 
-	TMap<ETeam, int32> ActorsNumPerTeam;
+	// The actors spawned while the simulation thread runs, waiting for their unit handles. Keyed by the spawn requests.
+	UPROPERTY(Transient)
+	TMap<int32, TObjectPtr<AGS_GameActorBase>> PendingSpawnActors;
+	int32 NextSpawnRequest = 0;
 
-	// An array of Game Actors pending to be destroyed.
-	TArray<class AGS_GameActorBase*> KilledGameActors;
+	// The spawn results, which units aren't in the applied frame yet
+	TArray<FSimSpawnResult> PendingSpawnResults;
 
-	// The grid
-	FGrid Grid;
+	// The actors presenting the simulated units, indexed by the unit handles
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AGS_GameActorBase>> UnitActors;
+
+	// The classes of the units, indexed by the unit handles. Used to spawn the units back when rewinding.
+	TArray<TSubclassOf<AGS_GameActorBase>> UnitClasses;
+
+	// The states of the previous steps
+	GS_SimCheckpoints Checkpoints;
+
+	GS_ReplayRecorder ReplayRecorder;
+	GS_ReplayPlayer ReplayPlayer;
+
+	// The actors spawned for the replay playback, indexed by the recorded unit handles
+	TArray<TWeakObjectPtr<AGS_GameActorBase>> ReplayActors;
+
+	// The events of the replayed step
+	FSimStepEvents ReplayStepEvents;
+
+	// A bool flag to check if a replay is being played
+	bool bReplayPlaybackOngoing = false;
+
+	// Draws the units in the instanced crowd mode
+	UPROPERTY()
+	TObjectPtr<AGS_CrowdRenderer> CrowdRenderer;
+
+	// Draws the grid, the occupancy, the paths and the fields for debugging
+	UPROPERTY(VisibleAnywhere, Category="Debug")
+	TObjectPtr<UGS_GridDebugOverlayComponent> DebugOverlay;
+
+	// The last applied value of GridSim.DebugOverlay
+	int32 DebugOverlayLayerMask = 0;
+
+	// The values of the field layer of the debug overlay, kept to reuse the allocation
+	TArray<float> DebugFieldValues;
 
 	// A bool flag to check if simulation is active
 	bool bSimulationOngoing = false;
 
 	// A counter to accumulate delta time from ticks to simulate TimeSteps
 	float TimeStepAccumulator = 0.f;
-
-	TPimplPtr<class GS_Pathfinder> Pathfinder;
 };
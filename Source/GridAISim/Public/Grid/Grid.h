@@ -3,6 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Simulation/UnitRegistry.h"
 
 enum class EGridType
 {
@@ -18,19 +19,56 @@ enum class EGridType
 struct FGridPoint
 {
 	FIntPoint GridCoords;
-	TObjectPtr<class AGS_GameActorBase> GameActor = nullptr;
+	// The unit standing on the point
+	FUnitHandle Unit = INDEX_NONE;
 	int32 Index = 0;
+	// Obstacles can't be entered by any unit
+	bool bIsObstacle = false;
+	// The side of the largest obstacle-free square with the point as its minimum corner, capped by FGrid::MaxClearance.
+	// Zero for the obstacles.
+	uint8 Clearance = 0;
+	// The label of the connected area of the obstacle-free points the point belongs to, INDEX_NONE for the obstacles
+	int32 Component = INDEX_NONE;
 	
 	FString GetDebugString() const;
 
+	/**
+	 * @return True, if a unit can move onto the point
+	 */
+	bool IsFree() const
+	{
+		return Unit == INDEX_NONE && !bIsObstacle;
+	}
+
 	bool operator==(const FGridPoint& InPoint) const
 	{
 		return GridCoords == InPoint.GridCoords;
 	}
 };
 
+/**
+ * A change of a single grid point, recorded in the change journal of the grid.
+ */
+struct FGridChange
+{
+	enum class EType : uint8
+	{
+		// The unit standing on the point has changed
+		Occupancy,
+		// The point became an obstacle, or stopped being one
+		Obstacle
+	};
+
+	FIntPoint Point = FIntPoint::ZeroValue;
+	EType Type = EType::Occupancy;
+};
+
 /**
  * The struct (but rather a class already) to represent the grid.
+ *
+ * The occupancy and the obstacles are changed through SetUnit and SetObstacle only. Every change bumps the epoch
+ * of the grid, goes to the change journal and marks its tile dirty, so the data derived from the grid can be updated
+ * by the changes instead of being rebuilt.
  */
 struct FGrid
 {
@@ -54,17 +92,10 @@ struct FGrid
 	 * @param Index Element index
 	 * @return Element at index
 	 */
-	FGridPoint& At(int32 Index);
-
-	/**
-	 * Get Grid element by coordinates
-	 * @param Coordinates Element coordinates
-	 * @return Element at coordinates
-	 */
-	FGridPoint& At(FIntPoint Coordinates);
+	const FGridPoint& At(int32 Index) const;
 
 	/**
-	 * Get Grid element by coordinates. Constant version
+	 * Get Grid element by coordinates. The points are only changed by SetUnit and SetObstacle, which journal the changes.
 	 * @param Coordinates Element coordinates
 	 * @return Element at coordinates
 	 */
@@ -82,19 +113,145 @@ struct FGrid
 
 	EGridType GetGridType() const;
 
+	FIntPoint GetSize() const;
+
+	// The side of the square tiles the dirty points are tracked by
+	static constexpr int32 ChangeTileSize = 16;
+
+	/**
+	 * Puts the unit on the point, or clears the point with INDEX_NONE
+	 */
+	void SetUnit(const FIntPoint& Point, FUnitHandle Unit);
+
+	/**
+	 * @return The number of the changes made to the grid so far. Init counts as a change of every point.
+	 */
+	uint32 GetEpoch() const;
+
+	/**
+	 * Collects the changes made since the given epoch, in their order
+	 * @return False, if the journal no longer reaches that far back, and the caller has to rebuild
+	 */
+	bool GetChangesSince(uint32 Epoch, TConstArrayView<FGridChange>& OutChanges) const;
+
+	/**
+	 * @return The changes made since the journal was reset the last time
+	 */
+	TConstArrayView<FGridChange> GetChanges() const;
+
+	/**
+	 * @return A bit per tile of ChangeTileSize points a side, row by row, set for the tiles changed
+	 * since the journal was reset the last time
+	 */
+	const TBitArray<>& GetDirtyTiles() const;
+
+	/**
+	 * Empties the change journal and clears the dirty tiles. The simulation does it once per step.
+	 */
+	void ResetChanges();
+
+	/**
+	 * Marks the point as an obstacle, or clears the mark. Updates the clearance of the points around.
+	 */
+	void SetObstacle(const FIntPoint& Point, bool bIsObstacle);
+
+	/**
+	 * @return The clearance of the point, zero if the point is off the grid
+	 */
+	int32 GetClearance(const FIntPoint& Point) const;
+
+	/**
+	 * @return True, if a square footprint of the given side with its minimum corner at the point has no obstacles.
+	 * The units standing in the footprint are not taken into account.
+	 */
+	bool CanFit(const FIntPoint& Point, int32 FootprintSize) const;
+
+	/**
+	 * Labels the connected areas of the obstacle-free points again, if the obstacles have changed since the last time
+	 */
+	void UpdateComponents();
+
+	/**
+	 * @return False, if no path around the obstacles leads from one point to the other. The units don't disconnect
+	 * the points. While the labels are out of date, any two points on the grid are considered connected.
+	 */
+	bool AreConnected(const FIntPoint& PointA, const FIntPoint& PointB) const;
+
+	/**
+	 * @return False, if the obstacles have changed since the connected areas were labeled the last time
+	 */
+	bool AreComponentsUpToDate() const;
+
+	/**
+	 * @return A number that changes every time the obstacles change, so the data derived from the obstacles
+	 * can tell it's out of date. Never zero.
+	 */
+	uint32 GetObstacleVersion() const;
+
 	TArray<FGridPoint> GetNodeConnections(const FGridPoint& Point) const;
 
+	/**
+	 * @return The coordinate offsets of the neighbors of a point, which depend on the grid type
+	 */
+	TConstArrayView<FIntPoint> GetNeighborOffsets() const;
+
+	/**
+	 * Calls InFunc(const FGridPoint&) for every neighbor of the point. Unlike GetNodeConnections, doesn't allocate.
+	 */
+	template <typename FuncType>
+	void ForEachNeighbor(const FIntPoint& Point, FuncType&& InFunc) const
+	{
+		for (const FIntPoint& Offset : NeighborOffsets)
+		{
+			const FIntPoint Neighbor = Point + Offset;
+			if (IsPointOnGrid(Neighbor))
+			{
+				InFunc(At(Neighbor));
+			}
+		}
+	}
+
 	bool IsPointOnGrid(const FIntPoint& Point) const;
 
 	// These two methods should be called before and after the spawning of actors
 	// TODO: consider moving the spawning functionality to under the grid responsibility, or under some generator class
 	void OnStartSpawningActors();
 	void OnFinishSpawningActors();
+
+	// The largest footprint the clearance is tracked for. Bounds the cost of updating the clearance of an obstacle.
+	static constexpr int32 MaxClearance = 8;
+
 private:
+	/**
+	 * The writable point, for the methods keeping the journal and the derived data in sync with the changes
+	 */
+	FGridPoint& GetMutablePoint(const FIntPoint& Coordinates);
+
+	/**
+	 * Recomputes the clearance of the points in the rectangle, from the maximum corner to the minimum one,
+	 * as the clearance of a point depends on the points after it
+	 */
+	void UpdateClearance(const FIntPoint& Min, const FIntPoint& Max);
+
+	void RecordChange(const FIntPoint& Point, FGridChange::EType Type);
+
 	TArray<FGridPoint> GridArray;
 	int32 SizeX = 0;
 	int32 SizeY = 0;
 	EGridType GridType = EGridType::None;
+	TConstArrayView<FIntPoint> NeighborOffsets;
+
+	// Set by the obstacle changes, cleared by UpdateComponents
+	bool bComponentsDirty = true;
+	uint32 ObstacleVersion = 0;
+	TArray<int32> ComponentQueue;
+
+	// Journal[Index] is the change which made the epoch JournalEpoch + Index + 1
+	TArray<FGridChange> Journal;
+	uint32 JournalEpoch = 0;
+	uint32 Epoch = 0;
+	TBitArray<> DirtyTiles;
+	int32 NumTilesX = 0;
 
 	// Should be populated before and cleared after the spawning stage 
 	mutable TArray<FGridPoint> EmptyPoints;
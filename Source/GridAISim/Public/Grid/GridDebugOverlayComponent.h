@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Components/LineBatchComponent.h"
+#include "GridDebugOverlayComponent.generated.h"
+
+/**
+ * The layers of the grid debug overlay. The values are the bits of the GridSim.DebugOverlay console variable.
+ */
+enum class EGridDebugLayer : uint8
+{
+	Grid = 0,
+	Occupancy,
+	Paths,
+	Field,
+	MAX
+};
+
+/**
+ * Draws the debug view of the grid: the grid lines, the occupied cells, the paths and a per-cell scalar field.
+ *
+ * Every layer keeps its own lines and is rebuilt only when it's changed, then all the enabled layers are submitted to
+ * a single line batch component in one go. The line batch component only exists while any layer is enabled,
+ * and the layers don't collect anything while disabled, so the overlay costs nothing when it's off.
+ */
+UCLASS(ClassGroup=(Debug), meta=(BlueprintSpawnableComponent))
+class GRIDAISIM_API UGS_GridDebugOverlayComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UGS_GridDebugOverlayComponent();
+
+	/**
+	 * Sets the geometry of the grid and rebuilds the grid layer
+	 * @param InSizeX The X size of the grid
+	 * @param InSizeY The Y size of the grid
+	 * @param InCellSize The size of the grid cells in the world coordinates
+	 */
+	void SetGrid(int32 InSizeX, int32 InSizeY, float InCellSize);
+
+	/**
+	 * Enables the layers by the bitmask of EGridDebugLayer values, disabling the rest
+	 */
+	void SetEnabledLayers(uint32 InLayerMask);
+
+	bool IsLayerEnabled(EGridDebugLayer InLayer) const;
+
+	/**
+	 * @return True, if any of the layers is enabled
+	 */
+	bool IsEnabled() const;
+
+	void ClearLayer(EGridDebugLayer InLayer);
+
+	/**
+	 * Marks the cell with a cross on the occupancy layer
+	 */
+	void AddOccupiedCell(const FIntPoint& InCoordinates, const FColor& InColor);
+
+	/**
+	 * Adds the path through the cells to the paths layer, which keeps the paths until the layer is cleared
+	 */
+	void AddPath(TArrayView<const FIntPoint> InPath, const FColor& InColor);
+
+	/**
+	 * Replaces the field layer with a vertical bar per cell, which height and color follow the value of the cell.
+	 * The cells with the values at or below InMinValue are skipped.
+	 * @param InValues The values of the cells, indexed the same way as the grid points
+	 * @param InMinValue The value drawn as the shortest blue bar
+	 * @param InMaxValue The value drawn as the tallest red bar
+	 */
+	void SetScalarField(TArrayView<const float> InValues, float InMinValue, float InMaxValue);
+
+	/**
+	 * Submits the changed layers to the line batch. Call it once, after all the changes of the frame.
+	 */
+	void FlushLayers();
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void RebuildGridLayer();
+	FVector CellToWorld(const FIntPoint& InCoordinates) const;
+	FIntPoint IndexToCell(int32 InIndex) const;
+
+	struct FDebugLayer
+	{
+		TArray<FBatchedLine> Lines;
+		bool bIsEnabled = false;
+	};
+
+	UPROPERTY(Transient)
+	TObjectPtr<ULineBatchComponent> LineBatch;
+
+	FDebugLayer Layers[StaticCast<int32>(EGridDebugLayer::MAX)];
+
+	// Whether the line batch should be refilled on the next flush
+	bool bIsDirty = false;
+
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+	float CellSize = 1.f;
+};
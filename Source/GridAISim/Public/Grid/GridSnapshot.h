@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Grid/Grid.h"
+
+class FGridSnapshot;
+
+using FGridSnapshotRef = TSharedRef<const FGridSnapshot, ESPMode::ThreadSafe>;
+using FGridSnapshotPtr = TSharedPtr<const FGridSnapshot, ESPMode::ThreadSafe>;
+
+/**
+ * An immutable copy of the grid at some epoch, which any thread may read without locks while the grid changes.
+ *
+ * The points are kept in the tiles of FGrid::ChangeTileSize points a side. A new snapshot copies only the tiles
+ * the change journal of the grid names since the previous snapshot, and shares the rest with it. The obstacle changes
+ * reach the clearance and the connectivity of the points far away, so they make a full copy.
+ * The tiles are reference counted: a tile is freed once no snapshot still held by a reader shares it,
+ * so the writer never waits for the readers.
+ */
+class GRIDAISIM_API FGridSnapshot
+{
+public:
+	/**
+	 * Makes a snapshot of the current state of the grid. The grid must not change meanwhile.
+	 * @param InPrevious The snapshot of the same grid to share the unchanged tiles with, may be null
+	 */
+	static FGridSnapshotRef Create(const FGrid& InGrid, const FGridSnapshot* InPrevious);
+
+	/**
+	 * @return The epoch of the grid the snapshot was made at
+	 */
+	uint32 GetEpoch() const;
+
+	FIntPoint GetSize() const;
+
+	EGridType GetGridType() const;
+
+	bool IsPointOnGrid(const FIntPoint& Point) const;
+
+	/**
+	 * Get the element by coordinates, which have to be on the grid
+	 */
+	const FGridPoint& At(const FIntPoint& Point) const;
+
+	/**
+	 * Get the element by its index on the grid, which has to be valid
+	 */
+	const FGridPoint& At(int32 Index) const;
+
+	/**
+	 * @return The same as FGrid::AreConnected at the epoch of the snapshot
+	 */
+	bool AreConnected(const FIntPoint& PointA, const FIntPoint& PointB) const;
+
+	/**
+	 * Calls InFunc(const FGridPoint&) for every neighbor of the point, the same way FGrid::ForEachNeighbor does
+	 */
+	template <typename FuncType>
+	void ForEachNeighbor(const FIntPoint& Point, FuncType&& InFunc) const
+	{
+		for (const FIntPoint& Offset : NeighborOffsets)
+		{
+			const FIntPoint Neighbor = Point + Offset;
+			if (IsPointOnGrid(Neighbor))
+			{
+				InFunc(At(Neighbor));
+			}
+		}
+	}
+
+	/**
+	 * @return The number of the tiles shared with the other snapshot, e.g. to see how much publishing copies
+	 */
+	int32 NumSharedTiles(const FGridSnapshot& InOther) const;
+
+private:
+	// The points of a tile, row by row. The tiles on the edges are padded to the full size.
+	using FTile = TArray<FGridPoint>;
+	using FTileRef = TSharedRef<const FTile, ESPMode::ThreadSafe>;
+
+	FGridSnapshot() = default;
+
+	/**
+	 * @return True, if the tiles of the previous snapshot may be shared, and the changed ones are marked
+	 */
+	static bool CollectChangedTiles(const FGrid& InGrid, const FGridSnapshot& InPrevious,
+	                                TBitArray<>& OutChangedTiles);
+
+	static FTileRef CopyTile(const FGrid& InGrid, int32 InTileX, int32 InTileY);
+
+	TArray<FTileRef> Tiles;
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+	int32 NumTilesX = 0;
+	EGridType GridType = EGridType::None;
+	TConstArrayView<FIntPoint> NeighborOffsets;
+
+	uint32 Epoch = 0;
+	uint32 ObstacleVersion = 0;
+
+	// Copied from a grid with the out of date connectivity, which connects everything then
+	bool bComponentsUpToDate = false;
+};
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FGrid;
+
+/**
+ * The distances in steps from a few landmark points to every point of the grid, for the ALT heuristic
+ * (A*, landmarks, triangle inequality): the path between two points is at least as long as the difference
+ * of their distances to any landmark. Around the obstacles this is much closer to the real length
+ * than the straight line, so A* expands far fewer nodes.
+ *
+ * The distances go around the obstacles only, the units are ignored, the same as by FGrid::AreConnected.
+ */
+class GRIDAISIM_API FGridLandmarks
+{
+public:
+	static constexpr int32 MaxLandmarks = 16;
+
+	// The distance to the points that no path leads to. The longer distances are saturated below it.
+	static constexpr uint16 Unreachable = MAX_uint16;
+
+	using FDistances = TArray<uint16, TInlineAllocator<MaxLandmarks>>;
+
+	/**
+	 * Places the landmarks evenly along the grid borders and computes their distances, a landmark per worker
+	 * @param InNumLandmarks Up to MaxLandmarks, zero frees the tables
+	 */
+	void Build(const FGrid& InGrid, int32 InNumLandmarks);
+
+	/**
+	 * @return True, if the tables were built for the current obstacles of the grid
+	 */
+	bool IsUpToDate(const FGrid& InGrid) const;
+
+	int32 Num() const;
+
+	/**
+	 * Copies the distances from all the landmarks to the point, to estimate many points against it
+	 */
+	void GetDistances(int32 InPointIndex, FDistances& OutDistances) const;
+
+	/**
+	 * @return The lower bound of the number of steps between the point and the one the distances were taken for
+	 */
+	int32 Estimate(int32 InPointIndex, const FDistances& InGoalDistances) const;
+
+private:
+	// The distances of a point to all the landmarks go together, so an estimate reads a single cache line.
+	// Indexed by FGridPoint::Index * NumLandmarks + the landmark.
+	TArray<uint16> Distances;
+	TArray<FIntPoint> Landmarks;
+	int32 NumLandmarks = 0;
+
+	uint32 ObstacleVersion = 0;
+};
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Identifies a path stored in FPathArena. Invalid after the path is freed, and may be reused by the later paths.
+ */
+using FPathHandle = int32;
+
+/**
+ * Shared storage of many paths over the grid.
+ *
+ * A path is kept as its start point followed by a 3-bit code per step: the direction to the next point, out of the 8
+ * neighbors. That's ten steps per 32-bit word, against 12 bytes per point of TArray<Path::FNode>. The freed words
+ * are reclaimed by moving the live paths together once they make up half of the arena, so the arena stops growing
+ * (and allocating) as soon as it fits the paths kept at once.
+ */
+class GRIDAISIM_API FPathArena
+{
+public:
+	static constexpr int32 BitsPerStep = 3;
+	static constexpr int32 StepsPerWord = 32 / BitsPerStep;
+
+	/**
+	 * Decodes the points of a path one by one, from the start to the end.
+	 * Invalidated by adding the paths to the arena and by freeing them.
+	 */
+	class GRIDAISIM_API FConstIterator
+	{
+	public:
+		FConstIterator(const FPathArena& InArena, FPathHandle InPath);
+
+		FConstIterator& operator++();
+
+		explicit operator bool() const
+		{
+			return StepIndex <= NumSteps;
+		}
+
+		const FIntPoint& operator*() const
+		{
+			return Point;
+		}
+
+	private:
+		const uint32* Words = nullptr;
+		FIntPoint Point = FIntPoint::ZeroValue;
+		int32 StepIndex = 0;
+		// INDEX_NONE for an invalid path, so the iterator is over at once
+		int32 NumSteps = INDEX_NONE;
+	};
+
+	/**
+	 * Stores the path
+	 * @param InPoints The points of the path, each one a neighbor of the previous one
+	 * @return The handle of the path, or INDEX_NONE if the path is empty or has gaps
+	 */
+	FPathHandle Add(TConstArrayView<FIntPoint> InPoints);
+
+	/**
+	 * Frees the path, e.g. when its owner plans a new one
+	 */
+	void Free(FPathHandle InPath);
+
+	/**
+	 * Frees all the paths, keeping the memory
+	 */
+	void Reset();
+
+	bool IsValid(FPathHandle InPath) const;
+
+	/**
+	 * @return The number of the points of the path, the start included
+	 */
+	int32 Num(FPathHandle InPath) const;
+
+	/**
+	 * @return The point of the path at the index, which is decoded from the start. Zero for the invalid paths.
+	 */
+	FIntPoint GetPoint(FPathHandle InPath, int32 InIndex) const;
+
+	FConstIterator CreateConstIterator(FPathHandle InPath) const;
+
+	/**
+	 * @return The memory taken by the arena, in bytes
+	 */
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	struct FPathRecord
+	{
+		FIntPoint Start = FIntPoint::ZeroValue;
+		int32 FirstWord = 0;
+		// INDEX_NONE for the freed records
+		int32 NumSteps = INDEX_NONE;
+
+		int32 NumWords() const
+		{
+			return FMath::DivideAndRoundUp(NumSteps, StepsPerWord);
+		}
+	};
+
+	/**
+	 * Moves the words of the live paths to the front of the arena
+	 */
+	void Compact();
+
+	TArray<FPathRecord> Records;
+	TArray<FPathHandle> FreeRecords;
+	TArray<uint32> Words;
+
+	// The words of the freed paths, which are reclaimed by Compact
+	int32 NumFreeWords = 0;
+
+	// The live records in the order of their words, kept to reuse the memory
+	TArray<FPathHandle> CompactOrder;
+};
@@ -4,7 +4,11 @@
 
 #include "CoreMinimal.h"
 #include "Grid.h"
+#include "Grid/GridSnapshot.h"
+#include "Grid/Landmarks.h"
+#include "Grid/PathArena.h"
 #include "GridAISim/GridAISim.h"
+#include "Simulation/SimStats.h"
 
 struct FGrid;
 
@@ -55,7 +59,7 @@ namespace Path
 		}
 		~FNodeRecord()
 		{
-			UE_LOG(LogSim, Display, TEXT("Node Record for %s is deconstructed."), *Node.XY.ToString());
+			GRIDSIM_LOG(VeryVerbose, TEXT("Node Record for %s is deconstructed."), *Node.XY.ToString());
 		}
 		
 		float HeuristicValue = 0.f;
@@ -97,17 +101,49 @@ namespace Path
 		bool operator()(const FNodeRecord& LeftRecord, const FNodeRecord& RightRecord) const;
 	};
 
+	/**
+	 * Reads either the grid itself, or a snapshot of it. A graph over a snapshot may be searched on any thread
+	 * while the grid changes.
+	 */
 	struct GRIDAISIM_API FGraph
 	{
 		FGraph(const FGrid& InGrid)
-			: GridRef(InGrid)
+			: GridRef(&InGrid)
+		{
+		}
+
+		FGraph(const FGridSnapshotRef& InSnapshot)
+			: Snapshot(InSnapshot)
 		{
 		}
 
 		TArray<FConnection> GetNodeConnections(const FNodeRecord& InNodeRecord) const;
 		TArray<FNode> GetNodeConnections(const FNode& InNode) const;
 
-		const FGrid& GridRef;
+		/**
+		 * Fills the array with the neighbors of the node, reusing its memory. No grid has more than 8 neighbors.
+		 * @param InFootprintSize The side of the square the moving unit takes. The neighbors that can't fit it
+		 * are unreachable. The obstacles cost a single clearance lookup per neighbor, the units a lookup per cell
+		 * of the footprint.
+		 * @param bInIgnoreUnits Only the obstacles make the neighbors unreachable
+		 * @param InMover The moving unit, which cells don't block its own footprint
+		 */
+		void GetNodeConnections(const FNode& InNode, TArray<FNode, TInlineAllocator<8>>& OutNodes,
+		                        int32 InFootprintSize = 1, bool bInIgnoreUnits = false,
+		                        FUnitHandle InMover = INDEX_NONE) const;
+
+		/**
+		 * @return True, if no unit but the mover stands in the square footprint with its minimum corner at the point
+		 */
+		bool IsFootprintFree(const FIntPoint& InPoint, int32 InFootprintSize, FUnitHandle InMover) const;
+
+		bool IsPointOnGrid(const FIntPoint& InPoint) const;
+		const FGridPoint& At(const FIntPoint& InPoint) const;
+		bool AreConnected(const FIntPoint& InPointA, const FIntPoint& InPointB) const;
+
+		// Null for the graphs over a snapshot
+		const FGrid* GridRef = nullptr;
+		FGridSnapshotPtr Snapshot;
 	};
 }
 
@@ -119,14 +155,89 @@ class GRIDAISIM_API GS_Pathfinder
 public:
 	GS_Pathfinder() = default;
 
+	// Owns the records of the searches
+	GS_Pathfinder(const GS_Pathfinder&) = delete;
+	GS_Pathfinder& operator=(const GS_Pathfinder&) = delete;
+
 	void InitGraph(const FGrid& InGrid);
 
-	TArray<Path::FNode> FindPath(const Path::FNode& StartNode, const Path::FNode& EndNode);
+	/**
+	 * Makes the searches read the snapshot instead of the grid, so they may run on a thread of their own.
+	 * Every thread needs a pathfinder of its own, as the records of the searches are kept in the pathfinder.
+	 * The landmarks are only built for the grid itself, the searches over a snapshot use the plain heuristic.
+	 */
+	void InitGraph(const FGridSnapshotRef& InSnapshot);
+
+	/**
+	 * Finds a path for a unit taking a square of cells, with the nodes of the path being the minimum corner
+	 * of the square. The whole footprint is checked against the obstacles and the other units, the unit standing
+	 * on the start node is the one moving. No path is found from a start the footprint doesn't fit.
+	 * @param InFootprintSize The side of the square, up to FGrid::MaxClearance
+	 * @param bInIgnoreUnits The path may go through the cells taken by the units, e.g. for the paths planned
+	 * for a few steps ahead, as the units move away meanwhile
+	 */
+	TArray<Path::FNode> FindPath(const Path::FNode& StartNode, const Path::FNode& EndNode, int32 InFootprintSize = 1,
+	                             bool bInIgnoreUnits = false);
+
+	/**
+	 * The same search, with the path stored compactly in the arena instead of a new array
+	 * @return The handle of the path in the arena, or INDEX_NONE if no path could be found
+	 */
+	FPathHandle FindPath(const Path::FNode& StartNode, const Path::FNode& EndNode, FPathArena& OutPaths,
+	                     int32 InFootprintSize = 1, bool bInIgnoreUnits = false);
 	TArray<Path::FNode> GetNeighbors(const Path::FNode& InNode);
-	void VisualizePath(UWorld* World, TArray<Path::FNode> Array, float GridScale);
+
+	/**
+	 * Switches FindPath to the landmark (ALT) heuristic, which pays off on the maps with many obstacles.
+	 * The tables take two bytes per landmark per grid point.
+	 * @param InNumLandmarks Up to FGridLandmarks::MaxLandmarks, zero switches back to the plain heuristic
+	 */
+	void SetNumLandmarks(int32 InNumLandmarks);
+
+	/**
+	 * Rebuilds the landmark tables, if the obstacles changed since they were built. FindPath does it on demand,
+	 * this is to take the cost out of the first search.
+	 */
+	void UpdateLandmarks();
+
+	/**
+	 * Adds the path to the paths layer of the debug overlay, if the layer is enabled
+	 */
+	void VisualizePath(class UGS_GridDebugOverlayComponent* InOverlay, const FPathArena& InPaths,
+	                   FPathHandle InPath) const;
+
+	/**
+	 * @return The nodes expanded, heap operations and allocations made by FindPath since the last reset
+	 */
+	const FSimStepCounters& GetCounters() const;
+	void ResetCounters();
 
 	~GS_Pathfinder();
 
 private:
+	/**
+	 * Runs the A* search, the found path goes to PathPoints
+	 * @return False, if no path could be found
+	 */
+	bool SearchPath(const Path::FNode& InStartNode, const Path::FNode& InEndNode, int32 InFootprintSize,
+	                bool bInIgnoreUnits);
+
+	/**
+	 * @return A copy of the record, reusing one left by the previous searches if there is any
+	 */
+	Path::FNodeRecord* AcquireRecord(const Path::FNodeRecord& InRecord);
+
 	TUniquePtr<Path::FGraph> Graph;
+
+	// The open and closed records of the current search, and the ones free to reuse
+	TArray<Path::FNodeRecord*> SearchNodes;
+	TArray<Path::FNodeRecord*> FreeRecords;
+
+	// The points of the latest found path, from the start to the end
+	TArray<FIntPoint> PathPoints;
+
+	FGridLandmarks Landmarks;
+	int32 NumLandmarks = 0;
+
+	FSimStepCounters Counters;
 };
@@ -0,0 +1,267 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Grid/Grid.h"
+#include "Grid/GridSnapshot.h"
+#include "Simulation/InfluenceMap.h"
+#include "Simulation/PresenceTables.h"
+#include "Simulation/SimStats.h"
+#include "Simulation/SimStepEvents.h"
+#include "Simulation/SquadPlanner.h"
+#include "Simulation/TargetCache.h"
+#include "Simulation/UnitRegistry.h"
+#include "Simulation/UtilityAI.h"
+#include "Tasks/Task.h"
+
+class GS_Pathfinder;
+
+/**
+ * The simulation itself: the grid, the units on it and the rules of a step.
+ *
+ * Knows nothing about the actors, so it runs the same way in the game, in the commandlets and in the benchmarks.
+ * The outcome of every step is reported through the step events, the owner applies them to whatever presents the units.
+ */
+class GRIDAISIM_API FGridSimulation
+{
+public:
+	FGridSimulation();
+	~FGridSimulation();
+
+	FGridSimulation(const FGridSimulation&) = delete;
+	FGridSimulation& operator=(const FGridSimulation&) = delete;
+
+	/**
+	 * Creates an empty grid. All the units are removed.
+	 */
+	void Init(int32 InSizeX, int32 InSizeY, EGridType InGridType = EGridType::Rectangular);
+
+	/**
+	 * @param InHysteresisCells How much further (in grid cells) the cached target may be compared to the closest
+	 * possible opponent, before the full closest opponent search is triggered again
+	 */
+	void SetTargetHysteresis(float InHysteresisCells);
+
+	/**
+	 * Places a new unit on the grid
+	 * @return The handle of the unit, or INDEX_NONE if its cell isn't free
+	 */
+	FUnitHandle AddUnit(const FUnitState& InUnit);
+
+	/**
+	 * Places a unit under a previously issued handle, e.g. when restoring a checkpoint
+	 * @return False, if the handle is not available, or the cell isn't free
+	 */
+	bool RestoreUnit(FUnitHandle InHandle, const FUnitState& InUnit);
+
+	void RemoveUnit(FUnitHandle InHandle);
+
+	/**
+	 * Removes all the units, keeping the issued handles reserved
+	 */
+	void RemoveAllUnits();
+
+	/**
+	 * Replaces the actions the units choose from. By default, FUtilityEvaluator::MakeDefaultActions.
+	 */
+	void SetUtilityActions(TArray<FUtilityAction>&& InActions);
+
+	/**
+	 * Makes the units carry out the given actions in the next step instead of the ones the utility AI chooses,
+	 * e.g. for the policies trained against the simulation. The targets are still found by the simulation,
+	 * the units without one guard whatever their action is.
+	 * @param InActions Indexed by the unit handles, EUnitAction::MAX leaves the choice to the utility AI.
+	 * Not copied, so it has to stay valid until the next Step, which drops it.
+	 */
+	void SetExternalActions(TConstArrayView<EUnitAction> InActions);
+
+	/**
+	 * Makes a single simulation step: every unit picks the best scored action (attacking, approaching its target,
+	 * retreating, etc.) and carries it out, then the combat is resolved and the killed units are removed.
+	 * The events of the step are in GetStepEvents.
+	 * The intents are chosen from the state at the start of the step, by PrepareStep if it was called.
+	 */
+	void Step();
+
+	/**
+	 * Starts choosing the intents of the next step on the worker threads, so it overlaps with whatever the caller
+	 * does with the results of the previous step. Until the next Step the simulation should only be read:
+	 * the methods changing the units wait for the intents first, the grid should not be changed at all.
+	 */
+	void PrepareStep();
+
+	/**
+	 * @return True, if at most one team is left on the grid
+	 */
+	bool IsOver() const;
+
+	/**
+	 * Finds the closest opponent by going through all of them. The opponents walled off by the obstacles are skipped.
+	 * @param InUnit A unit to look opponents for
+	 * @param OutDistanceSqr Square distance to the found opponent
+	 * @return The handle of the found opponent, or INDEX_NONE
+	 */
+	FUnitHandle FindClosestUnit(FUnitHandle InUnit, int32& OutDistanceSqr) const;
+
+	/**
+	 * Finds the target for the unit, reusing the cached one while it stays valid, or falls back to FindClosestUnit
+	 * @param InUnit A unit to look opponents for
+	 * @param OutDistanceSqr Square distance to the found opponent
+	 * @return The handle of the found opponent, or INDEX_NONE
+	 */
+	FUnitHandle FindTarget(FUnitHandle InUnit, int32& OutDistanceSqr);
+
+	int32 GetStep() const;
+
+	/**
+	 * Sets the number of the steps made so far, e.g. after restoring a checkpoint
+	 */
+	void SetStep(int32 InStep);
+
+	const FGrid& GetGrid() const;
+	FGrid& GetGrid();
+
+	/**
+	 * Made on demand, by copying the parts of the grid changed since the previous snapshot. Called on the thread
+	 * making the steps, which hands the snapshot to the readers on the other threads.
+	 * @return An immutable copy of the grid as it is now, which stays the same while the next steps are made
+	 */
+	FGridSnapshotRef GetGridSnapshot();
+	const FUnitRegistry& GetUnits() const;
+
+	/**
+	 * @return The threat and the support of the teams over the grid, up to date with the units
+	 */
+	const FInfluenceMap& GetInfluence() const;
+
+	/**
+	 * @return The unit counts of the teams over the grid, as of the latest choice of the intents
+	 */
+	const FTeamPresenceTables& GetPresence() const;
+	GS_Pathfinder& GetPathfinder();
+
+	/**
+	 * Adds the paths of the squads to the paths layer of the debug overlay. The squads are planned again along with
+	 * the intents, so the decisions launched by PrepareStep are waited for, and their paths drawn.
+	 */
+	void VisualizeSquadPaths(class UGS_GridDebugOverlayComponent* InOverlay);
+
+	/**
+	 * @return The events of the latest step
+	 */
+	const FSimStepEvents& GetStepEvents() const;
+
+	/**
+	 * @return The units damaged by the latest step, the killed ones included
+	 */
+	const TArray<FUnitHandle>& GetDamagedUnits() const;
+
+	/**
+	 * @return The work done by the latest step
+	 */
+	const FSimStepCounters& GetStepCounters() const;
+
+private:
+	/**
+	 * Chooses the targets of all the units for the current step and scores their actions into the intent buffer.
+	 * Every unit only touches its own target, its own target cache entry and its own utility inputs,
+	 * so the units are processed in parallel. The grid is only read, its connectivity has to be up to date.
+	 * @param bInParallel False to keep the work on the calling thread
+	 */
+	void DecideIntents(bool bInParallel);
+
+	void WaitForDecisions();
+
+	/**
+	 * Drops the intents chosen for the step, as the units are about to change
+	 */
+	void InvalidateDecisions();
+
+	void Attack(FUnitHandle InUnit, FUnitHandle InTarget);
+	void MoveTowards(FUnitHandle InUnit, FUnitHandle InTarget);
+
+	/**
+	 * Attacks the target in range, or moves towards it. Both may have moved since the intent was chosen.
+	 */
+	void Engage(FUnitHandle InUnit, FUnitHandle InTarget);
+
+	/**
+	 * Attacks the weakest opponent in range, or engages the target if there is none
+	 */
+	void FocusFire(FUnitHandle InUnit, FUnitHandle InTarget);
+
+	/**
+	 * Moves to the free neighbor cell with the least threat, or stays if the current cell is the safest
+	 */
+	void Retreat(FUnitHandle InUnit);
+
+	/**
+	 * Moves the unit to the free cell, updating the grid and the influence
+	 */
+	void MoveTo(FUnitHandle InUnit, const FIntPoint& InCell);
+
+	/**
+	 * Applies the damage of all the attacks made during the step and takes the killed units off the grid
+	 */
+	void ResolveCombat();
+
+	/**
+	 * Finds a free neighbor cell closer to the goal than the current one
+	 * @return False, if there is no such cell
+	 */
+	bool GetNextMoveLocation(FUnitHandle InUnit, const FIntPoint& InGoal, FIntPoint& OutLocation) const;
+
+	FGrid Grid;
+
+	// The latest snapshot of the grid, shares the unchanged tiles with the next one
+	FGridSnapshotPtr GridSnapshot;
+
+	// The units on the grid, partitioned by teams
+	FUnitRegistry Units;
+
+	// Follows every placement, move and death of the units
+	FInfluenceMap Influence;
+
+	// Rebuilt before the intents of every step are chosen
+	FTeamPresenceTables Presence;
+
+	// Targets found by the previous steps
+	FUnitTargetCache TargetCache;
+	float TargetHysteresisCells = 1.f;
+
+	// The intents chosen for the step DecidedStep, indexed by the unit handles
+	TArray<FUnitIntent> StepIntents;
+	int32 DecidedStep = INDEX_NONE;
+
+	// The units in the order of the utility input columns, and their chosen actions
+	TArray<FUnitHandle> DecisionUnits;
+	TArray<EUnitAction> DecisionActions;
+	FUtilityEvaluator Utility;
+
+	// Set for the next step only, override the chosen actions
+	TConstArrayView<EUnitAction> ExternalActions;
+
+	// The shared paths of the units approaching the same targets, planned along with the intents
+	FSquadPlanner Squads;
+
+	// Chooses the targets of the next step, launched by PrepareStep
+	UE::Tasks::FTask DecisionsTask;
+	// The heap allocations made by the task on its own thread, added to the ones of the step
+	uint64 DecisionHeapAllocations = 0;
+
+	// Combat resolution results of the current step. Kept as members to reuse the allocations.
+	TArray<FUnitHandle> DamagedUnits;
+	TArray<FUnitKill> StepKills;
+
+	// The number of the steps made since the start
+	int32 SimulationStep = 0;
+
+	// The events of the current step
+	FSimStepEvents StepEvents;
+
+	// The work done by the current step, for profiling
+	FSimStepCounters StepCounters;
+
+	TUniquePtr<GS_Pathfinder> Pathfinder;
+};
@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/StaticArray.h"
+#include "StaticData.h"
+
+/**
+ * The influence of every team over the grid: each unit spreads its attack power around its cell with a falloff,
+ * and the influences of the units of a team are summed up.
+ *
+ * The map is never recomputed from scratch. Placing, moving and removing a unit only adds or subtracts its own kernel,
+ * so the cost of a step depends on the number of moves rather than on the size of the grid or the number of units.
+ * The values are kept in fixed point, so the subtracted kernels cancel the added ones exactly and the map doesn't
+ * drift over a long simulation.
+ */
+class GRIDAISIM_API FInfluenceMap
+{
+public:
+	// How far (in cells, along each axis) the influence of a unit reaches
+	static constexpr int32 Radius = 4;
+
+	/**
+	 * Sizes the map for the grid and clears it
+	 */
+	void Init(int32 InSizeX, int32 InSizeY);
+
+	/**
+	 * Clears the influence of all the units
+	 */
+	void Reset();
+
+	void AddUnit(ETeam InTeam, const FIntPoint& InCell, float InStrength);
+	void RemoveUnit(ETeam InTeam, const FIntPoint& InCell, float InStrength);
+	void MoveUnit(ETeam InTeam, const FIntPoint& InFromCell, const FIntPoint& InToCell, float InStrength);
+
+	/**
+	 * @return The summed influence of the units of the team at the cell, the unit standing there included
+	 */
+	float GetSupport(ETeam InTeam, const FIntPoint& InCell) const;
+
+	/**
+	 * @return The summed influence of the units of all the other teams at the cell
+	 */
+	float GetThreat(ETeam InTeam, const FIntPoint& InCell) const;
+
+private:
+	static constexpr int32 KernelSize = 2 * Radius + 1;
+
+	// The fixed point scales of the kernel weights and of the unit strengths
+	static constexpr int32 KernelScale = 256;
+	static constexpr int32 StrengthScale = 16;
+
+	/**
+	 * Adds the kernel scaled by the strength around the cell. A negative strength removes the unit.
+	 */
+	void ApplyKernel(ETeam InTeam, const FIntPoint& InCell, int32 InStrength);
+
+	static int32 QuantizeStrength(float InStrength);
+
+	int32 GetCellIndex(const FIntPoint& InCell) const;
+
+	// Indexed by the teams, allocated when the first unit of the team is added. Rows go along X.
+	TStaticArray<TArray<int32>, StaticCast<int32>(ETeam::MAX)> TeamInfluence;
+
+	// The influence of a unit with the strength of one, as the product of the linear falloffs along X and Y
+	int32 Kernel[KernelSize * KernelSize] = {};
+
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+};
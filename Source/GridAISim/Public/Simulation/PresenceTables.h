@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/StaticArray.h"
+#include "StaticData.h"
+
+struct FGrid;
+struct FUnitRegistry;
+
+/**
+ * A summed-area table of the unit positions per team: every entry holds the number of the units of the team
+ * in the rectangle from the grid origin to the entry. The number of units in any rectangle is then four lookups,
+ * whatever the size of the rectangle.
+ *
+ * The tables are rebuilt from the unit cells in one pass over the grid, so they describe the state at the moment
+ * of the rebuild and go stale as soon as the units move. A change of a cell changes the entries of all the rows
+ * from its own one down, so Update only rebuilds the rows from the topmost changed one.
+ */
+class GRIDAISIM_API FTeamPresenceTables
+{
+public:
+	void Init(int32 InSizeX, int32 InSizeY);
+
+	/**
+	 * Rebuilds the tables of all the teams from the cells of the units
+	 */
+	void Rebuild(const FUnitRegistry& InUnits);
+
+	/**
+	 * Brings the tables up to date with the occupancy changes journaled by the grid since the previous update
+	 */
+	void Update(const FUnitRegistry& InUnits, const FGrid& InGrid);
+
+	/**
+	 * @return The number of the units of the team in the rectangle, the bounds included. Clipped by the grid.
+	 */
+	int32 CountUnits(ETeam InTeam, const FIntPoint& InMin, const FIntPoint& InMax) const;
+
+	/**
+	 * @return The number of the units of all the other teams in the rectangle, the bounds included
+	 */
+	int32 CountOpponents(ETeam InTeam, const FIntPoint& InMin, const FIntPoint& InMax) const;
+
+private:
+	/**
+	 * Rebuilds the rows of the tables from the given grid row down, the rows above it are kept
+	 */
+	void RebuildRows(const FUnitRegistry& InUnits, int32 InFirstRow);
+
+	// Indexed by the teams. Rows go along X and have one extra leading column, the table has one extra leading row,
+	// so the lookups at the grid borders need no special cases.
+	TStaticArray<TArray<int32>, StaticCast<int32>(ETeam::MAX)> Tables;
+
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+	int32 Stride = 0;
+
+	// The epoch of the grid the tables were updated at, zero if they weren't built yet
+	uint32 GridEpoch = 0;
+};
@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/RingBuffer.h"
+#include "Simulation/UnitRegistry.h"
+
+struct FGrid;
+
+/**
+ * The state of a single unit at the end of a simulation step.
+ * The grid occupancy is described by the cells of the units.
+ */
+struct FUnitSnapshot
+{
+	FUnitHandle Handle = INDEX_NONE;
+	ETeam Team = ETeam::NoTeam;
+	int32 CellIndex = INDEX_NONE;
+	float Health = 0.f;
+	float AttackPower = 0.f;
+	int32 AttackRange = 1;
+};
+
+/**
+ * The decoded state of the simulation at the end of a step. Units are sorted by their handles.
+ */
+struct FSimSnapshot
+{
+	int32 Step = INDEX_NONE;
+	TArray<FUnitSnapshot> Units;
+
+	const FUnitSnapshot* FindUnit(FUnitHandle InHandle) const;
+};
+
+/**
+ * A ring buffer of the simulation checkpoints for rewinding.
+ *
+ * Every KeyframeInterval steps a full keyframe is stored, the steps in between are stored as deltas
+ * against the previous step: removed units, and the changed cells and health of the rest.
+ * When the memory cap is exceeded, the oldest keyframe is evicted together with its deltas.
+ */
+class GRIDAISIM_API GS_SimCheckpoints
+{
+public:
+	/**
+	 * @param InKeyframeInterval The number of steps between two full keyframes
+	 * @param InMemoryCapBytes The maximum amount of memory taken by the encoded checkpoints
+	 */
+	void Configure(int32 InKeyframeInterval, int64 InMemoryCapBytes);
+
+	/**
+	 * Removes all the checkpoints
+	 */
+	void Reset();
+
+	/**
+	 * Stores the state of the units at the end of the step
+	 * @param InStep The step the state belongs to. Should be greater than the previously captured one.
+	 * @param InUnits The registry to capture the units from
+	 * @param InGrid The grid the units are placed on
+	 */
+	void Capture(int32 InStep, const FUnitRegistry& InUnits, const FGrid& InGrid);
+
+	/**
+	 * Decodes the state of the given step
+	 * @param InStep The step to reconstruct
+	 * @param OutSnapshot The state of the step
+	 * @return False, if the step is not in the buffer anymore (or yet)
+	 */
+	bool Reconstruct(int32 InStep, FSimSnapshot& OutSnapshot) const;
+
+	/**
+	 * Drops all the checkpoints after the given step, so the simulation can continue from it
+	 */
+	void TruncateAfter(int32 InStep);
+
+	int32 GetOldestStep() const;
+	int32 GetLatestStep() const;
+	int64 GetMemoryUsage() const;
+
+private:
+	struct FCheckpoint
+	{
+		int32 Step = INDEX_NONE;
+		bool bIsKeyframe = false;
+		TArray<uint8> Data;
+	};
+
+	static void EncodeKeyframe(const FSimSnapshot& InSnapshot, TArray<uint8>& OutData);
+	static void EncodeDelta(const FSimSnapshot& InPrevious, const FSimSnapshot& InCurrent, TArray<uint8>& OutData);
+	static bool DecodeKeyframe(TArrayView<const uint8> InData, FSimSnapshot& OutSnapshot);
+	static bool DecodeDelta(TArrayView<const uint8> InData, FSimSnapshot& InOutSnapshot);
+
+	void EvictToMemoryCap();
+
+	TRingBuffer<FCheckpoint> Checkpoints;
+
+	// The state of the latest captured step, the base for the next delta
+	FSimSnapshot LatestSnapshot;
+
+	int32 KeyframeInterval = 30;
+	int64 MemoryCapBytes = 4 * 1024 * 1024;
+	int64 MemoryUsage = 0;
+	int32 StepsSinceKeyframe = 0;
+};
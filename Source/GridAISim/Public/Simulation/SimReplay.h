@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Simulation/SimStepEvents.h"
+
+/**
+ * The initial state of a unit in a replay.
+ */
+struct FReplayUnit
+{
+	FUnitHandle Handle = INDEX_NONE;
+	int32 ClassIndex = INDEX_NONE;
+	ETeam Team = ETeam::NoTeam;
+	int32 CellIndex = INDEX_NONE;
+	float Health = 0.f;
+};
+
+/**
+ * Everything required to start the playback of a replay.
+ */
+struct FReplayHeader
+{
+	int32 GridSizeX = 0;
+	int32 GridSizeY = 0;
+	float StepDuration = 0.f;
+
+	// Path names of the unit classes, referenced by FReplayUnit::ClassIndex
+	TArray<FString> UnitClassPaths;
+	TArray<FReplayUnit> Units;
+};
+
+/**
+ * Replay file format:
+ *   Magic, Version, Header (varint encoded, class paths as length-prefixed UTF-8),
+ *   then a sequence of step records: varint payload size followed by the payload,
+ *   where the payload holds the step number and the move, attack and death events with varint encoded handles and cells.
+ *   A zero payload size marks the end of the replay.
+ *
+ * The recorder encodes the steps on the calling thread into small buffers, and a background thread writes them to the file.
+ *
+ * Only the units of the header are replayed. The spawns aren't recorded, so the events of the units added
+ * after the recording began refer to the handles the playback has no actors for, and are skipped by it.
+ */
+class GRIDAISIM_API GS_ReplayRecorder
+{
+public:
+	GS_ReplayRecorder();
+	~GS_ReplayRecorder();
+
+	/**
+	 * Opens the file and writes the header
+	 * @param InFilePath The absolute path of the replay file
+	 * @param InHeader The initial state of the simulation
+	 * @return False, if the file can't be created
+	 */
+	bool Begin(const FString& InFilePath, const FReplayHeader& InHeader);
+
+	/**
+	 * Encodes the events of the step and hands them over to the writing thread
+	 */
+	void RecordStep(const FSimStepEvents& InEvents);
+
+	/**
+	 * Writes the end marker, waits for all the pending steps to be written and closes the file
+	 */
+	void End();
+
+	bool IsRecording() const;
+
+private:
+	// Lives in the translation unit, the header doesn't need to know about threads
+	TUniquePtr<class FReplayWriter> Writer;
+
+	// Reused between the steps
+	TArray<uint8> EncodeBuffer;
+};
+
+/**
+ * Reads the replay recorded by GS_ReplayRecorder step by step.
+ */
+class GRIDAISIM_API GS_ReplayPlayer
+{
+public:
+	/**
+	 * Loads the replay and decodes its header
+	 * @param InFilePath The absolute path of the replay file
+	 * @return False, if the file can't be read or is not a replay
+	 */
+	bool Open(const FString& InFilePath);
+
+	const FReplayHeader& GetHeader() const;
+
+	/**
+	 * Decodes the events of the next step. The steps with the invalid handles or cells are skipped.
+	 * @param OutEvents The events of the step, reused between the steps
+	 * @return False, if the replay is over or its structure is corrupted
+	 */
+	bool ReadNextStep(FSimStepEvents& OutEvents);
+
+	bool IsFinished() const;
+
+private:
+	/**
+	 * @return False, if the payload doesn't decode to its end, or refers to the cells off the grid
+	 */
+	bool DecodeStep(TArrayView<const uint8> InPayload, FSimStepEvents& OutEvents) const;
+
+	bool IsValidCell(uint32 InCellIndex) const;
+
+	FReplayHeader Header;
+	TArray<uint8> FileData;
+	int32 ReadOffset = 0;
+	bool bIsFinished = true;
+};
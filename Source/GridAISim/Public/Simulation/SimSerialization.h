@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Compact byte encoding helpers shared by the simulation checkpoints and replays.
+ * Unsigned values are written as LEB128 varints, so small handles and cell indices take one or two bytes.
+ */
+namespace SimSerialization
+{
+	inline void WriteVarUInt(TArray<uint8>& OutBytes, uint32 InValue)
+	{
+		while (InValue >= 0x80)
+		{
+			OutBytes.Add(StaticCast<uint8>(InValue | 0x80));
+			InValue >>= 7;
+		}
+		OutBytes.Add(StaticCast<uint8>(InValue));
+	}
+
+	/**
+	 * Signed values are zig-zag encoded first, so small negative values stay small
+	 */
+	inline void WriteVarInt(TArray<uint8>& OutBytes, int32 InValue)
+	{
+		WriteVarUInt(OutBytes, (StaticCast<uint32>(InValue) << 1) ^ StaticCast<uint32>(InValue >> 31));
+	}
+
+	inline void WriteFloat(TArray<uint8>& OutBytes, float InValue)
+	{
+		OutBytes.Append(reinterpret_cast<const uint8*>(&InValue), sizeof(float));
+	}
+
+	inline void WriteByte(TArray<uint8>& OutBytes, uint8 InValue)
+	{
+		OutBytes.Add(InValue);
+	}
+
+	/**
+	 * A bounds-checked reader over an encoded byte stream.
+	 * Reading past the end sets the error flag and returns zeroes instead of crashing on corrupted data.
+	 */
+	struct FByteReader
+	{
+		explicit FByteReader(TArrayView<const uint8> InBytes)
+			: Bytes(InBytes)
+		{
+		}
+
+		uint32 ReadVarUInt()
+		{
+			uint32 Result = 0;
+			for (int32 Shift = 0; Shift < 35; Shift += 7)
+			{
+				if (Offset >= Bytes.Num())
+				{
+					bError = true;
+					return 0;
+				}
+				const uint8 Byte = Bytes[Offset++];
+				Result |= StaticCast<uint32>(Byte & 0x7F) << Shift;
+				if ((Byte & 0x80) == 0)
+				{
+					return Result;
+				}
+			}
+			bError = true;
+			return 0;
+		}
+
+		int32 ReadVarInt()
+		{
+			const uint32 Value = ReadVarUInt();
+			return StaticCast<int32>(Value >> 1) ^ -StaticCast<int32>(Value & 1);
+		}
+
+		float ReadFloat()
+		{
+			float Result = 0.f;
+			if (Offset + StaticCast<int32>(sizeof(float)) > Bytes.Num())
+			{
+				bError = true;
+				return Result;
+			}
+			FMemory::Memcpy(&Result, &Bytes[Offset], sizeof(float));
+			Offset += sizeof(float);
+			return Result;
+		}
+
+		uint8 ReadByte()
+		{
+			if (Offset >= Bytes.Num())
+			{
+				bError = true;
+				return 0;
+			}
+			return Bytes[Offset++];
+		}
+
+		int32 GetOffset() const
+		{
+			return Offset;
+		}
+
+		bool IsAtEnd() const
+		{
+			return Offset >= Bytes.Num();
+		}
+
+		bool HasError() const
+		{
+			return bError;
+		}
+
+	private:
+		TArrayView<const uint8> Bytes;
+		int32 Offset = 0;
+		bool bError = false;
+	};
+}
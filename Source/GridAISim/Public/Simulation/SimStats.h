@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GridAISim/GridAISim.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "ProfilingDebugging/CountersTrace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
+
+/**
+ * The profiling data of the simulation. Every phase of the simulation step is visible as a cycle counter in
+ * "stat GridSim", as a CPU scope in Insights, and as a timing stat of the GridSim CSV profiler category.
+ * The per-step counters are published at the end of each step.
+ */
+DECLARE_STATS_GROUP(TEXT("GridSim"), STATGROUP_GridSim, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Step"), STAT_GridSim_Step, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Presence Tables"), STAT_GridSim_PresenceTables, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Target Search"), STAT_GridSim_TargetSearch, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Utility Evaluation"), STAT_GridSim_UtilityEvaluation, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Squad Planning"), STAT_GridSim_SquadPlanning, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pathfinding"), STAT_GridSim_Pathfinding, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Unit Actions"), STAT_GridSim_UnitActions, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Combat Resolution"), STAT_GridSim_CombatResolution, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Cleanup"), STAT_GridSim_Cleanup, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Grid Snapshot"), STAT_GridSim_GridSnapshot, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("End Check"), STAT_GridSim_EndCheck, STATGROUP_GridSim, GRIDAISIM_API);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Units Processed"), STAT_GridSim_UnitsProcessed, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Nodes Expanded"), STAT_GridSim_NodesExpanded, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Heap Operations"), STAT_GridSim_HeapOperations, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Allocations"), STAT_GridSim_Allocations, STATGROUP_GridSim, GRIDAISIM_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Heap Allocations"), STAT_GridSim_HeapAllocations, STATGROUP_GridSim, GRIDAISIM_API);
+
+TRACE_DECLARE_INT_COUNTER_EXTERN(GridSim_UnitsProcessed);
+TRACE_DECLARE_INT_COUNTER_EXTERN(GridSim_NodesExpanded);
+TRACE_DECLARE_INT_COUNTER_EXTERN(GridSim_HeapOperations);
+TRACE_DECLARE_INT_COUNTER_EXTERN(GridSim_Allocations);
+TRACE_DECLARE_INT_COUNTER_EXTERN(GridSim_HeapAllocations);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(GRIDAISIM_API, GridSim);
+
+/**
+ * The memory of the simulation in the low level memory tracker (-llm), as GridSim/Grid, GridSim/Pathfinding,
+ * GridSim/Units and GridSim/Logging
+ */
+LLM_DECLARE_TAG_API(GridSim_Grid, GRIDAISIM_API);
+LLM_DECLARE_TAG_API(GridSim_Pathfinding, GRIDAISIM_API);
+LLM_DECLARE_TAG_API(GridSim_Units, GRIDAISIM_API);
+LLM_DECLARE_TAG_API(GridSim_Logging, GRIDAISIM_API);
+
+/**
+ * Measures the enclosing scope as the given phase of the simulation step, e.g. GRIDSIM_SCOPE(TargetSearch)
+ */
+#define GRIDSIM_SCOPE(Phase) \
+	SCOPE_CYCLE_COUNTER(STAT_GridSim_##Phase); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(GridSim_##Phase); \
+	CSV_SCOPED_TIMING_STAT(GridSim, Phase)
+
+/**
+ * UE_LOG to LogSim, which formatting memory goes to the GridSim/Logging LLM tag
+ */
+#define GRIDSIM_LOG(Verbosity, Format, ...) \
+	do \
+	{ \
+		if (UE_LOG_ACTIVE(LogSim, Verbosity)) \
+		{ \
+			LLM_SCOPE_BYTAG(GridSim_Logging); \
+			UE_LOG(LogSim, Verbosity, Format, ##__VA_ARGS__); \
+		} \
+	} while (false)
+
+/**
+ * The work counters of a single simulation step
+ */
+struct GRIDAISIM_API FSimStepCounters
+{
+	int32 UnitsProcessed = 0;
+	int32 NodesExpanded = 0;
+	int32 HeapOperations = 0;
+	// The allocations counted by the pathfinder
+	int32 Allocations = 0;
+	// The heap allocations made by the thread making the step, and by the thread choosing the intents of the step,
+	// while FSimAllocationCounter is enabled. The workers helping the parallel parts of the choice aren't counted.
+	int32 HeapAllocations = 0;
+
+	void Reset()
+	{
+		*this = FSimStepCounters();
+	}
+
+	/**
+	 * Sends the counters to the stats, the trace and the CSV profiler
+	 */
+	void Publish() const;
+};
+
+/**
+ * Counts the heap allocations per thread, so the allocations of a simulation step can be told from the rest.
+ * Enabling it routes GMalloc through a counting proxy for the rest of the run, so it's only enabled at the startup
+ * of the module, by the -GridSimCountAllocations command line switch.
+ */
+struct GRIDAISIM_API FSimAllocationCounter
+{
+	/**
+	 * Starts counting. Should only be called at the startup, on the game thread.
+	 */
+	static void Enable();
+
+	static bool IsEnabled();
+
+	/**
+	 * @return The number of the heap allocations made by the calling thread since the counting started
+	 */
+	static uint64 GetThreadAllocations();
+};
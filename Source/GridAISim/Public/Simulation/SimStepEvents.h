@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Simulation/UnitRegistry.h"
+
+/**
+ * A unit moved to another grid cell.
+ */
+struct FSimMoveEvent
+{
+	FUnitHandle Unit = INDEX_NONE;
+	int32 CellIndex = INDEX_NONE;
+};
+
+/**
+ * A unit attacked another one.
+ */
+struct FSimAttackEvent
+{
+	FUnitHandle Unit = INDEX_NONE;
+	FUnitHandle Target = INDEX_NONE;
+};
+
+/**
+ * A unit was killed. The instigator may be INDEX_NONE.
+ */
+struct FSimDeathEvent
+{
+	FUnitHandle Unit = INDEX_NONE;
+	FUnitHandle Instigator = INDEX_NONE;
+};
+
+/**
+ * Everything that happened during a single simulation step, in the order of happening within each category.
+ */
+struct FSimStepEvents
+{
+	int32 Step = INDEX_NONE;
+	TArray<FSimMoveEvent> Moves;
+	TArray<FSimAttackEvent> Attacks;
+	TArray<FSimDeathEvent> Deaths;
+
+	// The units that found no target. Not recorded to the replays, the halted units just stay idle.
+	TArray<FUnitHandle> Halts;
+
+	void Reset(int32 InStep)
+	{
+		Step = InStep;
+		Moves.Reset();
+		Attacks.Reset();
+		Deaths.Reset();
+		Halts.Reset();
+	}
+};
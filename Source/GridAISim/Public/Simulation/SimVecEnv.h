@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Grid/Grid.h"
+#include "Simulation/UtilityAI.h"
+
+class FGridSimulation;
+
+/**
+ * The features of a unit in the observations, in the order they are written.
+ */
+enum class ESimUnitFeature : uint8
+{
+	// 1 for the living units, all the features of the dead ones are zero
+	Alive,
+	// The index of the team plane of the unit
+	Team,
+	// The coordinates of the unit, divided by the grid size
+	X,
+	Y,
+	Health,
+	AttackPower,
+	AttackRange,
+	MAX
+};
+
+struct FSimVecEnvConfig
+{
+	int32 NumEnvs = 1;
+	int32 SizeX = 32;
+	int32 SizeY = 32;
+	EGridType GridType = EGridType::Rectangular;
+
+	// The red team starts in the left half of the grid, the blue team in the right one
+	int32 UnitsPerTeam = 8;
+	float UnitHealth = 10.f;
+	float UnitAttackPower = 2.f;
+	int32 UnitAttackRange = 1;
+
+	// The fraction of the cells made obstacles, the cells taken by the units are skipped
+	float ObstacleDensity = 0.f;
+
+	// The episodes still going on after this many steps are cut off
+	int32 MaxEpisodeSteps = 256;
+};
+
+/**
+ * The tensors the observations and the outcome of the steps are written to. Owned by the caller, e.g. the memory
+ * of the training framework, and written in place. The layouts are row-major, with the environment going first.
+ */
+struct FSimVecEnvBuffers
+{
+	// [Env][Team][Y][X], 1 for the cells taken by the units of the team
+	TArrayView<float> Occupancy;
+	// [Env][Team][Y][X], the health of the unit of the team on the cell
+	TArrayView<float> Health;
+	// [Env][Unit][ESimUnitFeature]
+	TArrayView<float> UnitFeatures;
+	// [Env][Team], the opponents killed by the team during the step minus the units the team lost
+	TArrayView<float> Rewards;
+	// [Env], 1 for the environments, which finished an episode during the step and were reset
+	TArrayView<uint8> Dones;
+};
+
+/**
+ * Many independent simulations in one process, stepped all at once, e.g. to train the policies of the units.
+ *
+ * The environments are spread over the worker threads, and every step of an environment is made by a single thread,
+ * as the simulations don't go parallel within themselves.
+ * The actions come in a single buffer with an action per unit, and the observations are written straight to
+ * the buffers of the caller. The environments, which finish an episode, start the next one within the same step,
+ * so their observations after the step are the first ones of the new episode.
+ *
+ * The units of an environment are numbered the same in every episode: the red team first, the blue one after it.
+ * The layout of every episode follows from the seed, the index of the environment and the index of the episode
+ * only, so the runs with the same seed and the same actions are the same.
+ */
+class GRIDAISIM_API FGridSimVecEnv
+{
+public:
+	// The team planes of the observations, NoTeam excluded
+	static constexpr int32 NumTeams = static_cast<int32>(ETeam::MAX) - 1;
+	static constexpr int32 NumUnitFeatures = static_cast<int32>(ESimUnitFeature::MAX);
+
+	explicit FGridSimVecEnv(const FSimVecEnvConfig& InConfig);
+	~FGridSimVecEnv();
+
+	FGridSimVecEnv(const FGridSimVecEnv&) = delete;
+	FGridSimVecEnv& operator=(const FGridSimVecEnv&) = delete;
+
+	/**
+	 * Starts the first episode of every environment, the rewards and the dones are cleared
+	 * @return False, if the buffers don't match the configuration
+	 */
+	bool Reset(int32 InSeed, const FSimVecEnvBuffers& OutBuffers);
+
+	/**
+	 * Makes a step of every environment in parallel
+	 * @param InActions [Env][Unit], EUnitAction::MAX leaves the choice to the utility AI of the unit
+	 * @return False, if the actions or the buffers don't match the configuration
+	 */
+	bool Step(TConstArrayView<EUnitAction> InActions, const FSimVecEnvBuffers& OutBuffers);
+
+	int32 NumEnvs() const;
+	int32 NumUnitsPerEnv() const;
+
+	/**
+	 * The sizes of the buffers, in the elements
+	 */
+	int32 GetNumPlaneValues() const;
+	int32 GetNumUnitFeatureValues() const;
+	int32 GetNumRewardValues() const;
+
+	const FGridSimulation& GetSimulation(int32 InEnvIndex) const;
+
+private:
+	struct FEnv
+	{
+		TUniquePtr<FGridSimulation> Simulation;
+		int32 Episode = 0;
+		int32 EpisodeStep = 0;
+	};
+
+	bool CheckBuffers(const FSimVecEnvBuffers& InBuffers) const;
+
+	/**
+	 * Lays out the units and the obstacles of the current episode of the environment
+	 */
+	void StartEpisode(int32 InEnvIndex);
+
+	/**
+	 * Scores the deaths of the latest step for the teams
+	 */
+	void WriteRewards(int32 InEnvIndex, const FSimVecEnvBuffers& OutBuffers) const;
+	void WriteObservations(int32 InEnvIndex, const FSimVecEnvBuffers& OutBuffers) const;
+
+	static int32 GetTeamPlane(ETeam InTeam);
+
+	FSimVecEnvConfig Config;
+	TArray<FEnv> Envs;
+	int32 Seed = 0;
+};
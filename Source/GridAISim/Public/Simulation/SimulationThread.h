@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Containers/TripleBuffer.h"
+#include "Grid/GridSnapshot.h"
+#include "HAL/Runnable.h"
+#include "Simulation/SimStepEvents.h"
+#include "Simulation/UnitRegistry.h"
+
+class FGridSimulation;
+class FRunnableThread;
+
+/**
+ * The published state of a simulated unit.
+ */
+struct FSimFrameUnit
+{
+	// INDEX_NONE if the unit is not alive
+	int32 CellIndex = INDEX_NONE;
+	float Health = 0.f;
+	ETeam Team = ETeam::NoTeam;
+
+	bool IsAlive() const { return CellIndex != INDEX_NONE; }
+};
+
+/**
+ * The state of the simulation after a step, as seen by the game thread.
+ * The frames may be skipped when the steps are faster than the game frames, so everything but the latest step events
+ * is the full state rather than a delta.
+ */
+struct FSimFrame
+{
+	int32 Step = 0;
+	bool bIsOver = false;
+
+	// Indexed by the unit handles
+	TArray<FSimFrameUnit> Units;
+
+	// The events of the latest step only
+	FSimStepEvents Events;
+
+	// The grid as of the step, shares the unchanged tiles with the grids of the previous frames
+	FGridSnapshotPtr Grid;
+
+	/**
+	 * Copies the current state of the simulation, reusing the allocations of the frame.
+	 * Non-const, as the grid snapshot is made by the simulation.
+	 */
+	void Capture(FGridSimulation& InSimulation);
+};
+
+enum class ESimCommandType : uint8
+{
+	Start,
+	Stop,
+	Spawn,
+};
+
+/**
+ * A command from the game thread to the simulation thread.
+ */
+struct FSimCommand
+{
+	ESimCommandType Type = ESimCommandType::Start;
+
+	// The unit to spawn and the request to answer with its handle
+	FUnitState Unit;
+	int32 SpawnRequest = INDEX_NONE;
+};
+
+/**
+ * The handle issued to a spawned unit, or INDEX_NONE if its cell was taken by the time the command was processed.
+ */
+struct FSimSpawnResult
+{
+	int32 SpawnRequest = INDEX_NONE;
+	FUnitHandle Unit = INDEX_NONE;
+};
+
+/**
+ * Runs the simulation steps on a dedicated thread, so their cost doesn't add to the frame time.
+ *
+ * While the thread is running, it owns the simulation: the game thread only talks to it through the commands
+ * and only reads the published frames. The frames go through a lock-free triple buffer, so neither side ever waits
+ * for the other one. Stop the thread before touching the simulation from the game thread again.
+ */
+class GRIDAISIM_API FGridSimulationThread : public FRunnable
+{
+public:
+	explicit FGridSimulationThread(FGridSimulation& InSimulation);
+	virtual ~FGridSimulationThread() override;
+
+	FGridSimulationThread(const FGridSimulationThread&) = delete;
+	FGridSimulationThread& operator=(const FGridSimulationThread&) = delete;
+
+	/**
+	 * Called on the simulation thread after every step, e.g. to capture the checkpoints.
+	 * Whatever it touches belongs to the simulation thread until the thread is stopped.
+	 */
+	void SetOnStepped(TFunction<void(const FGridSimulation&)>&& InOnStepped);
+
+	/**
+	 * Starts the thread. The simulation stays paused until the Start command.
+	 * @param InStepDuration The time between the steps, in seconds
+	 * @return False, if the platform has no threads
+	 */
+	bool Launch(float InStepDuration);
+
+	/**
+	 * Stops the thread and waits for it to finish, handing the simulation back to the calling thread.
+	 * The commands, which are still queued, are dropped.
+	 */
+	void Shutdown();
+
+	bool IsLaunched() const;
+
+	/**
+	 * Should be called from a single producer thread
+	 */
+	void Enqueue(const FSimCommand& InCommand);
+
+	/**
+	 * @return The latest published frame, or nullptr if there is nothing new since the previous call
+	 */
+	const FSimFrame* ConsumeFrame();
+
+	/**
+	 * @return False, if there are no more spawn results
+	 */
+	bool DequeueSpawnResult(FSimSpawnResult& OutResult);
+
+	//~ Begin FRunnable Interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+	//~ End FRunnable Interface
+
+private:
+	void ProcessCommands();
+	void PublishFrame();
+
+	FGridSimulation& Simulation;
+	TFunction<void(const FGridSimulation&)> OnStepped;
+
+	FRunnableThread* Thread = nullptr;
+
+	// Wakes the thread up for the commands and the shutdown
+	FEvent* WakeEvent = nullptr;
+
+	TQueue<FSimCommand, EQueueMode::Spsc> Commands;
+	TQueue<FSimSpawnResult, EQueueMode::Spsc> SpawnResults;
+	TTripleBuffer<FSimFrame> Frames;
+
+	std::atomic<bool> bStopRequested = false;
+
+	// Accessed on the simulation thread only
+	bool bStepping = false;
+	// The results of the spawns held back until the frame with the spawned units is published
+	TArray<FSimSpawnResult> HeldSpawnResults;
+	double StepDuration = 0.1;
+};
@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Grid/PathArena.h"
+#include "Simulation/UnitRegistry.h"
+#include "Simulation/UtilityAI.h"
+
+struct FGrid;
+class GS_Pathfinder;
+
+/**
+ * Groups the nearby units of a team approaching the same target into squads, and finds a single path per squad.
+ *
+ * The path goes from the cell of the squad leader to the target. The other members follow it shifted
+ * by their offset from the leader, so the cost of the pathfinding depends on the number of the squads,
+ * not on the number of the units. The squads are formed anew for every step.
+ */
+class GRIDAISIM_API FSquadPlanner
+{
+public:
+	// The units approaching the same target from the same block of cells make a squad
+	static constexpr int32 SquadBlockSize = 8;
+
+	// The smaller squads step straight towards the target, a path of their own isn't worth it
+	static constexpr int32 MinSquadSize = 2;
+
+	// The farther targets are approached straight too, until the squad gets close enough for the detours to matter.
+	// Also keeps the path queries local, the pathfinder is quadratic in the number of the explored nodes.
+	static constexpr int32 MaxPathDistance = 32;
+
+	// How many points ahead along the path the members head to
+	static constexpr int32 WaypointLookahead = 3;
+
+	// The members further from the leader keep to the path closer than their offset
+	static constexpr int32 MaxMemberOffset = 2;
+
+	/**
+	 * Forms the squads of the units approaching their targets, and finds their paths
+	 * @param InUnits The units to group, the ones without the Approach intent are skipped
+	 * @param InIntents The intents of the step, indexed by the unit handles
+	 */
+	void Plan(const FUnitRegistry& InRegistry, TConstArrayView<FUnitHandle> InUnits,
+	          TConstArrayView<FUnitIntent> InIntents, GS_Pathfinder& InPathfinder);
+
+	/**
+	 * Drops all the squads
+	 */
+	void Reset();
+
+	/**
+	 * @param InCell The current cell of the unit
+	 * @param OutWaypoint The cell ahead along the path of the squad, shifted by the offset of the unit
+	 * @return False, if the unit is not in a squad with a path
+	 */
+	bool GetWaypoint(FUnitHandle InUnit, const FIntPoint& InCell, const FGrid& InGrid, FIntPoint& OutWaypoint) const;
+
+	int32 NumSquads() const;
+
+	/**
+	 * Adds the paths of the squads to the paths layer of the debug overlay, if the layer is enabled
+	 */
+	void VisualizePaths(const GS_Pathfinder& InPathfinder, class UGS_GridDebugOverlayComponent* InOverlay) const;
+
+private:
+	struct FSquad
+	{
+		FUnitHandle Target = INDEX_NONE;
+		FIntPoint LeaderCell = FIntPoint::ZeroValue;
+		int32 NumMembers = 0;
+
+		// From the cell of the leader, in Paths
+		FPathHandle Path = INDEX_NONE;
+	};
+
+	static uint64 MakeSquadKey(ETeam InTeam, FUnitHandle InTarget, const FIntPoint& InCell);
+
+	TArray<FSquad> Squads;
+	TMap<uint64, int32> SquadsByKey;
+
+	// The squad of every unit, indexed by the unit handles
+	TArray<int32> UnitSquads;
+
+	// The paths of the squads, freed when the squads are formed again
+	FPathArena Paths;
+};
@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Simulation/UnitRegistry.h"
+
+/**
+ * The cached target of a single unit.
+ */
+struct FTargetCacheEntry
+{
+	FUnitHandle Target = INDEX_NONE;
+
+	// The distance to the target at the moment it was found by the full search
+	float AcquiredDistance = 0.f;
+
+	// The number of simulation steps passed since the full search
+	int32 StepsSinceAcquired = 0;
+};
+
+/**
+ * A per-unit cache of the targets found by the full closest opponent search.
+ *
+ * Every unit moves by at most one cell per step, so the distance from the unit to any other opponent
+ * may shrink by at most MaxApproachPerStep per step. The cached target is kept while it is alive and
+ * no further than that lower bound plus the hysteresis margin, which means no other opponent may be closer
+ * than the cached one by more than the margin. Otherwise the entry is invalidated and the full search is required.
+ * Units engaged in a fight stay at the smallest possible distance from their targets, so they keep them until death.
+ */
+struct GRIDAISIM_API FUnitTargetCache
+{
+	// The maximum reduction of the distance between two units during a single step (both move by one cell)
+	static constexpr float MaxApproachPerStep = 2.f;
+
+	void Reset();
+
+	/**
+	 * Should be called once per simulation step before any lookups
+	 */
+	void OnStepStarted();
+
+	/**
+	 * Allocates the entries of the handles below the given number up front,
+	 * so the different units may look their targets up in parallel
+	 */
+	void Reserve(int32 InNumUnits);
+
+	/**
+	 * Looks up the cached target of the unit and revalidates it
+	 * @param InUnit The handle of the unit looking for a target
+	 * @param InDistanceSqr Returns the current square distance to the target for the given target handle
+	 * @param InHysteresis The allowed difference between the cached target distance and the closest possible one
+	 * @return The cached target handle, or INDEX_NONE if the full search is required
+	 */
+	template <typename DistanceFuncType>
+	FUnitHandle Find(FUnitHandle InUnit, DistanceFuncType&& InDistanceSqr, float InHysteresis)
+	{
+		if (!Entries.IsValidIndex(InUnit) || Entries[InUnit].Target == INDEX_NONE)
+		{
+			return INDEX_NONE;
+		}
+
+		FTargetCacheEntry& Entry = Entries[InUnit];
+		const int32 DistanceSqr = InDistanceSqr(Entry.Target);
+		// Two units can't be closer than one cell to each other
+		const float ClosestPossible = FMath::Max(1.f,
+			Entry.AcquiredDistance - MaxApproachPerStep * Entry.StepsSinceAcquired);
+
+		// A negative distance stands for the dead, or removed target
+		if (DistanceSqr < 0 || FMath::Sqrt(StaticCast<float>(DistanceSqr)) > ClosestPossible + InHysteresis)
+		{
+			Entry = FTargetCacheEntry();
+			return INDEX_NONE;
+		}
+		return Entry.Target;
+	}
+
+	/**
+	 * Stores the result of the full search
+	 */
+	void Store(FUnitHandle InUnit, FUnitHandle InTarget, int32 InDistanceSqr);
+
+	/**
+	 * Drops the cached target of the unit itself, e.g. of a removed unit, so a reused handle doesn't inherit it.
+	 * The entries of the other units targeting it are not touched, Find drops them once the target is gone.
+	 */
+	void Invalidate(FUnitHandle InUnit);
+
+private:
+	// Indexed by the unit handle
+	TArray<FTargetCacheEntry> Entries;
+};
@@ -0,0 +1,189 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "StaticData.h"
+
+/**
+ * A stable identifier of a registered unit. Unlike the position of the unit in the team arrays,
+ * the handle never changes while the unit is registered and is never reused after the unit is removed.
+ */
+using FUnitHandle = int32;
+
+/**
+ * The simulated state of a single unit.
+ */
+struct FUnitState
+{
+	ETeam Team = ETeam::NoTeam;
+	FIntPoint Cell = FIntPoint::ZeroValue;
+	float Health = 0.f;
+	float AttackPower = 0.f;
+	int32 AttackRange = 1;
+};
+
+/**
+ * A unit killed during the combat resolution.
+ */
+struct FUnitKill
+{
+	FUnitHandle Target = INDEX_NONE;
+	FUnitHandle Instigator = INDEX_NONE;
+};
+
+/**
+ * Dense storage of the units of a single team. All the arrays are kept parallel, so the same index (slot)
+ * addresses the same unit in each of them.
+ */
+struct GRIDAISIM_API FTeamUnits
+{
+	TArray<FUnitHandle> Handles;
+	TArray<FIntPoint> Cells;
+
+	// Combat attributes. The simulation works with these, the actors get the copies for the visuals.
+	TArray<float> Health;
+	TArray<float> AttackPower;
+	TArray<int32> AttackRange;
+
+	// The damage accumulated during the current step, and the last unit that dealt it
+	TArray<float> PendingDamage;
+	TArray<FUnitHandle> LastInstigators;
+
+	int32 Num() const
+	{
+		return Handles.Num();
+	}
+};
+
+/**
+ * The registry of units participating in the simulation.
+ * Units are kept in dense per-team arrays, so iterating over the opponents touches the opponents only,
+ * and the removal is a swap-and-pop through the handle-to-slot map, which makes it O(1) per unit.
+ */
+struct GRIDAISIM_API FUnitRegistry
+{
+	/**
+	 * Removes all the units and invalidates all the handles
+	 */
+	void Reset();
+
+	/**
+	 * Registers a unit in the bucket of its team
+	 * @param InUnit The state of the unit
+	 * @return The handle of the registered unit, or INDEX_NONE if the unit can't be registered
+	 */
+	FUnitHandle Add(const FUnitState& InUnit);
+
+	/**
+	 * Registers a unit under a handle that was issued before, e.g. when restoring a checkpoint
+	 * @param InHandle A previously issued handle, which is not in use at the moment
+	 * @param InUnit The state of the unit
+	 * @return False, if the handle is in use or was never issued
+	 */
+	bool Restore(FUnitHandle InHandle, const FUnitState& InUnit);
+
+	/**
+	 * Removes the unit by swapping the last unit of its team into the freed slot
+	 * @param InHandle The handle of the unit to remove
+	 * @return True, if the unit was registered
+	 */
+	bool Remove(FUnitHandle InHandle);
+
+	/**
+	 * Removes all the units, but unlike Reset keeps the issued handles reserved
+	 */
+	void RemoveAll();
+
+	bool IsValid(FUnitHandle InHandle) const;
+
+	/**
+	 * @return The state of the unit. The handle must be valid.
+	 */
+	FUnitState Get(FUnitHandle InHandle) const;
+
+	/**
+	 * @return The number of handles issued so far, the upper bound of all the handles
+	 */
+	int32 NumHandles() const;
+
+	/**
+	 * @return The total number of registered units
+	 */
+	int32 Num() const;
+
+	/**
+	 * @return The number of registered units of the given team
+	 */
+	int32 Num(ETeam InTeam) const;
+
+	/**
+	 * @return The number of teams that have at least one registered unit
+	 */
+	int32 NumTeamsWithUnits() const;
+
+	const FTeamUnits& GetTeamUnits(ETeam InTeam) const;
+
+	float GetHealth(FUnitHandle InHandle) const;
+	ETeam GetTeam(FUnitHandle InHandle) const;
+	FIntPoint GetCell(FUnitHandle InHandle) const;
+	void SetCell(FUnitHandle InHandle, const FIntPoint& InCell);
+	int32 GetAttackRange(FUnitHandle InHandle) const;
+	float GetAttackPower(FUnitHandle InHandle) const;
+
+	/**
+	 * Accumulates the attack power of the instigator in the damage buffer of the target.
+	 * The health isn't affected until ResolveDamage, so every attack of the step sees the same state.
+	 * @param InTarget The handle of the attacked unit
+	 * @param InInstigator The handle of the attacking unit
+	 */
+	void QueueDamage(FUnitHandle InTarget, FUnitHandle InInstigator);
+
+	/**
+	 * Applies the accumulated damage to the health of all the units in a single pass and clears the damage buffers
+	 * @param OutDamaged Handles of the units that received any damage
+	 * @param OutKilled The units whose health dropped to zero by this resolution
+	 */
+	void ResolveDamage(TArray<FUnitHandle>& OutDamaged, TArray<FUnitKill>& OutKilled);
+
+	/**
+	 * Calls InFunc(FUnitHandle) for every registered unit. The teams take turns unit by unit, so none of them
+	 * gets to act first with all of its units, as the units act in this order during the step.
+	 */
+	template <typename FuncType>
+	void ForEachUnit(FuncType&& InFunc) const
+	{
+		int32 MaxTeamUnits = 0;
+		for (const FTeamUnits& TeamUnits : Teams)
+		{
+			MaxTeamUnits = FMath::Max(MaxTeamUnits, TeamUnits.Handles.Num());
+		}
+
+		for (int32 Index = 0; Index < MaxTeamUnits; ++Index)
+		{
+			for (const FTeamUnits& TeamUnits : Teams)
+			{
+				if (Index < TeamUnits.Handles.Num())
+				{
+					InFunc(TeamUnits.Handles[Index]);
+				}
+			}
+		}
+	}
+
+private:
+	void AddToTeam(FUnitHandle InHandle, const FUnitState& InUnit);
+
+	struct FUnitSlot
+	{
+		ETeam Team = ETeam::NoTeam;
+		int32 Index = INDEX_NONE;
+	};
+
+	FTeamUnits Teams[StaticCast<int32>(ETeam::MAX)];
+
+	// Indexed by the unit handle
+	TArray<FUnitSlot> HandleToSlot;
+
+	int32 NumUnits = 0;
+};
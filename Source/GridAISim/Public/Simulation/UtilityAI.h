@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Simulation/UnitRegistry.h"
+
+/**
+ * What a unit is going to do during the step.
+ */
+enum class EUnitAction : uint8
+{
+	// Stays in place
+	Guard,
+	// Attacks its target
+	Attack,
+	// Attacks the weakest opponent in range instead of its target
+	FocusFire,
+	// Moves towards its target
+	Approach,
+	// Moves away from the opponents
+	Retreat,
+	MAX
+};
+
+/**
+ * The per-unit attributes the considerations are evaluated over. Unless noted otherwise, they are normalized.
+ */
+enum class EUtilityInput : uint8
+{
+	// The distance to the target in the attack ranges of the unit, 1 is the edge of the range
+	TargetDistance,
+	// The health of the unit relative to the health of its target, in [0, 1]
+	RelativeHealth,
+	// The share of the opponents in the influence over the cell of the unit, in [0, 1]
+	Threat,
+	// The number of the opponents in the square of the attack range around the unit, not normalized
+	OpponentsInRange,
+	MAX
+};
+
+enum class EUtilityCurveType : uint8
+{
+	// Slope * X + Intercept
+	Linear,
+	// Slope * (X - Midpoint)^2 + Intercept
+	Quadratic,
+	// 1 / (1 + e^(-Slope * (X - Midpoint))), a smooth step around the midpoint
+	Logistic,
+};
+
+/**
+ * Maps an input to a score. The result is clamped to [0, 1].
+ */
+struct GRIDAISIM_API FUtilityCurve
+{
+	EUtilityCurveType Type = EUtilityCurveType::Linear;
+	float Slope = 1.f;
+	float Midpoint = 0.f;
+	float Intercept = 0.f;
+
+	float Evaluate(float InX) const;
+};
+
+struct FUtilityConsideration
+{
+	EUtilityInput Input = EUtilityInput::TargetDistance;
+	FUtilityCurve Curve;
+};
+
+/**
+ * The score of an action is its weight multiplied by the scores of all its considerations.
+ */
+struct FUtilityAction
+{
+	EUnitAction Action = EUnitAction::Guard;
+	float Weight = 1.f;
+	TArray<FUtilityConsideration> Considerations;
+};
+
+/**
+ * The decision of a unit for the step.
+ */
+struct FUnitIntent
+{
+	EUnitAction Action = EUnitAction::Guard;
+	FUnitHandle Target = INDEX_NONE;
+};
+
+/**
+ * Scores the actions of all the units at once and picks the best one for every unit.
+ *
+ * The inputs are columns with a value per unit, filled by the caller. Every consideration is a single pass over
+ * an input column, four units per iteration, so the cost doesn't depend on the units being different
+ * and there are no per-unit calls into the behaviors.
+ */
+class GRIDAISIM_API FUtilityEvaluator
+{
+public:
+	/**
+	 * @return The actions reproducing the classic behavior (attack the target in range, approach it otherwise),
+	 * extended with focusing the fire when contested and retreating when outnumbered and weak
+	 */
+	static TArray<FUtilityAction> MakeDefaultActions();
+
+	void SetActions(TArray<FUtilityAction>&& InActions);
+
+	/**
+	 * Sizes the input columns for the given number of units
+	 */
+	void Reset(int32 InNumUnits);
+
+	/**
+	 * @return The column of the input, a value per unit. Each unit may be written from its own thread.
+	 */
+	TArrayView<float> GetInputs(EUtilityInput InInput);
+
+	/**
+	 * Scores the actions and writes the best one of every unit
+	 * @param OutActions An action per unit
+	 */
+	void Evaluate(TArrayView<EUnitAction> OutActions);
+
+private:
+	TArray<FUtilityAction> Actions;
+
+	// The columns are padded to a multiple of four units, so the passes need no tails
+	TArray<float> InputColumns[StaticCast<int32>(EUtilityInput::MAX)];
+	TArray<float> Scores;
+	TArray<float> BestScores;
+	TArray<float> BestActions;
+
+	int32 NumUnits = 0;
+};